@@ -11,14 +11,29 @@ TEMPLATE = app
 SOURCES += \
         src/main.cpp \
         src/BingoServer.cpp \
+        src/BingoIoPool.cpp \
+        src/BingoGameActors.cpp \
         src/BingoTicketParser.cpp \
+        src/BingoTicketBase.cpp \
+        src/BingoAuditor.cpp \
+        src/BingoBaseStore.cpp \
         src/BingoGameEngine.cpp \
+        src/BingoMatchKernel.cpp \
+        src/BingoDbWriter.cpp \
         src/BingoDatabaseManager.cpp
 
 HEADERS += \
         src/BingoServer.h \
+        src/BingoIoPool.h \
+        src/BingoGameActors.h \
         src/BingoTicketParser.h \
+        src/BingoTicketBase.h \
+        src/BingoAuditor.h \
+        src/BingoBaseStore.h \
         src/BingoGameEngine.h \
+        src/BingoBallMask.h \
+        src/BingoMatchKernel.h \
+        src/BingoDbWriter.h \
         src/BingoDatabaseManager.h
 
 # Define output directories
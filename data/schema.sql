@@ -15,6 +15,7 @@ DROP TABLE IF EXISTS SORTEIOS CASCADE;
 DROP TABLE IF EXISTS CHAVES_ACESSO CASCADE;
 DROP TABLE IF EXISTS MODELOS_SORTEIO CASCADE;
 DROP TABLE IF EXISTS BASES_DADOS CASCADE;
+DROP TABLE IF EXISTS LOTES_GRAVADOS CASCADE;
 
 CREATE TABLE MODELOS_SORTEIO (
     id SERIAL PRIMARY KEY,
@@ -73,6 +74,12 @@ CREATE TABLE BOLAS_SORTEADAS (
     momento TIMESTAMPTZ DEFAULT CURRENT_TIMESTAMP
 );
 
+-- Marcas dos lotes do gravador (o servidor também cria se faltar)
+CREATE TABLE LOTES_GRAVADOS (
+    id VARCHAR(64) PRIMARY KEY,
+    gravado_em TIMESTAMPTZ DEFAULT CURRENT_TIMESTAMP
+);
+
 -- Inserção inicial de teste
 INSERT INTO MODELOS_SORTEIO (nome) VALUES ('Clássico 75');
 INSERT INTO MODELOS_SORTEIO (nome) VALUES ('75x15');
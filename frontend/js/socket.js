@@ -1,15 +1,69 @@
+// Decodificador CBOR (RFC 8949) do necessário para as mensagens do servidor:
+// inteiros, strings, arrays, mapas, booleanos/null e floats de 16/32/64 bits.
+function decodeCbor(buffer) {
+    const view = new DataView(buffer);
+    const bytes = new Uint8Array(buffer);
+    const utf8 = new TextDecoder();
+    let pos = 0;
+
+    const readLength = (info) => {
+        if (info < 24) return info;
+        if (info === 24) return view.getUint8(pos++);
+        if (info === 25) { const v = view.getUint16(pos); pos += 2; return v; }
+        if (info === 26) { const v = view.getUint32(pos); pos += 4; return v; }
+        if (info === 27) { const v = view.getUint32(pos) * 4294967296 + view.getUint32(pos + 4); pos += 8; return v; }
+        throw new Error('CBOR: tamanho indefinido não suportado');
+    };
+    const readHalf = () => {
+        const h = view.getUint16(pos); pos += 2;
+        const exp = (h >> 10) & 0x1f, frac = h & 0x3ff, sign = h & 0x8000 ? -1 : 1;
+        if (exp === 0) return sign * frac * Math.pow(2, -24);
+        if (exp === 31) return frac ? NaN : sign * Infinity;
+        return sign * (1 + frac / 1024) * Math.pow(2, exp - 15);
+    };
+    const read = () => {
+        const initial = bytes[pos++];
+        const major = initial >> 5, info = initial & 0x1f;
+        if (major === 7) {
+            if (info === 20) return false;
+            if (info === 21) return true;
+            if (info === 22 || info === 23) return null;
+            if (info === 25) return readHalf();
+            if (info === 26) { const v = view.getFloat32(pos); pos += 4; return v; }
+            if (info === 27) { const v = view.getFloat64(pos); pos += 8; return v; }
+            throw new Error('CBOR: simple value ' + info);
+        }
+        const len = readLength(info);
+        switch (major) {
+            case 0: return len;
+            case 1: return -1 - len;
+            case 2: { const v = bytes.slice(pos, pos + len); pos += len; return v; }
+            case 3: { const v = utf8.decode(bytes.subarray(pos, pos + len)); pos += len; return v; }
+            case 4: { const arr = new Array(len); for (let i = 0; i < len; i++) arr[i] = read(); return arr; }
+            case 5: { const obj = {}; for (let i = 0; i < len; i++) { const k = read(); obj[k] = read(); } return obj; }
+            case 6: return read(); // Tag: usa só o valor
+        }
+    };
+    return read();
+}
+
 class BingoSocket {
     constructor(url) {
         this.url = url;
         this.socket = null;
         this.callbacks = {};
         this.isConnected = false;
+        // Protocolo pedido no login: 'cbor' (frames binários, bem menores) ou 'json'
+        this.protocol = localStorage.getItem('bingo_protocol') || 'cbor';
+        this.state = null; // Último sync_status com os game_delta aplicados
+        this.seq = null;
         this.connect();
     }
 
     connect() {
         console.log(`Connecting to ${this.url}...`);
         this.socket = new WebSocket(this.url);
+        this.socket.binaryType = 'arraybuffer';
 
         this.socket.onopen = () => {
             console.log('WebSocket Connected');
@@ -20,7 +74,7 @@ class BingoSocket {
 
         this.socket.onmessage = (event) => {
             try {
-                const data = JSON.parse(event.data);
+                const data = typeof event.data === 'string' ? JSON.parse(event.data) : decodeCbor(event.data);
                 if (data.action === 'pong') return; // Ignore heatbeat response
                 this.handleMessage(data);
             } catch (e) {
@@ -59,6 +113,7 @@ class BingoSocket {
 
     send(action, payload = {}) {
         if (!this.isConnected) return;
+        if (action === 'login' && !payload.protocol) payload = { ...payload, protocol: this.protocol };
         const msg = JSON.stringify({ action, ...payload });
         this.socket.send(msg);
     }
@@ -97,14 +152,76 @@ class BingoSocket {
             }
         }
 
+        if (data.action === 'sync_status') {
+            this.state = data;
+            this.seq = data.seq ?? null;
+        }
+
+        if (data.action === 'game_delta') {
+            this.applyDelta(data);
+            return;
+        }
+
         if (data.action) {
             this.emit(data.action, data);
         }
     }
 
+    // Aplica um game_delta sobre o último sync_status e repassa aos ouvintes como o evento original
+    // (number_drawn, number_cancelled...) com o estado completo. Lacuna no seq pede um get_sync.
+    applyDelta(data) {
+        if (!this.state || this.seq === null) return;
+        if (data.seq <= this.seq) return;
+        if (data.seq !== this.seq + 1) {
+            console.warn(`Delta fora de sequência (esperado ${this.seq + 1}, recebido ${data.seq}). Pedindo sync.`);
+            this.seq = null;
+            this.send('get_sync');
+            return;
+        }
+        this.seq = data.seq;
+
+        const state = this.state;
+        if (data.balls_removed) state.drawnNumbers = state.drawnNumbers.slice(0, state.drawnNumbers.length - data.balls_removed);
+        if (data.balls_added) state.drawnNumbers = state.drawnNumbers.concat(data.balls_added);
+        if (data.totalRegistered !== undefined) state.totalRegistered = data.totalRegistered;
+        if (data.winners) state.winners = data.winners;
+        if (data.winners_added) state.winners = (state.winners || []).concat(data.winners_added);
+        if (data.winners_total !== undefined) state.winners_total = data.winners_total;
+        if (data.near_wins) state.near_wins = data.near_wins;
+        if (data.near_counts) state.near_counts = data.near_counts;
+        if (data.isFinished !== undefined) state.isFinished = data.isFinished;
+
+        (data.premios || []).forEach(d => {
+            const p = (state.engine_premios_status || []).find(s => s.id === d.id);
+            if (!p) return;
+            if (d.realizada !== undefined) p.realizada = d.realizada;
+            if (d.winners) p.winners = d.winners;
+            if (d.winners_added) p.winners = (p.winners || []).concat(d.winners_added);
+            if (d.winners_total !== undefined) p.winners_total = d.winners_total;
+            if (d.near_winners) p.near_winners = d.near_winners;
+            if (d.near_counts) p.near_counts = d.near_counts;
+        });
+        state.seq = data.seq;
+
+        const merged = { ...state, action: data.event };
+        ['number', 'position', 'prizeId', 'realizada', 'reabertos'].forEach(k => {
+            if (data[k] !== undefined) merged[k] = data[k];
+        });
+        if (data.event !== 'state_changed') this.emit(data.event, merged);
+        if (data.resync || data.event === 'state_changed') this.emit('sync_status', { ...state, action: 'sync_status' });
+    }
+
     login(chave) {
         this.send('login', { chave });
     }
+
+    // O sync traz só a prévia das listas (winners/near_winners) e o total; o resto vem em páginas.
+    // Resposta: evento 'prize_tickets' com tickets, total e nextCursor (null = fim).
+    getPrizeTickets(prizeId, kind = 'winners', cursor = null, limit = 50) {
+        const payload = { prizeId, kind, limit };
+        if (cursor !== null) payload.cursor = cursor;
+        this.send('get_prize_tickets', payload);
+    }
 }
 
 // Global instance (can be used by other scripts)
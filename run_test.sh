@@ -1,4 +1,6 @@
 #!/bin/bash
+echo "--- Engine Self-Test ---"
+./bin/BingoSysServer 0 --self-test || { echo "Autoteste do motor falhou."; exit 1; }
 RAW_KEY=$(./get_key.sh)
 KEY=$(echo "$RAW_KEY" | grep -o 'TEST-KEY-[0-9A-Za-z-]*' | head -n 1)
 echo "Using Key: $KEY"
@@ -0,0 +1,566 @@
+#include "BingoAuditor.h"
+#include "BingoDatabaseManager.h"
+#include "BingoServer.h"
+#include "BingoBaseStore.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QAtomicInt>
+#include <QRandomGenerator>
+#include <algorithm>
+
+namespace {
+
+const int MAX_BOLAS = 75; // Mesmo limite padrão do motor (setMaxBalls não é usado pelo servidor)
+
+// Linhas que completam o prêmio, em índices de célula. A grade é armazenada coluna a coluna
+// (idx = coluna * linhas + linha), com 5 colunas.
+QVector<QVector<int>> linhasDoPremio(const Prize &prize, int cellCount)
+{
+    QVector<QVector<int>> linhas;
+    if (prize.tipo == "quina") {
+        const int rows = cellCount / 5;
+        for (int r = 0; r < rows; ++r) {
+            QVector<int> linha;
+            for (int c = 0; c < 5; ++c) linha.append(c * rows + r);
+            linhas.append(linha);
+        }
+        if (rows == 5) {
+            for (int c = 0; c < 5; ++c) {
+                QVector<int> coluna;
+                for (int r = 0; r < 5; ++r) coluna.append(c * 5 + r);
+                linhas.append(coluna);
+            }
+            QVector<int> d1, d2;
+            for (int i = 0; i < 5; ++i) {
+                d1.append(i * 5 + i);
+                d2.append(i * 5 + (4 - i));
+            }
+            linhas.append(d1);
+            linhas.append(d2);
+        }
+    } else if (prize.tipo == "cheia") {
+        QVector<int> todas;
+        for (int i = 0; i < cellCount; ++i) todas.append(i);
+        linhas.append(todas);
+    } else if (prize.tipo == "forma" && !prize.padraoIndices.isEmpty()) {
+        QList<int> idxs = prize.padraoIndices.values();
+        std::sort(idxs.begin(), idxs.end());
+        QVector<int> forma;
+        for (int idx : idxs) {
+            if (idx >= 0 && idx < cellCount) forma.append(idx);
+        }
+        linhas.append(forma);
+    }
+    return linhas;
+}
+
+// Avaliador de referência: cada verificação percorre todas as cartelas registradas e
+// confere célula a célula contra as bolas sorteadas. Regras do jogo:
+// - turno sequencial: só o primeiro prêmio pendente que não é forma; formas correm em paralelo;
+// - a quina não repete, na mesma cartela e grade, uma linha já premiada;
+// - cheia encerra a cartela em todas as grades da base a partir da verificação seguinte;
+// - células 0 (ou fora de 1..127) não precisam ser marcadas.
+class ReferenceGame
+{
+public:
+    ReferenceGame(const QList<Prize> &prizes, const QHash<int, TicketBaseHandle> &bases, const QList<int> &cartelas)
+        : m_prizes(prizes), m_bases(bases), m_cartelas(cartelas)
+    {
+        std::sort(m_cartelas.begin(), m_cartelas.end());
+        m_cartelas.erase(std::unique(m_cartelas.begin(), m_cartelas.end()), m_cartelas.end());
+        m_bolaRealizada.fill(0, m_prizes.size());
+        for (auto &p : m_prizes) {
+            p.tipo = p.tipo.toLower();
+            p.realizada = false;
+            p.winners.clear();
+            p.winnerSet.clear();
+        }
+    }
+
+    const QList<Prize> &prizes() const { return m_prizes; }
+    int bolaRealizada(int i) const { return m_bolaRealizada[i]; }
+
+    // Venda depois do início: entra na verificação da próxima bola, como no motor
+    void registrar(int cartela)
+    {
+        auto it = std::lower_bound(m_cartelas.begin(), m_cartelas.end(), cartela);
+        if (it == m_cartelas.end() || *it != cartela) m_cartelas.insert(it, cartela);
+    }
+
+    void sortear(int numero)
+    {
+        if (numero < 1 || numero > MAX_BOLAS || m_marcadas[numero]) return;
+        m_marcadas[numero] = true;
+        ++m_bolas;
+        avaliar();
+
+        // Igual ao servidor ao vivo: prêmio com ganhador é marcado como realizado e o
+        // turno seguinte é avaliado na mesma bola
+        QVector<int> comGanhador;
+        for (int i = 0; i < m_prizes.size(); ++i) {
+            if (!m_prizes[i].realizada && !m_prizes[i].winners.isEmpty()) comGanhador.append(i);
+        }
+        for (int i : comGanhador) {
+            m_prizes[i].realizada = true;
+            m_bolaRealizada[i] = m_bolas;
+            avaliar();
+        }
+    }
+
+private:
+    bool marcada(int n) const { return n < 1 || n > 127 || m_marcadas[n]; }
+
+    void avaliar()
+    {
+        int turno = -1;
+        for (const auto &p : m_prizes) {
+            if (!p.realizada && p.tipo != "forma") { turno = p.id; break; }
+        }
+
+        QList<QPair<int, int>> fechadasAgora; // (base, cartela)
+        for (auto &p : m_prizes) {
+            if (p.realizada || (p.tipo != "forma" && p.id != turno)) continue;
+            const TicketBaseHandle base = m_bases.value(p.baseId);
+            if (!base || p.gridIndex < 0 || p.gridIndex >= base->gridCount()) continue;
+            const QVector<QVector<int>> linhas = linhasDoPremio(p, base->cellCount(p.gridIndex));
+            if (linhas.isEmpty()) continue;
+
+            QHash<int, quint32> &usadas = m_linhasUsadas[qMakePair(p.baseId, p.gridIndex)];
+            const QSet<int> fechadas = m_fechadas.value(p.baseId);
+            for (int cartela : m_cartelas) {
+                if (fechadas.contains(cartela) || p.winnerSet.contains(cartela)) continue;
+                const int row = base->rowOf(cartela);
+                if (row < 0) continue;
+                const TicketBase::GridView grade = base->grid(row, p.gridIndex);
+                if (std::all_of(grade.begin(), grade.end(), [](quint8 n) { return n == 0; })) continue;
+
+                int ganhou = -1;
+                for (int l = 0; l < linhas.size() && ganhou < 0; ++l) {
+                    if (p.tipo == "quina" && (usadas.value(cartela) & (1u << l))) continue;
+                    bool completa = true;
+                    for (int idx : linhas[l]) {
+                        if (!marcada(grade[idx])) { completa = false; break; }
+                    }
+                    if (completa) ganhou = l;
+                }
+                if (ganhou < 0) continue;
+
+                p.winners.append(cartela);
+                p.winnerSet.insert(cartela);
+                if (p.tipo == "quina") usadas[cartela] |= (1u << ganhou);
+                if (p.tipo == "cheia") fechadasAgora.append(qMakePair(p.baseId, cartela));
+            }
+        }
+        for (const auto &bc : fechadasAgora) m_fechadas[bc.first].insert(bc.second);
+    }
+
+    QList<Prize> m_prizes;
+    QHash<int, TicketBaseHandle> m_bases;
+    QList<int> m_cartelas;
+    bool m_marcadas[128] = {};
+    QVector<int> m_bolaRealizada;
+    int m_bolas = 0;
+    QHash<QPair<int, int>, QHash<int, quint32>> m_linhasUsadas; // (base, grade) -> cartela -> linhas
+    QHash<int, QSet<int>> m_fechadas;                            // base -> cartelas com cheia
+};
+
+QString listaIds(const QList<int> &ids)
+{
+    QStringList parts;
+    for (int id : ids) parts << QString::number(id);
+    return "[" + parts.join(", ") + "]";
+}
+
+// --- Autoteste do motor (--self-test) ---
+
+const int TESTE_BASE_ID = 1;
+const int TESTE_CARTELAS = 400;
+
+// Base fixa e pequena: duas grades 5x5 por cartela (coluna a coluna, 5 números de cada faixa),
+// a primeira com o centro livre (0). Mesma semente = mesma base em qualquer máquina.
+TicketBaseHandle baseDeTeste()
+{
+    QRandomGenerator rng(20260201);
+    TicketBase base;
+    base.reserve(TESTE_CARTELAS);
+    for (int id = 1; id <= TESTE_CARTELAS; ++id) {
+        QVector<QVector<int>> grades;
+        for (int g = 0; g < 2; ++g) {
+            QVector<int> grade;
+            for (int c = 0; c < 5; ++c) {
+                QVector<int> faixa;
+                for (int n = c * 15 + 1; n <= c * 15 + 15; ++n) faixa.append(n);
+                std::shuffle(faixa.begin(), faixa.end(), rng);
+                for (int r = 0; r < 5; ++r) grade.append(faixa[r]);
+            }
+            if (g == 0) grade[2 * 5 + 2] = 0;
+            // Um terço repete a grade 0 na grade 1: quem fecha a cheia de uma fecharia a da outra
+            // na mesma bola, o que só não acontece se o encerramento por cheia estiver certo
+            grades.append(g == 1 && id % 3 == 0 ? grades[0] : grade);
+        }
+        base.append(id, id % 10, grades);
+    }
+    base.squeeze();
+    base.buildBallIndex();
+    return TicketBaseHandle(new TicketBase(base));
+}
+
+// Turno sequencial quina -> quina (não pode repetir a linha da primeira) -> cheia da grade 0 ->
+// cheia da grade 1 (quem fechou a grade 0 está fora), com uma forma na grade 1 em paralelo
+QList<Prize> premiosDeTeste()
+{
+    auto premio = [](int id, const QString &tipo, int grade, const QSet<int> &padrao = QSet<int>()) {
+        Prize p;
+        p.id = id;
+        p.nome = QString("%1 G%2").arg(tipo.toUpper()).arg(grade);
+        p.tipo = tipo;
+        p.baseId = TESTE_BASE_ID;
+        p.gridIndex = grade;
+        p.padraoIndices = padrao;
+        return p;
+    };
+    return {premio(1, "quina", 0), premio(2, "quina", 0), premio(3, "forma", 1, {0, 4, 12, 20, 24}),
+            premio(4, "cheia", 0), premio(5, "cheia", 1)};
+}
+
+QList<int> vendasDeTeste()
+{
+    QList<int> vendas;
+    for (int id = 1; id <= TESTE_CARTELAS; ++id) {
+        if (id % 4 != 0) vendas.append(id); // Cartelas múltiplas de 4 ficam sem venda
+    }
+    return vendas;
+}
+
+void montarMotor(BingoGameEngine &engine, const TicketBaseHandle &base)
+{
+    engine.loadBase(TESTE_BASE_ID, base);
+    for (const Prize &p : premiosDeTeste()) engine.addPrize(p);
+    engine.registerTickets(vendasDeTeste());
+    engine.setGameMode(0);
+}
+
+// Automação do servidor após cada bola: prêmio com ganhador é realizado
+void realizarComGanhador(BingoGameEngine &engine, const QSet<int> &somente = QSet<int>(), bool filtrar = false)
+{
+    QList<int> realizar;
+    for (const auto &p : engine.getPrizes()) {
+        if (filtrar && !somente.contains(p.id)) continue;
+        if (p.active && !p.realizada && !p.winners.isEmpty()) realizar.append(p.id);
+    }
+    for (int id : realizar) engine.setPrizeStatus(id, true);
+}
+
+QSet<int> realizados(const BingoGameEngine &engine)
+{
+    QSet<int> ids;
+    for (const auto &p : engine.getPrizes()) {
+        if (p.realizada) ids.insert(p.id);
+    }
+    return ids;
+}
+
+// Diferenças de estado observável entre dois motores (ganhadores, status, armados e bolas)
+QStringList compararMotores(const BingoGameEngine &a, const BingoGameEngine &b)
+{
+    QStringList diffs;
+    if (a.getDrawnNumbers() != b.getDrawnNumbers()) diffs << "bolas sorteadas diferentes";
+    if (a.getWinners() != b.getWinners()) diffs << QString("ganhadores globais %1 x %2").arg(listaIds(a.getWinners()), listaIds(b.getWinners()));
+    const QList<Prize> pa = a.getPrizes();
+    const QList<Prize> pb = b.getPrizes();
+    for (int i = 0; i < pa.size() && i < pb.size(); ++i) {
+        if (pa[i].winners != pb[i].winners) {
+            diffs << QString("prêmio %1: ganhadores %2 x %3").arg(pa[i].id).arg(listaIds(pa[i].winners), listaIds(pb[i].winners));
+        }
+        if (pa[i].realizada != pb[i].realizada) diffs << QString("prêmio %1: realizada %2 x %3").arg(pa[i].id).arg(pa[i].realizada).arg(pb[i].realizada);
+        if (a.getNearWinCounts(pa[i].id) != b.getNearWinCounts(pb[i].id)) diffs << QString("prêmio %1: armados diferentes").arg(pa[i].id);
+    }
+    return diffs;
+}
+
+} // namespace
+
+int BingoAuditor::SorteioResult::divergencias() const
+{
+    int total = erro.isEmpty() ? 0 : 1;
+    for (const auto &p : premios) total += p.divergencias.size();
+    return total;
+}
+
+BingoAuditor::BingoAuditor(BingoDatabaseManager *db)
+    : m_db(db)
+{
+}
+
+QList<BingoAuditor::SorteioResult> BingoAuditor::run(const QList<int> &sorteioIds)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    // Leitura do banco em série (a conexão é única); sem lista, entram os sorteios com bolas
+    QList<int> ids = sorteioIds;
+    if (ids.isEmpty()) {
+        const QJsonArray sorteios = m_db->listarTodosSorteios();
+        for (const QJsonValue &v : sorteios) ids.append(v.toObject()["id"].toInt());
+        std::sort(ids.begin(), ids.end());
+    }
+
+    QVector<Job> jobs;
+    for (int id : ids) {
+        Job job;
+        job.sorteioId = id;
+        job.bolas = m_db->getBolasSorteadas(id);
+        if (sorteioIds.isEmpty() && job.bolas.isEmpty()) continue;
+        job.rodadas = m_db->getRodadas(id);
+        job.cartelas = m_db->getCartelasValidadas(id);
+        jobs.append(job);
+    }
+    qInfo() << "Auditoria:" << jobs.size() << "sorteio(s) lidos do banco em" << timer.elapsed() << "ms";
+
+    // Um sorteio por thread, com fila única e contador atômico
+    const int threads = qMax(1, qMin(m_threads > 0 ? m_threads : QThread::idealThreadCount(), jobs.size()));
+    QVector<SorteioResult> results(jobs.size());
+    QAtomicInt next(0);
+    auto work = [&jobs, &results, &next]() {
+        for (int i = next.fetchAndAddRelaxed(1); i < jobs.size(); i = next.fetchAndAddRelaxed(1)) {
+            results[i] = audit(jobs[i]);
+        }
+    };
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+    for (int t = 0; t < threads - 1; ++t) pool.start(QRunnable::create(work));
+    work();
+    pool.waitForDone();
+
+    qInfo() << "Auditoria:" << jobs.size() << "sorteio(s) reavaliados com" << threads << "thread(s) em" << timer.elapsed() << "ms";
+    return QList<SorteioResult>(results.begin(), results.end());
+}
+
+BingoAuditor::SorteioResult BingoAuditor::audit(const Job &job)
+{
+    QElapsedTimer timer;
+    timer.start();
+    SorteioResult result;
+    result.sorteioId = job.sorteioId;
+    result.cartelas = job.cartelas.size();
+    result.bolas = job.bolas.size();
+
+    if (job.rodadas.isEmpty()) {
+        result.erro = "sorteio sem rodadas cadastradas";
+        return result;
+    }
+
+    QHash<int, TicketBaseHandle> bases;
+    const QHash<int, QString> basePaths = BingoServer::basePathsFromRodadas(job.rodadas);
+    for (auto it = basePaths.constBegin(); it != basePaths.constEnd(); ++it) {
+        TicketBaseHandle base = it.value().isEmpty() ? TicketBaseHandle() : BingoBaseStore::instance().acquire(it.value());
+        if (!base) {
+            result.erro = QString("base %1 não pôde ser lida (%2)").arg(it.key()).arg(it.value());
+            return result;
+        }
+        bases.insert(it.key(), base);
+    }
+    const QList<Prize> prizes = BingoServer::prizesFromRodadas(job.rodadas, bases);
+
+    // Referência por força bruta
+    ReferenceGame reference(prizes, bases, job.cartelas);
+    for (int bola : job.bolas) reference.sortear(bola);
+
+    // Motor otimizado com a mesma sequência e a mesma automação do servidor
+    BingoGameEngine engine;
+    for (auto it = bases.constBegin(); it != bases.constEnd(); ++it) engine.loadBase(it.key(), it.value());
+    for (Prize p : prizes) {
+        p.realizada = false;
+        engine.addPrize(p);
+    }
+    engine.registerTickets(job.cartelas);
+    engine.setGameMode(0);
+    QHash<int, int> bolaRealizadaMotor;
+    int sorteadas = 0;
+    for (int bola : job.bolas) {
+        engine.processNumber(bola);
+        if (engine.getDrawnNumbers().size() == sorteadas) continue; // Bola recusada (repetida/fora da faixa)
+        sorteadas = engine.getDrawnNumbers().size();
+        const QList<Prize> atual = engine.getPrizes();
+        for (const auto &p : atual) {
+            if (p.active && !p.realizada && !p.winners.isEmpty()) {
+                engine.setPrizeStatus(p.id, true);
+                bolaRealizadaMotor.insert(p.id, sorteadas);
+            }
+        }
+    }
+
+    const QList<Prize> motor = engine.getPrizes();
+    for (int i = 0; i < prizes.size(); ++i) {
+        const Prize &ref = reference.prizes()[i];
+        PrizeResult pr;
+        pr.prizeId = ref.id;
+        pr.nome = ref.nome;
+        pr.realizadaBanco = prizes[i].realizada;
+        pr.ganhadores = ref.winners;
+        pr.bolaRealizada = reference.bolaRealizada(i);
+        pr.ganhadoresMotor = motor[i].winners;
+        pr.bolaRealizadaMotor = bolaRealizadaMotor.value(ref.id);
+
+        if (pr.ganhadoresMotor != pr.ganhadores) {
+            pr.divergencias << QString("motor aponta ganhadores %1, referência %2").arg(listaIds(pr.ganhadoresMotor), listaIds(pr.ganhadores));
+        }
+        if (pr.bolaRealizadaMotor != pr.bolaRealizada) {
+            pr.divergencias << QString("motor realiza na bola %1, referência na bola %2").arg(pr.bolaRealizadaMotor).arg(pr.bolaRealizada);
+        }
+        const bool deveEstarRealizada = !pr.ganhadores.isEmpty();
+        if (pr.realizadaBanco && !deveEstarRealizada) {
+            pr.divergencias << "realizada no banco, mas a referência não encontrou ganhador";
+        } else if (!pr.realizadaBanco && deveEstarRealizada) {
+            pr.divergencias << QString("pendente no banco, mas a referência encontrou %1 ganhador(es)").arg(pr.ganhadores.size());
+        }
+        result.premios.append(pr);
+    }
+    result.ms = timer.elapsed();
+    return result;
+}
+
+int BingoAuditor::printReport(const QList<SorteioResult> &results)
+{
+    int total = 0;
+    int comDivergencia = 0;
+    for (const auto &r : results) {
+        const int div = r.divergencias();
+        total += div;
+        if (div) comDivergencia++;
+
+        if (!r.erro.isEmpty()) {
+            qWarning().noquote() << QString("Sorteio %1: ERRO - %2").arg(r.sorteioId).arg(r.erro);
+            continue;
+        }
+        qInfo().noquote() << QString("Sorteio %1: %2 cartelas, %3 bolas, %4 ms - %5")
+                             .arg(r.sorteioId).arg(r.cartelas).arg(r.bolas).arg(r.ms)
+                             .arg(div ? QString("%1 divergência(s)").arg(div) : QString("OK"));
+        for (const auto &p : r.premios) {
+            qInfo().noquote() << QString("  Prêmio %1 %2: %3, banco %4, ganhadores %5")
+                                 .arg(p.prizeId).arg(p.nome)
+                                 .arg(p.bolaRealizada ? QString("saiu na bola %1").arg(p.bolaRealizada) : QString("não saiu"))
+                                 .arg(p.realizadaBanco ? "REALIZADO" : "PENDENTE")
+                                 .arg(listaIds(p.ganhadores));
+            for (const QString &d : p.divergencias) qWarning().noquote() << "    DIVERGÊNCIA:" << d;
+        }
+    }
+    qInfo().noquote() << QString("Auditoria concluída: %1 sorteio(s), %2 com divergência, %3 divergência(s) no total")
+                         .arg(results.size()).arg(comDivergencia).arg(total);
+    return total;
+}
+
+int BingoAuditor::selfTest(int rodadas)
+{
+    QElapsedTimer timer;
+    timer.start();
+    const TicketBaseHandle base = baseDeTeste();
+    const QList<Prize> prizes = premiosDeTeste();
+    int falhas = 0;
+    auto falhou = [&falhas](const QString &caso, const QStringList &diffs) {
+        falhas += diffs.size();
+        for (const QString &d : diffs) qWarning().noquote() << "  FALHA" << caso << "-" << d;
+    };
+
+    QList<int> cobertura; // Bola em que cada prêmio saiu, somada entre as rodadas (0 = nunca saiu)
+    for (int i = 0; i < prizes.size(); ++i) cobertura.append(0);
+
+    for (int rodada = 0; rodada < rodadas; ++rodada) {
+        QList<int> bolas;
+        for (int n = 1; n <= MAX_BOLAS; ++n) bolas.append(n);
+        std::shuffle(bolas.begin(), bolas.end(), QRandomGenerator(1000 + rodada));
+
+        // 1. Motor x referência por força bruta, bola a bola, com vendas entrando no meio do jogo
+        QList<int> iniciais, tardias;
+        for (int id : vendasDeTeste()) (id % 13 == 0 ? tardias : iniciais).append(id);
+        ReferenceGame reference(prizes, {{TESTE_BASE_ID, base}}, iniciais);
+        BingoGameEngine engine;
+        engine.loadBase(TESTE_BASE_ID, base);
+        for (const Prize &p : prizes) engine.addPrize(p);
+        engine.registerTickets(iniciais);
+        engine.setGameMode(0);
+        for (int i = 0; i < bolas.size(); ++i) {
+            if (i == 10) {
+                for (int id : tardias) {
+                    engine.registerTicket(id);
+                    reference.registrar(id);
+                }
+            }
+            reference.sortear(bolas[i]);
+            engine.processNumber(bolas[i]);
+            realizarComGanhador(engine);
+
+            const QList<Prize> motor = engine.getPrizes();
+            QStringList diffs;
+            for (int p = 0; p < prizes.size(); ++p) {
+                const Prize &ref = reference.prizes()[p];
+                if (motor[p].winners != ref.winners) {
+                    diffs << QString("prêmio %1 (%2): motor %3, referência %4").arg(ref.id).arg(ref.nome, listaIds(motor[p].winners), listaIds(ref.winners));
+                }
+                if (motor[p].realizada != ref.realizada) diffs << QString("prêmio %1: status realizada diverge").arg(ref.id);
+                if (ref.realizada && !cobertura[p]) cobertura[p] = i + 1;
+            }
+            if (!diffs.isEmpty()) {
+                falhou(QString("rodada %1, bola %2 (%3)").arg(rodada).arg(i + 1).arg(bolas[i]), diffs);
+                break; // O resto da rodada só repetiria a mesma divergência
+            }
+        }
+
+        // 2. Undo pelo journal x reset e replay sem a última bola
+        for (int k = 5; k <= bolas.size(); k += 7) {
+            BingoGameEngine atual, replay;
+            montarMotor(atual, base);
+            montarMotor(replay, base);
+            for (int i = 0; i < k; ++i) {
+                atual.processNumber(bolas[i]);
+                realizarComGanhador(atual);
+                if (i < k - 1) {
+                    replay.processNumber(bolas[i]);
+                    realizarComGanhador(replay);
+                }
+            }
+            const int desfeita = atual.undoLastNumber(realizados(atual));
+            QStringList diffs = compararMotores(atual, replay);
+            if (desfeita != bolas[k - 1]) diffs << QString("undo devolveu %1, esperado %2").arg(desfeita).arg(bolas[k - 1]);
+            falhou(QString("rodada %1, undo da bola %2").arg(rodada).arg(k), diffs);
+        }
+
+        // 3. correctNumber x reset e replay da sequência corrigida (mesma regra de reabertura)
+        const int total = 40;
+        for (int pos = 0; pos < total; pos += 9) {
+            BingoGameEngine atual, replay;
+            montarMotor(atual, base);
+            montarMotor(replay, base);
+            for (int i = 0; i < total; ++i) {
+                atual.processNumber(bolas[i]);
+                realizarComGanhador(atual);
+            }
+            const QSet<int> antes = realizados(atual);
+            const int nova = bolas[total + pos % (bolas.size() - total)]; // Bola ainda não sorteada
+            if (!atual.correctNumber(pos, nova, antes)) {
+                falhou(QString("rodada %1, correção da posição %2").arg(rodada).arg(pos), {"correctNumber recusou a correção"});
+                continue;
+            }
+            QList<int> corrigida = bolas.mid(0, total);
+            corrigida[pos] = nova;
+            for (int n : corrigida) {
+                replay.processNumber(n);
+                realizarComGanhador(replay, antes, true);
+            }
+            falhou(QString("rodada %1, correção da posição %2").arg(rodada).arg(pos), compararMotores(atual, replay));
+        }
+    }
+
+    // Um teste em que algum prêmio nunca sai não exercita a regra dele
+    for (int p = 0; p < prizes.size(); ++p) {
+        if (!cobertura[p]) falhou("cobertura", {QString("prêmio %1 (%2) não saiu em nenhuma rodada").arg(prizes[p].id).arg(prizes[p].nome)});
+    }
+
+    qInfo().noquote() << QString("Autoteste do motor: %1 rodada(s), %2 cartelas, %3 ms - %4")
+                         .arg(rodadas).arg(TESTE_CARTELAS).arg(timer.elapsed())
+                         .arg(falhas ? QString("%1 falha(s)").arg(falhas) : QString("OK"));
+    return falhas;
+}
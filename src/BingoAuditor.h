@@ -0,0 +1,73 @@
+#ifndef BINGOAUDITOR_H
+#define BINGOAUDITOR_H
+
+#include <QList>
+#include <QHash>
+#include <QStringList>
+#include <QJsonArray>
+#include "BingoGameEngine.h"
+
+class BingoDatabaseManager;
+
+// Auditoria offline de sorteios (--audit-sorteio). Cada sorteio é refeito a partir do banco
+// (rodadas, bases, vendas e bolas) com um avaliador de referência por força bruta, que confere
+// cartela a cartela sem nenhuma estrutura incremental. O resultado é comparado com o motor
+// otimizado, alimentado com a mesma sequência, e com PREMIOS.realizada.
+// Os dados vêm do banco numa única thread; a reavaliação roda em paralelo, um sorteio por thread.
+class BingoAuditor
+{
+public:
+    struct PrizeResult {
+        int prizeId = 0;
+        QString nome;
+        bool realizadaBanco = false;
+        QList<int> ganhadores;       // Avaliador de referência
+        QList<int> ganhadoresMotor;  // Motor otimizado
+        int bolaRealizada = 0;       // Quantidade de bolas quando o prêmio saiu (0 = não saiu)
+        int bolaRealizadaMotor = 0;
+        QStringList divergencias;
+    };
+
+    struct SorteioResult {
+        int sorteioId = 0;
+        int cartelas = 0;
+        int bolas = 0;
+        qint64 ms = 0;
+        QString erro;
+        QList<PrizeResult> premios;
+
+        int divergencias() const;
+    };
+
+    explicit BingoAuditor(BingoDatabaseManager *db);
+
+    // Threads da reavaliação (0 = todos os núcleos)
+    void setThreads(int threads) { m_threads = threads; }
+
+    // Lista vazia = todos os sorteios com bolas sorteadas
+    QList<SorteioResult> run(const QList<int> &sorteioIds);
+
+    // Imprime o relatório e retorna o total de divergências
+    static int printReport(const QList<SorteioResult> &results);
+
+    // Autoteste do motor (--self-test): base fixa em memória, sem banco. Confere bola a bola
+    // contra a referência (quina sem repetir linha, cheia fechando a cartela em todas as
+    // grades, forma em paralelo ao turno, vendas tardias) e o undo/correctNumber contra
+    // reset e replay. Retorna o número de falhas.
+    static int selfTest(int rodadas = 8);
+
+private:
+    struct Job {
+        int sorteioId = 0;
+        QJsonArray rodadas;
+        QList<int> cartelas;
+        QList<int> bolas;
+    };
+
+    static SorteioResult audit(const Job &job);
+
+    BingoDatabaseManager *m_db;
+    int m_threads = 0;
+};
+
+#endif // BINGOAUDITOR_H
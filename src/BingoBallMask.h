@@ -0,0 +1,60 @@
+#ifndef BINGOBALLMASK_H
+#define BINGOBALLMASK_H
+
+#include <QtGlobal>
+#include <QtAlgorithms>
+
+// Conjunto de bolas 1..75 (até 127) representado como máscara de 128 bits.
+// O bit N corresponde à bola N; o bit 0 nunca é usado.
+// Permite que "está sorteada?" seja um teste de bit e "quantas faltam?" um popcount.
+struct BallMask {
+    quint64 lo = 0; // bolas 0..63
+    quint64 hi = 0; // bolas 64..127
+
+    static bool isValidBall(int n) { return n > 0 && n < 128; }
+
+    void set(int n) {
+        if (!isValidBall(n)) return;
+        if (n < 64) lo |= (quint64(1) << n);
+        else hi |= (quint64(1) << (n - 64));
+    }
+
+    void reset(int n) {
+        if (!isValidBall(n)) return;
+        if (n < 64) lo &= ~(quint64(1) << n);
+        else hi &= ~(quint64(1) << (n - 64));
+    }
+
+    bool test(int n) const {
+        if (!isValidBall(n)) return false;
+        if (n < 64) return (lo >> n) & 1;
+        return (hi >> (n - 64)) & 1;
+    }
+
+    void clear() { lo = 0; hi = 0; }
+    bool isEmpty() const { return (lo | hi) == 0; }
+    int count() const { return qPopulationCount(lo) + qPopulationCount(hi); }
+
+    // Bolas deste conjunto que NÃO estão em 'other' (ex: grade & ~sorteadas)
+    BallMask andNot(const BallMask &other) const {
+        BallMask r;
+        r.lo = lo & ~other.lo;
+        r.hi = hi & ~other.hi;
+        return r;
+    }
+
+    // Quantas bolas deste conjunto ainda não estão em 'drawn'
+    int missingIn(const BallMask &drawn) const { return andNot(drawn).count(); }
+
+    // True se todas as bolas deste conjunto estão em 'drawn'
+    bool isSubsetOf(const BallMask &drawn) const {
+        return ((lo & ~drawn.lo) | (hi & ~drawn.hi)) == 0;
+    }
+
+    BallMask &operator|=(const BallMask &o) { lo |= o.lo; hi |= o.hi; return *this; }
+    BallMask operator&(const BallMask &o) const { BallMask r; r.lo = lo & o.lo; r.hi = hi & o.hi; return r; }
+    bool operator==(const BallMask &o) const { return lo == o.lo && hi == o.hi; }
+    bool operator!=(const BallMask &o) const { return !(*this == o); }
+};
+
+#endif // BINGOBALLMASK_H
@@ -0,0 +1,148 @@
+#include "BingoBaseStore.h"
+#include "BingoTicketParser.h"
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QDebug>
+#include <algorithm>
+
+BingoBaseStore &BingoBaseStore::instance()
+{
+    static BingoBaseStore store;
+    return store;
+}
+
+TicketBaseHandle BingoBaseStore::acquire(const QString &filePath)
+{
+    QFileInfo info(filePath);
+    {
+        // Arquivo já visto e inalterado: reaproveita sem abrir de novo
+        QMutexLocker locker(&m_mutex);
+        auto file = m_files.constFind(filePath);
+        if (file != m_files.constEnd() && file->size == info.size() && file->modified == info.lastModified()) {
+            auto it = m_entries.find(file->hash);
+            if (it != m_entries.end()) return handleFor(file->hash, it.value());
+        }
+    }
+
+    // Leitura fora do lock: outros sorteios continuam pegando bases já carregadas
+    TicketBase base = BingoTicketParser::loadBase(filePath);
+    if (base.isEmpty()) return TicketBaseHandle();
+    if (!base.hasBallIndex()) base.buildBallIndex(); // Índice invertido único, usado por todos os motores
+    const quint64 hash = base.contentHash(); // .bbase: lido do header; só base em texto percorre o conteúdo
+
+    QMutexLocker locker(&m_mutex);
+    FileState state;
+    state.hash = hash;
+    state.size = info.size();
+    state.modified = info.lastModified();
+    m_files.insert(filePath, state);
+
+    auto it = m_entries.find(hash);
+    if (it != m_entries.end()) {
+        qInfo() << "BaseStore:" << filePath << "tem o mesmo conteúdo de uma base já carregada, reaproveitando";
+        return handleFor(hash, it.value());
+    }
+
+    Entry entry;
+    entry.base = base;
+    entry.bytes = base.memoryBytes();
+    it = m_entries.insert(hash, entry);
+    m_used += entry.bytes;
+    TicketBaseHandle handle = handleFor(hash, it.value());
+    qInfo() << "BaseStore: base" << filePath << "carregada (" << entry.bytes / 1024 << "KB ), total"
+            << m_used / (1024 * 1024) << "MB em" << m_entries.size() << "bases";
+    trimLocked();
+    return handle;
+}
+
+TicketBaseHandle BingoBaseStore::handleFor(quint64 hash, Entry &entry)
+{
+    entry.lastUsed = ++m_clock;
+    TicketBaseHandle handle = entry.live.toStrongRef();
+    if (handle) return handle;
+
+    // Primeiro usuário: o handle avisa o store quando o último motor o soltar
+    handle = TicketBaseHandle(new TicketBase(entry.base), [this, hash](const TicketBase *base) {
+        delete base;
+        release(hash);
+    });
+    entry.live = handle;
+    return handle;
+}
+
+void BingoBaseStore::release(quint64 hash)
+{
+    QMutexLocker locker(&m_mutex);
+    auto it = m_entries.find(hash);
+    if (it == m_entries.end()) return;
+    it->lastUsed = ++m_clock;
+    trimLocked();
+}
+
+void BingoBaseStore::trim()
+{
+    QMutexLocker locker(&m_mutex);
+    trimLocked();
+}
+
+void BingoBaseStore::trimLocked()
+{
+    if (m_budget <= 0 || m_used <= m_budget) return;
+
+    QVector<QPair<quint64, quint64>> idle; // (lastUsed, hash)
+    for (auto it = m_entries.constBegin(); it != m_entries.constEnd(); ++it) {
+        if (it->live.isNull()) idle.append(qMakePair(it->lastUsed, it.key()));
+    }
+    std::sort(idle.begin(), idle.end());
+
+    for (const auto &candidate : idle) {
+        if (m_used <= m_budget) break;
+        auto it = m_entries.find(candidate.second);
+        m_used -= it->bytes;
+        qInfo() << "BaseStore: descartando base sem uso (" << it->bytes / 1024 << "KB )";
+        m_entries.erase(it);
+        for (auto file = m_files.begin(); file != m_files.end(); ) {
+            if (file->hash == candidate.second) file = m_files.erase(file);
+            else ++file;
+        }
+    }
+    if (m_used > m_budget) {
+        qWarning() << "BaseStore: bases em uso somam" << m_used / (1024 * 1024) << "MB, acima do orçamento de"
+                   << m_budget / (1024 * 1024) << "MB";
+    }
+}
+
+void BingoBaseStore::setMemoryBudget(qint64 bytes)
+{
+    QMutexLocker locker(&m_mutex);
+    m_budget = bytes;
+    trimLocked();
+}
+
+qint64 BingoBaseStore::memoryBudget() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_budget;
+}
+
+qint64 BingoBaseStore::memoryUsed() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_used;
+}
+
+int BingoBaseStore::baseCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_entries.size();
+}
+
+int BingoBaseStore::liveCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    int live = 0;
+    for (const auto &entry : m_entries) {
+        if (!entry.live.isNull()) live++;
+    }
+    return live;
+}
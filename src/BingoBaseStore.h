@@ -0,0 +1,62 @@
+#ifndef BINGOBASESTORE_H
+#define BINGOBASESTORE_H
+
+#include <QHash>
+#include <QMutex>
+#include <QDateTime>
+#include "BingoTicketBase.h"
+
+// Repositório das bases de cartelas do processo. Cada base fica carregada uma única vez,
+// identificada pelo hash do conteúdo (arquivos iguais em caminhos diferentes se juntam),
+// e os motores recebem handles somente leitura para a mesma instância.
+// Bases que nenhum sorteio está usando continuam em cache até o orçamento de memória
+// estourar; aí saem as usadas há mais tempo (LRU).
+class BingoBaseStore
+{
+public:
+    static BingoBaseStore &instance();
+
+    // Carrega (ou reaproveita) a base do arquivo. Handle nulo se a base não pôde ser lida.
+    TicketBaseHandle acquire(const QString &filePath);
+
+    // Orçamento em bytes (0 = sem limite). Bases mapeadas de .bbase contam só o heap,
+    // as páginas do arquivo ficam no page cache do sistema.
+    void setMemoryBudget(qint64 bytes);
+    qint64 memoryBudget() const;
+    qint64 memoryUsed() const;
+    int baseCount() const;
+    int liveCount() const;
+
+    // Descarta bases sem uso, das mais antigas para as mais novas, até caber no orçamento
+    void trim();
+
+private:
+    BingoBaseStore() = default;
+    Q_DISABLE_COPY(BingoBaseStore)
+
+    struct Entry {
+        TicketBase base;                     // Mantém os dados enquanto estiver no cache
+        QWeakPointer<const TicketBase> live; // Handle entregue aos motores (nulo = sem uso)
+        qint64 bytes = 0;
+        quint64 lastUsed = 0;
+    };
+
+    struct FileState {
+        quint64 hash = 0;
+        qint64 size = 0;
+        QDateTime modified;
+    };
+
+    TicketBaseHandle handleFor(quint64 hash, Entry &entry);
+    void release(quint64 hash);
+    void trimLocked();
+
+    mutable QMutex m_mutex;
+    QHash<quint64, Entry> m_entries;    // hash do conteúdo -> base
+    QHash<QString, FileState> m_files;  // caminho -> hash (válido enquanto o arquivo não mudar)
+    qint64 m_budget = 2048LL * 1024 * 1024;
+    qint64 m_used = 0;
+    quint64 m_clock = 0;
+};
+
+#endif // BINGOBASESTORE_H
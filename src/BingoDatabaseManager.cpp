@@ -4,11 +4,55 @@
 #include <QJsonDocument>
 #include <QFile>
 #include <QTextStream>
+#include <climits>
 
-BingoDatabaseManager::BingoDatabaseManager(QObject *parent) : QObject(parent)
+BingoDatabaseManager::BingoDatabaseManager(QObject *parent)
+    : QObject(parent),
+      m_writer(new BingoDbWriter(this))
 {
 }
 
+BingoDatabaseManager::~BingoDatabaseManager()
+{
+    // Grava o que ainda estiver na fila antes de fechar
+    delete m_writer;
+}
+
+QString BingoDatabaseManager::escopoPremio(int premioId) const
+{
+    // Prêmio de sorteio em cache grava no escopo do sorteio; os demais num escopo comum
+    const int rodadaId = m_premioRodada.value(premioId, -1);
+    auto sid = m_rodadaSorteio.constFind(rodadaId);
+    return sid != m_rodadaSorteio.constEnd() ? escopoSorteio(sid.value()) : QString("premios");
+}
+
+void BingoDatabaseManager::gravar(const QString &escopo, const QString &descricao, const QString &sql,
+                                  const BingoDbWriter::Binds &binds, Concluido concluido)
+{
+    m_ultimaGravacao.insert(escopo, m_writer->enqueue(descricao, sql, binds, concluido));
+}
+
+bool BingoDatabaseManager::aguardarEscopo(const QString &escopo)
+{
+    auto it = m_ultimaGravacao.find(escopo);
+    if (it == m_ultimaGravacao.end()) return true;
+    const quint64 seq = it.value();
+    // Já gravado: volta na hora, sem esperar o resto da fila (nem com o banco fora do ar)
+    if (!m_writer->waitFor(seq)) {
+        qWarning() << "[DB] Leitura de" << escopo << "com gravações ainda pendentes: as linhas podem estar atrasadas";
+        return false;
+    }
+    it = m_ultimaGravacao.find(escopo);
+    if (it != m_ultimaGravacao.end() && it.value() == seq) m_ultimaGravacao.erase(it);
+    return true;
+}
+
+bool BingoDatabaseManager::temGravacaoPendente(int sorteioId) const
+{
+    const quint64 seq = m_ultimaGravacao.value(escopoSorteio(sorteioId));
+    return seq && !m_writer->isPersisted(seq);
+}
+
 bool BingoDatabaseManager::connectToDatabase(const QString &host, const QString &dbName, const QString &user, const QString &pass)
 {
     qInfo() << "Tentando conectar ao banco:" << host << "BD:" << dbName << "User:" << user << "Senha (size):" << pass.length();
@@ -23,11 +67,13 @@ bool BingoDatabaseManager::connectToDatabase(const QString &host, const QString
         return false;
     }
     qInfo() << "Conectado ao PostgreSQL com sucesso!";
+    m_writer->setConnection(host, dbName, user, pass);
     return true;
 }
 
 QJsonObject BingoDatabaseManager::validarChaveAcesso(const QString &chave)
 {
+    aguardarEscopo("chaves");
     QSqlQuery query;
     query.prepare("SELECT c.id, c.sorteio_id, c.status, s.status as sorteio_status "
                   "FROM CHAVES_ACESSO c "
@@ -58,32 +104,27 @@ QJsonObject BingoDatabaseManager::validarChaveAcesso(const QString &chave)
     return obj;
 }
 
-bool BingoDatabaseManager::bloquearChave(int chaveId)
+bool BingoDatabaseManager::bloquearChave(int chaveId, Concluido concluido)
 {
-    QSqlQuery query;
-    query.prepare("UPDATE CHAVES_ACESSO SET status = 'utilizada' WHERE id = :id");
-    query.bindValue(":id", chaveId);
-    if (!query.exec()) {
-        qCritical() << "Erro ao inativar chave:" << query.lastError().text();
-        return false;
-    }
+    gravar("chaves", QString("bloquearChave(%1)").arg(chaveId),
+           "UPDATE CHAVES_ACESSO SET status = 'utilizada' WHERE id = :id",
+           {{":id", chaveId}}, concluido);
     return true;
 }
 
-bool BingoDatabaseManager::reativarChave(int chaveId)
+bool BingoDatabaseManager::reativarChave(int chaveId, Concluido concluido)
 {
-    QSqlQuery query;
-    query.prepare("UPDATE CHAVES_ACESSO SET status = 'ativa' WHERE id = :id");
-    query.bindValue(":id", chaveId);
-    if (!query.exec()) {
-        qCritical() << "Erro ao reativar chave:" << query.lastError().text();
-        return false;
-    }
+    gravar("chaves", QString("reativarChave(%1)").arg(chaveId),
+           "UPDATE CHAVES_ACESSO SET status = 'ativa' WHERE id = :id",
+           {{":id", chaveId}}, concluido);
     return true;
 }
 
 QJsonObject BingoDatabaseManager::getSorteio(int sorteioId)
 {
+    auto cached = m_sorteios.constFind(sorteioId);
+    if (cached != m_sorteios.constEnd()) return cached.value();
+
     QSqlQuery query;
     query.prepare("SELECT s.*, m.nome as modelo_nome "
                   "FROM SORTEIOS s "
@@ -109,23 +150,25 @@ QJsonObject BingoDatabaseManager::getSorteio(int sorteioId)
     obj["hora_inicio"] = query.value("hora_sorteio_inicio").toTime().toString(Qt::ISODate);
     obj["hora_fim"] = query.value("hora_sorteio_fim").toTime().toString(Qt::ISODate);
     
+    m_sorteios.insert(sorteioId, obj);
     return obj;
 }
 
-bool BingoDatabaseManager::salvarBolaSorteada(int sorteioId, int numero)
+bool BingoDatabaseManager::salvarBolaSorteada(int sorteioId, int numero, Concluido concluido)
 {
-    QSqlQuery query;
-    query.prepare("INSERT INTO BOLAS_SORTEADAS (sorteio_id, numero) VALUES (:sid, :num)");
-    query.bindValue(":sid", sorteioId);
-    query.bindValue(":num", numero);
-    return query.exec();
+    // clock_timestamp(): bolas gravadas no mesmo lote (mesma transação) teriam o mesmo now()
+    gravar(escopoSorteio(sorteioId), QString("salvarBolaSorteada(%1, %2)").arg(sorteioId).arg(numero),
+           "INSERT INTO BOLAS_SORTEADAS (sorteio_id, numero, momento) VALUES (:sid, :num, clock_timestamp())",
+           {{":sid", sorteioId}, {":num", numero}}, concluido);
+    return true;
 }
 
 QList<int> BingoDatabaseManager::getBolasSorteadas(int sorteioId)
 {
+    aguardarEscopo(escopoSorteio(sorteioId));
     QList<int> bolas;
     QSqlQuery query;
-    query.prepare("SELECT numero FROM BOLAS_SORTEADAS WHERE sorteio_id = :sid ORDER BY momento ASC");
+    query.prepare("SELECT numero FROM BOLAS_SORTEADAS WHERE sorteio_id = :sid ORDER BY momento ASC, id ASC");
     query.bindValue(":sid", sorteioId);
     if (query.exec()) {
         while (query.next()) bolas.append(query.value(0).toInt());
@@ -133,24 +176,35 @@ QList<int> BingoDatabaseManager::getBolasSorteadas(int sorteioId)
     return bolas;
 }
 
-bool BingoDatabaseManager::registrarVenda(int sorteioId, int numeroCartela, const QString &telefone, const QString &origem)
+QList<QPair<int, int>> BingoDatabaseManager::getBolasSorteadasComId(int sorteioId)
 {
+    aguardarEscopo(escopoSorteio(sorteioId));
+    QList<QPair<int, int>> bolas;
     QSqlQuery query;
-    query.prepare("INSERT INTO CARTELAS_VALIDADAS (sorteio_id, numero_cartela, telefone_participante, origem) "
-                  "VALUES (:sid, :num, :tel, :ori)");
+    query.prepare("SELECT id, numero FROM BOLAS_SORTEADAS WHERE sorteio_id = :sid ORDER BY momento ASC, id ASC");
     query.bindValue(":sid", sorteioId);
-    query.bindValue(":num", numeroCartela);
-    query.bindValue(":tel", telefone.isEmpty() ? QVariant(QVariant::String) : telefone);
-    query.bindValue(":ori", origem);
-    if (!query.exec()) {
-        qCritical() << "Erro ao registrar venda:" << query.lastError().text();
-        return false;
+    if (query.exec()) {
+        while (query.next()) bolas.append(qMakePair(query.value(0).toInt(), query.value(1).toInt()));
     }
+    return bolas;
+}
+
+bool BingoDatabaseManager::registrarVenda(int sorteioId, int numeroCartela, const QString &telefone, const QString &origem,
+                                          Concluido concluido)
+{
+    gravar(escopoSorteio(sorteioId), QString("registrarVenda(%1, %2)").arg(sorteioId).arg(numeroCartela),
+           "INSERT INTO CARTELAS_VALIDADAS (sorteio_id, numero_cartela, telefone_participante, origem) "
+           "VALUES (:sid, :num, :tel, :ori)",
+           {{":sid", sorteioId}, {":num", numeroCartela},
+            {":tel", telefone.isEmpty() ? QVariant(QVariant::String) : QVariant(telefone)},
+            {":ori", origem}},
+           concluido);
     return true;
 }
 
 QList<int> BingoDatabaseManager::getCartelasValidadas(int sorteioId)
 {
+    aguardarEscopo(escopoSorteio(sorteioId));
     QList<int> cartelas;
     QSqlQuery query;
     query.prepare("SELECT numero_cartela FROM CARTELAS_VALIDADAS WHERE sorteio_id = :sid");
@@ -161,60 +215,151 @@ QList<int> BingoDatabaseManager::getCartelasValidadas(int sorteioId)
     return cartelas;
 }
 
-QJsonArray BingoDatabaseManager::getRodadas(int sorteioId)
+QList<QPair<int, int>> BingoDatabaseManager::getCartelasValidadasDesde(int sorteioId, int aposId)
 {
-    QJsonArray array;
+    aguardarEscopo(escopoSorteio(sorteioId));
+    QList<QPair<int, int>> cartelas;
     QSqlQuery query;
-    // Seleciona as Rodadas (Pai)
-    query.prepare("SELECT r.*, b.tipo_grade, b.caminho_dados "
+    query.prepare("SELECT id, numero_cartela FROM CARTELAS_VALIDADAS WHERE sorteio_id = :sid AND id > :apos ORDER BY id ASC");
+    query.bindValue(":sid", sorteioId);
+    query.bindValue(":apos", aposId);
+    if (query.exec()) {
+        while (query.next()) cartelas.append(qMakePair(query.value(0).toInt(), query.value(1).toInt()));
+    }
+    return cartelas;
+}
+
+QPair<int, int> BingoDatabaseManager::getMarcaDagua(int sorteioId)
+{
+    aguardarEscopo(escopoSorteio(sorteioId));
+    QPair<int, int> marca(0, 0);
+    QSqlQuery query;
+    query.prepare("SELECT (SELECT COALESCE(MAX(id), 0) FROM BOLAS_SORTEADAS WHERE sorteio_id = :sid1), "
+                  "(SELECT COALESCE(MAX(id), 0) FROM CARTELAS_VALIDADAS WHERE sorteio_id = :sid2)");
+    query.bindValue(":sid1", sorteioId);
+    query.bindValue(":sid2", sorteioId);
+    if (query.exec() && query.next()) {
+        marca.first = query.value(0).toInt();
+        marca.second = query.value(1).toInt();
+    }
+    return marca;
+}
+
+BingoDatabaseManager::SorteioMeta *BingoDatabaseManager::carregarMetadados(int sorteioId)
+{
+    auto it = m_metadados.find(sorteioId);
+    if (it != m_metadados.end()) return &it.value();
+
+    // Rodadas (pai) e prêmios (filhos) numa única query; linhas da mesma rodada vêm juntas.
+    // O realizada dos prêmios pode estar na fila de gravação (de prêmio fora do cache, sem sorteio conhecido).
+    aguardarEscopo(escopoSorteio(sorteioId));
+    aguardarEscopo("premios");
+    QSqlQuery query;
+    query.prepare("SELECT r.id AS rodada_id, r.nome_rodada, r.base_id, r.configuracoes, "
+                  "r.ordem_exibicao AS rodada_ordem, b.tipo_grade, b.caminho_dados, "
+                  "p.id AS premio_id, p.tipo, p.descricao, p.realizada, p.padrao_grade, "
+                  "p.ordem_exibicao AS premio_ordem "
                   "FROM RODADAS r "
                   "LEFT JOIN BASES_DADOS b ON b.id = r.base_id "
+                  "LEFT JOIN PREMIOS p ON p.rodada_id = r.id "
                   "WHERE r.sorteio_id = :sid "
-                  "ORDER BY r.ordem_exibicao ASC, r.id ASC");
+                  "ORDER BY r.ordem_exibicao ASC, r.id ASC, p.ordem_exibicao ASC, p.id ASC");
     query.bindValue(":sid", sorteioId);
-    
-    if (query.exec()) {
-        while (query.next()) {
-            QJsonObject rodadaObj;
-            int rodadaId = query.value("id").toInt();
-            rodadaObj["id"] = rodadaId;
-            rodadaObj["nome"] = query.value("nome_rodada").toString();
-            rodadaObj["base_id"] = query.value("base_id").toInt();
-            rodadaObj["tipo_grade"] = query.value("tipo_grade").toString();
-            rodadaObj["caminho_dados"] = query.value("caminho_dados").toString();
-            
+    if (!query.exec()) {
+        qWarning() << "getRodadas: Query falhou:" << query.lastError().text();
+        return nullptr;
+    }
+
+    // ORDER BY põe os NULL por último; INT_MAX mantém a mesma ordem nas inserções do cache
+    auto ordem = [&query](const char *campo) {
+        QVariant v = query.value(campo);
+        return v.isNull() ? INT_MAX : v.toInt();
+    };
+
+    SorteioMeta meta;
+    while (query.next()) {
+        int rodadaId = query.value("rodada_id").toInt();
+        if (meta.rodadas.isEmpty() || meta.rodadas.last().id != rodadaId) {
+            RodadaMeta rodada;
+            rodada.id = rodadaId;
+            rodada.ordem = ordem("rodada_ordem");
+            rodada.obj["id"] = rodadaId;
+            rodada.obj["nome"] = query.value("nome_rodada").toString();
+            rodada.obj["base_id"] = query.value("base_id").toInt();
+            rodada.obj["tipo_grade"] = query.value("tipo_grade").toString();
+            rodada.obj["caminho_dados"] = query.value("caminho_dados").toString();
+
             QString configStr = query.value("configuracoes").toString();
             if (!configStr.isEmpty()) {
                 QJsonDocument doc = QJsonDocument::fromJson(configStr.toUtf8());
-                rodadaObj["configuracoes"] = doc.object();
+                rodada.obj["configuracoes"] = doc.object();
             }
+            meta.rodadas.append(rodada);
+            m_rodadaSorteio.insert(rodadaId, sorteioId);
+        }
+
+        if (query.value("premio_id").isNull()) continue; // Rodada sem prêmios (LEFT JOIN)
+        PremioMeta premio;
+        premio.id = query.value("premio_id").toInt();
+        premio.ordem = ordem("premio_ordem");
+        premio.obj["id"] = premio.id;
+        premio.obj["tipo"] = query.value("tipo").toString();
+        premio.obj["descricao"] = query.value("descricao").toString();
+        premio.obj["realizada"] = query.value("realizada").toBool();
+
+        QString padraoStr = query.value("padrao_grade").toString();
+        if (!padraoStr.isEmpty()) {
+            QJsonDocument doc = QJsonDocument::fromJson(padraoStr.toUtf8());
+            premio.obj["padrao"] = doc.array();
+        }
+        meta.rodadas.last().premios.append(premio);
+        m_premioRodada.insert(premio.id, rodadaId);
+    }
+
+    return &m_metadados.insert(sorteioId, meta).value();
+}
+
+BingoDatabaseManager::RodadaMeta *BingoDatabaseManager::acharRodada(int rodadaId, SorteioMeta **sorteio)
+{
+    auto sid = m_rodadaSorteio.constFind(rodadaId);
+    if (sid == m_rodadaSorteio.constEnd()) return nullptr;
+    auto it = m_metadados.find(sid.value());
+    if (it == m_metadados.end()) return nullptr;
+    for (RodadaMeta &r : it.value().rodadas) {
+        if (r.id == rodadaId) {
+            if (sorteio) *sorteio = &it.value();
+            return &r;
+        }
+    }
+    return nullptr;
+}
 
-            // Agora busca os Prêmios vinculados (Filhos)
+void BingoDatabaseManager::limparCacheMetadados()
+{
+    m_metadados.clear();
+    m_rodadaSorteio.clear();
+    m_premioRodada.clear();
+    m_sorteios.clear();
+}
+
+QJsonArray BingoDatabaseManager::getRodadas(int sorteioId)
+{
+    SorteioMeta *meta = carregarMetadados(sorteioId);
+    if (!meta) return QJsonArray();
+
+    if (!meta->jsonValido) {
+        QJsonArray array;
+        for (const RodadaMeta &r : meta->rodadas) {
             QJsonArray premiosArray;
-            QSqlQuery subQuery;
-            subQuery.prepare("SELECT * FROM PREMIOS WHERE rodada_id = :rid ORDER BY ordem_exibicao ASC, id ASC");
-            subQuery.bindValue(":rid", rodadaId);
-            if (subQuery.exec()) {
-                while (subQuery.next()) {
-                    QJsonObject premioObj;
-                    premioObj["id"] = subQuery.value("id").toInt();
-                    premioObj["tipo"] = subQuery.value("tipo").toString();
-                    premioObj["descricao"] = subQuery.value("descricao").toString();
-                    premioObj["realizada"] = subQuery.value("realizada").toBool();
-                    
-                    QString padraoStr = subQuery.value("padrao_grade").toString();
-                    if (!padraoStr.isEmpty()) {
-                        QJsonDocument doc = QJsonDocument::fromJson(padraoStr.toUtf8());
-                        premioObj["padrao"] = doc.array();
-                    }
-                    premiosArray.append(premioObj);
-                }
-            }
+            for (const PremioMeta &p : r.premios) premiosArray.append(p.obj);
+            QJsonObject rodadaObj = r.obj;
             rodadaObj["premios"] = premiosArray;
             array.append(rodadaObj);
         }
+        meta->json = array;
+        meta->jsonValido = true;
     }
-    return array;
+    return meta->json;
 }
 
 int BingoDatabaseManager::addRodada(int sorteioId, const QString &nome, int baseId, const QJsonObject &configuracoes, int ordem)
@@ -240,6 +385,32 @@ int BingoDatabaseManager::addRodada(int sorteioId, const QString &nome, int base
     if (query.next()) {
         int id = query.value(0).toInt();
         qInfo() << "[DEBUG] addRodada: Sucesso! ID:" << id;
+
+        // Write-through: só se o sorteio já estiver em cache (senão a próxima leitura carrega tudo)
+        auto it = m_metadados.find(sorteioId);
+        if (it != m_metadados.end()) {
+            RodadaMeta rodada;
+            rodada.id = id;
+            rodada.ordem = ordem;
+            rodada.obj["id"] = id;
+            rodada.obj["nome"] = nome;
+            rodada.obj["base_id"] = baseId;
+            rodada.obj["configuracoes"] = configuracoes;
+
+            QSqlQuery base;
+            base.prepare("SELECT tipo_grade, caminho_dados FROM BASES_DADOS WHERE id = :id");
+            base.bindValue(":id", baseId);
+            bool achou = base.exec() && base.next();
+            rodada.obj["tipo_grade"] = achou ? base.value(0).toString() : QString();
+            rodada.obj["caminho_dados"] = achou ? base.value(1).toString() : QString();
+
+            QList<RodadaMeta> &rodadas = it.value().rodadas;
+            int pos = rodadas.size();
+            while (pos > 0 && rodadas[pos - 1].ordem > ordem) --pos;
+            rodadas.insert(pos, rodada);
+            it.value().jsonValido = false;
+            m_rodadaSorteio.insert(id, sorteioId);
+        }
         return id;
     }
     
@@ -251,7 +422,7 @@ bool BingoDatabaseManager::addPremio(int rodadaId, const QString &tipo, const QS
 {
     QSqlQuery query;
     query.prepare("INSERT INTO PREMIOS (rodada_id, tipo, descricao, padrao_grade, ordem_exibicao) "
-                  "VALUES (:rid, :tipo, :desc, :padrao, :ordem)");
+                  "VALUES (:rid, :tipo, :desc, :padrao, :ordem) RETURNING id");
     query.bindValue(":rid", rodadaId);
     query.bindValue(":tipo", tipo);
     query.bindValue(":desc", descricao);
@@ -260,36 +431,97 @@ bool BingoDatabaseManager::addPremio(int rodadaId, const QString &tipo, const QS
     query.bindValue(":padrao", QString::fromUtf8(docPadrao.toJson(QJsonDocument::Compact)));
     query.bindValue(":ordem", ordem);
     
-    return query.exec();
+    if (!query.exec()) return false;
+
+    SorteioMeta *sorteio = nullptr;
+    RodadaMeta *rodada = acharRodada(rodadaId, &sorteio);
+    if (rodada && query.next()) {
+        PremioMeta premio;
+        premio.id = query.value(0).toInt();
+        premio.ordem = ordem;
+        premio.obj["id"] = premio.id;
+        premio.obj["tipo"] = tipo;
+        premio.obj["descricao"] = descricao;
+        premio.obj["realizada"] = false;
+        premio.obj["padrao"] = padrao;
+
+        int pos = rodada->premios.size();
+        while (pos > 0 && rodada->premios[pos - 1].ordem > ordem) --pos;
+        rodada->premios.insert(pos, premio);
+        sorteio->jsonValido = false;
+        m_premioRodada.insert(premio.id, rodadaId);
+    } else if (rodada) {
+        // Sem o id não dá para manter o cache: descarta o sorteio e recarrega na próxima leitura
+        m_metadados.remove(m_rodadaSorteio.value(rodadaId));
+    }
+    return true;
 }
 
 bool BingoDatabaseManager::removerRodada(int rodadaId)
 {
+    aguardarEscopo(escopoSorteio(m_rodadaSorteio.value(rodadaId, -1)));
     QSqlQuery query;
     query.prepare("DELETE FROM RODADAS WHERE id = :id");
     query.bindValue(":id", rodadaId);
-    return query.exec();
+    if (!query.exec()) return false;
+
+    SorteioMeta *sorteio = nullptr;
+    if (acharRodada(rodadaId, &sorteio)) {
+        for (int i = 0; i < sorteio->rodadas.size(); ++i) {
+            if (sorteio->rodadas[i].id != rodadaId) continue;
+            for (const PremioMeta &p : sorteio->rodadas[i].premios) m_premioRodada.remove(p.id);
+            sorteio->rodadas.removeAt(i);
+            break;
+        }
+        sorteio->jsonValido = false;
+    }
+    m_rodadaSorteio.remove(rodadaId);
+    return true;
 }
 
 bool BingoDatabaseManager::removerPremio(int premioId)
 {
+    aguardarEscopo(escopoPremio(premioId));
     QSqlQuery query;
     query.prepare("DELETE FROM PREMIOS WHERE id = :id");
     query.bindValue(":id", premioId);
-    return query.exec();
+    if (!query.exec()) return false;
+
+    SorteioMeta *sorteio = nullptr;
+    if (RodadaMeta *rodada = acharRodada(m_premioRodada.value(premioId, -1), &sorteio)) {
+        for (int i = 0; i < rodada->premios.size(); ++i) {
+            if (rodada->premios[i].id == premioId) {
+                rodada->premios.removeAt(i);
+                break;
+            }
+        }
+        sorteio->jsonValido = false;
+    }
+    m_premioRodada.remove(premioId);
+    return true;
 }
 
-bool BingoDatabaseManager::atualizarStatusPremio(int premioId, bool realizada)
+bool BingoDatabaseManager::atualizarStatusPremio(int premioId, bool realizada, Concluido concluido)
 {
-    QSqlQuery query;
-    query.prepare("UPDATE PREMIOS SET realizada = :status WHERE id = :id");
-    query.bindValue(":status", realizada);
-    query.bindValue(":id", premioId);
-    return query.exec();
+    gravar(escopoPremio(premioId), QString("atualizarStatusPremio(%1, %2)").arg(premioId).arg(realizada),
+           "UPDATE PREMIOS SET realizada = :status WHERE id = :id",
+           {{":status", realizada}, {":id", premioId}}, concluido);
+
+    SorteioMeta *sorteio = nullptr;
+    if (RodadaMeta *rodada = acharRodada(m_premioRodada.value(premioId, -1), &sorteio)) {
+        for (PremioMeta &p : rodada->premios) {
+            if (p.id == premioId && p.obj["realizada"].toBool() != realizada) {
+                p.obj["realizada"] = realizada;
+                sorteio->jsonValido = false;
+            }
+        }
+    }
+    return true;
 }
 
 QList<int> BingoDatabaseManager::getCartelasPorTelefone(int sorteioId, const QString &telefone)
 {
+    aguardarEscopo(escopoSorteio(sorteioId));
     QList<int> cartelas;
     QSqlQuery query;
     query.prepare("SELECT numero_cartela FROM CARTELAS_VALIDADAS WHERE sorteio_id = :sid AND telefone_participante = :tel");
@@ -328,6 +560,7 @@ QJsonArray BingoDatabaseManager::listarTodosSorteios()
 
 QJsonArray BingoDatabaseManager::listarTodasChavesAcesso()
 {
+    aguardarEscopo("chaves");
     QJsonArray array;
     QSqlQuery query("SELECT * FROM CHAVES_ACESSO ORDER BY id DESC");
     while (query.next()) {
@@ -419,6 +652,7 @@ bool BingoDatabaseManager::atualizarConfigSorteio(int sorteioId, int modeloId, c
     query.bindValue(":mid", modeloId);
     query.bindValue(":sid", sorteioId);
     
+    m_sorteios.remove(sorteioId);
     return query.exec();
 }
 
@@ -430,6 +664,7 @@ bool BingoDatabaseManager::atualizarAgendamentoSorteio(int sorteioId, const QDat
     query.bindValue(":hini", horaInicio);
     query.bindValue(":hfim", horaFim);
     query.bindValue(":sid", sorteioId);
+    m_sorteios.remove(sorteioId);
     return query.exec();
 }
 
@@ -445,32 +680,39 @@ bool BingoDatabaseManager::salvarSorteioComoModelo(const QString &nome, const QJ
     return query.exec();
 }
 
-bool BingoDatabaseManager::removerUltimaBola(int sorteioId, int numero)
+bool BingoDatabaseManager::removerUltimaBola(int sorteioId, int numero, Concluido concluido)
 {
-    QSqlQuery query;
-    query.prepare("DELETE FROM BOLAS_SORTEADAS WHERE sorteio_id = :sid AND numero = :num");
-    query.bindValue(":sid", sorteioId);
-    query.bindValue(":num", numero);
-    return query.exec();
+    gravar(escopoSorteio(sorteioId), QString("removerUltimaBola(%1, %2)").arg(sorteioId).arg(numero),
+           "DELETE FROM BOLAS_SORTEADAS WHERE sorteio_id = :sid AND numero = :num",
+           {{":sid", sorteioId}, {":num", numero}}, concluido);
+    return true;
 }
 
-bool BingoDatabaseManager::limparSorteio(int sorteioId)
+bool BingoDatabaseManager::corrigirBola(int sorteioId, int numeroAntigo, int numeroNovo, Concluido concluido)
 {
-    QSqlQuery query;
-    query.prepare("DELETE FROM BOLAS_SORTEADAS WHERE sorteio_id = :sid");
-    query.bindValue(":sid", sorteioId);
-    if (!query.exec()) {
-        qCritical() << "Erro ao limpar sorteio (bolas):" << query.lastError().text();
-        return false;
-    }
-    
-    qInfo() << "Sorteio" << sorteioId << "limpo com sucesso no banco de dados.";
+    // Mantém a linha (e o 'momento') para que a ordem do sorteio não mude
+    gravar(escopoSorteio(sorteioId), QString("corrigirBola(%1, %2 -> %3)").arg(sorteioId).arg(numeroAntigo).arg(numeroNovo),
+           "UPDATE BOLAS_SORTEADAS SET numero = :novo WHERE sorteio_id = :sid AND numero = :antigo",
+           {{":novo", numeroNovo}, {":sid", sorteioId}, {":antigo", numeroAntigo}}, concluido);
+    return true;
+}
+
+bool BingoDatabaseManager::limparSorteio(int sorteioId, Concluido concluido)
+{
+    gravar(escopoSorteio(sorteioId), QString("limparSorteio(%1)").arg(sorteioId),
+           "DELETE FROM BOLAS_SORTEADAS WHERE sorteio_id = :sid",
+           {{":sid", sorteioId}},
+           [sorteioId, concluido](bool ok) {
+               if (ok) qInfo() << "Sorteio" << sorteioId << "limpo com sucesso no banco de dados.";
+               if (concluido) concluido(ok);
+           });
     return true;
 }
 
 
 bool BingoDatabaseManager::executarScriptSQL(const QString &caminho)
 {
+    m_writer->flush();
     QFile arquivo(caminho);
     if (!arquivo.open(QIODevice::ReadOnly | QIODevice::Text)) {
         qCritical() << "executarScriptSQL: Nao foi possivel abrir o arquivo:" << caminho;
@@ -509,6 +751,8 @@ bool BingoDatabaseManager::executarScriptSQL(const QString &caminho)
         return false;
     }
 
+    // O script pode ter mexido em qualquer tabela: a estrutura em cache deixa de valer
+    limparCacheMetadados();
     qInfo() << "executarScriptSQL: Script" << caminho << "executado com sucesso!";
     return true;
 }
@@ -10,19 +10,33 @@
 #include <QVariantList>
 #include <QDate>
 #include <QTime>
+#include <QHash>
+#include "BingoDbWriter.h"
 
 class BingoDatabaseManager : public QObject
 {
     Q_OBJECT
 public:
     explicit BingoDatabaseManager(QObject *parent = nullptr);
+    ~BingoDatabaseManager();
     bool connectToDatabase(const QString &host, const QString &dbName, const QString &user, const QString &pass);
     bool executarScriptSQL(const QString &caminho);
 
+    // Gravações do jogo (bolas, vendas, status de prêmio e de chave) vão para o BingoDbWriter:
+    // retornam true ao entrar na fila e o callback opcional avisa quando o COMMIT aconteceu.
+    // Cada gravação marca o seu escopo (chaves, ou o sorteio dela); uma leitura espera só as
+    // gravações pendentes do escopo que ela consulta, e não espera nada se não houver.
+    using Concluido = BingoDbWriter::Callback;
+    void setJanelaGravacao(int ms) { m_writer->setBatchWindow(ms); }
+    bool aguardarGravacoes(int timeoutMs = 10000) { return m_writer->flush(timeoutMs); }
+    // Sem esperar: ainda há gravação do sorteio na fila (quem relê o sorteio todo deve adiar)
+    bool temGravacaoPendente(int sorteioId) const;
+    QJsonObject estatisticasGravacao() const { return m_writer->stats(); }
+
     // Chaves de Acesso
     QJsonObject validarChaveAcesso(const QString &chave);
-    bool bloquearChave(int chaveId);
-    bool reativarChave(int chaveId);
+    bool bloquearChave(int chaveId, Concluido concluido = Concluido());
+    bool reativarChave(int chaveId, Concluido concluido = Concluido());
 
     // Sorteios (Global/Admin)
     QJsonArray listarTodosSorteios();
@@ -37,26 +51,69 @@ public:
     bool atualizarConfigSorteio(int sorteioId, int modeloId, const QJsonObject &configuracoes = QJsonObject());
     bool atualizarAgendamentoSorteio(int sorteioId, const QDate &data, const QTime &horaInicio, const QTime &horaFim);
     bool salvarSorteioComoModelo(const QString &nome, const QJsonObject &config);
-    bool salvarBolaSorteada(int sorteioId, int numero);
-    bool removerUltimaBola(int sorteioId, int numero);
-    bool limparSorteio(int sorteioId);
+    bool salvarBolaSorteada(int sorteioId, int numero, Concluido concluido = Concluido());
+    bool removerUltimaBola(int sorteioId, int numero, Concluido concluido = Concluido());
+    bool corrigirBola(int sorteioId, int numeroAntigo, int numeroNovo, Concluido concluido = Concluido());
+    bool limparSorteio(int sorteioId, Concluido concluido = Concluido());
     QList<int> getBolasSorteadas(int sorteioId);
+    QList<QPair<int, int>> getBolasSorteadasComId(int sorteioId); // (id, numero) na ordem do sorteio
 
     // Cartelas
-    bool registrarVenda(int sorteioId, int numeroCartela, const QString &telefone = "", const QString &origem = "Manual");
+    bool registrarVenda(int sorteioId, int numeroCartela, const QString &telefone = "", const QString &origem = "Manual",
+                        Concluido concluido = Concluido());
     QList<int> getCartelasValidadas(int sorteioId);
+    QList<QPair<int, int>> getCartelasValidadasDesde(int sorteioId, int aposId); // (id, numero_cartela)
+
+    // Marca d'água do sorteio para snapshots: (maior id de bola, maior id de venda)
+    QPair<int, int> getMarcaDagua(int sorteioId);
     QList<int> getCartelasPorTelefone(int sorteioId, const QString &telefone);
 
-    // Rodadas e Prêmios
+    // Rodadas e Prêmios. A estrutura de cada sorteio é lida uma vez (uma query com JOIN) e
+    // servida da memória; os métodos abaixo que a alteram atualizam também o cache.
     QJsonArray getRodadas(int sorteioId);
     int addRodada(int sorteioId, const QString &nome, int baseId, const QJsonObject &configuracoes = QJsonObject(), int ordem = 0);
     bool addPremio(int rodadaId, const QString &tipo, const QString &descricao, const QJsonArray &padrao = QJsonArray(), int ordem = 0);
     bool removerRodada(int rodadaId);
     bool removerPremio(int premioId);
-    bool atualizarStatusPremio(int premioId, bool realizada);
+    bool atualizarStatusPremio(int premioId, bool realizada, Concluido concluido = Concluido());
 
 private:
+    // Cache write-through de getSorteio()/getRodadas()
+    struct PremioMeta {
+        int id = 0;
+        int ordem = 0;
+        QJsonObject obj;
+    };
+    struct RodadaMeta {
+        int id = 0;
+        int ordem = 0;
+        QJsonObject obj; // Sem "premios": a lista é montada em getRodadas()
+        QList<PremioMeta> premios;
+    };
+    struct SorteioMeta {
+        QList<RodadaMeta> rodadas; // Na ordem de exibição (ordem, id)
+        QJsonArray json;           // Resposta pronta de getRodadas()
+        bool jsonValido = false;
+    };
+
+    // Escopos de gravação: a leitura só espera o que foi enfileirado no mesmo escopo
+    static QString escopoSorteio(int sorteioId) { return QString("sorteio:%1").arg(sorteioId); }
+    QString escopoPremio(int premioId) const;
+    void gravar(const QString &escopo, const QString &descricao, const QString &sql, const BingoDbWriter::Binds &binds,
+                Concluido concluido);
+    bool aguardarEscopo(const QString &escopo); // false = tempo esgotado, a leitura pode vir atrasada
+
+    SorteioMeta *carregarMetadados(int sorteioId);
+    RodadaMeta *acharRodada(int rodadaId, SorteioMeta **sorteio = nullptr);
+    void limparCacheMetadados();
+
     QSqlDatabase m_db;
+    BingoDbWriter *m_writer;
+    QHash<int, SorteioMeta> m_metadados;  // Sorteio -> estrutura
+    QHash<int, int> m_rodadaSorteio;      // Rodada -> sorteio (só dos sorteios em cache)
+    QHash<int, int> m_premioRodada;       // Prêmio -> rodada (idem)
+    QHash<int, QJsonObject> m_sorteios;   // getSorteio()
+    QHash<QString, quint64> m_ultimaGravacao; // Escopo -> seq da última gravação enfileirada nele
 };
 
 #endif // BINGODATABASEMANAGER_H
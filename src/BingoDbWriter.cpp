@@ -0,0 +1,290 @@
+#include "BingoDbWriter.h"
+#include <QDebug>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QDeadlineTimer>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QRandomGenerator>
+
+BingoDbWriter::BingoDbWriter(QObject *owner)
+    : QThread(nullptr),
+      m_owner(owner),
+      m_connectionName(QString("bingo_writer_%1").arg(quintptr(this))),
+      m_batchPrefix(QString("%1-%2-").arg(QDateTime::currentMSecsSinceEpoch(), 0, 36)
+                                     .arg(QRandomGenerator::global()->generate64(), 0, 36))
+{
+}
+
+BingoDbWriter::~BingoDbWriter()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_stopping = true;
+        m_hasWork.wakeAll();
+    }
+    wait();
+}
+
+void BingoDbWriter::setConnection(const QString &host, const QString &dbName, const QString &user, const QString &pass)
+{
+    m_host = host;
+    m_dbName = dbName;
+    m_user = user;
+    m_pass = pass;
+}
+
+quint64 BingoDbWriter::enqueue(const QString &description, const QString &sql, const Binds &binds, Callback done)
+{
+    QMutexLocker locker(&m_mutex);
+    if (!isRunning() && !m_stopping) start();
+
+    Command cmd;
+    cmd.seq = ++m_enqueued;
+    cmd.description = description;
+    cmd.sql = sql;
+    cmd.binds = binds;
+    cmd.done = std::move(done);
+    cmd.enqueuedMs = QDateTime::currentMSecsSinceEpoch();
+    m_queue.append(cmd);
+    m_hasWork.wakeOne();
+    return cmd.seq;
+}
+
+bool BingoDbWriter::flush(int timeoutMs)
+{
+    quint64 target;
+    {
+        QMutexLocker locker(&m_mutex);
+        target = m_enqueued;
+    }
+    return waitFor(target, timeoutMs);
+}
+
+bool BingoDbWriter::isPersisted(quint64 seq) const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_done >= seq;
+}
+
+bool BingoDbWriter::waitFor(quint64 target, int timeoutMs)
+{
+    QDeadlineTimer deadline(timeoutMs);
+    QMutexLocker locker(&m_mutex);
+    while (m_done < target) {
+        if (!m_persisted.wait(&m_mutex, deadline)) {
+            qWarning() << "[DB-WRITER] flush: tempo esgotado com" << (target - m_done) << "comandos pendentes";
+            return false;
+        }
+    }
+    return true;
+}
+
+QJsonObject BingoDbWriter::stats() const
+{
+    QMutexLocker locker(&m_mutex);
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    qint64 oldest = m_inFlightSinceMs;
+    if (!oldest && !m_queue.isEmpty()) oldest = m_queue.first().enqueuedMs;
+
+    QJsonObject obj;
+    obj["pending"] = double(m_enqueued - m_done);
+    obj["oldestPendingMs"] = double(oldest ? now - oldest : 0);
+    obj["enqueued"] = double(m_enqueued);
+    obj["persisted"] = double(m_done);
+    obj["batches"] = double(m_batches);
+    obj["failed"] = double(m_failed);
+    obj["reconnects"] = double(m_reconnects);
+    obj["lastBatchSize"] = m_lastBatchSize;
+    obj["lastBatchMs"] = double(m_lastBatchMs);
+    obj["lastLagMs"] = double(m_lastLagMs);
+    obj["maxLagMs"] = double(m_maxLagMs);
+    return obj;
+}
+
+bool BingoDbWriter::openConnection()
+{
+    QSqlDatabase db = QSqlDatabase::contains(m_connectionName)
+            ? QSqlDatabase::database(m_connectionName, false)
+            : QSqlDatabase::addDatabase("QPSQL", m_connectionName);
+    db.setHostName(m_host);
+    db.setDatabaseName(m_dbName);
+    db.setUserName(m_user);
+    db.setPassword(m_pass);
+    if (!db.open()) {
+        qCritical() << "[DB-WRITER] Erro ao conectar ao PostgreSQL:" << db.lastError().text();
+        return false;
+    }
+
+    // Marcas dos lotes gravados (só servem para a repetição depois de uma queda: um dia basta)
+    QSqlQuery query(db);
+    m_batchMarks = query.exec("CREATE TABLE IF NOT EXISTS LOTES_GRAVADOS ("
+                              "id VARCHAR(64) PRIMARY KEY, gravado_em TIMESTAMPTZ DEFAULT CURRENT_TIMESTAMP)")
+                && query.exec("DELETE FROM LOTES_GRAVADOS WHERE gravado_em < CURRENT_TIMESTAMP - INTERVAL '1 day'");
+    if (!m_batchMarks) {
+        qWarning() << "[DB-WRITER] Sem a tabela LOTES_GRAVADOS; um lote repetido após queda pode duplicar linhas:"
+                   << query.lastError().text();
+    }
+    return true;
+}
+
+bool BingoDbWriter::execute(const Command &cmd, QString *error)
+{
+    QSqlQuery query(QSqlDatabase::database(m_connectionName, false));
+    query.prepare(cmd.sql);
+    for (const auto &bind : cmd.binds) query.bindValue(bind.first, bind.second);
+    if (query.exec()) return true;
+    if (error) *error = query.lastError().text();
+    return false;
+}
+
+bool BingoDbWriter::markBatch(const QString &batchId, QString *error)
+{
+    if (!m_batchMarks) return true;
+    QSqlQuery query(QSqlDatabase::database(m_connectionName, false));
+    query.prepare("INSERT INTO LOTES_GRAVADOS (id) VALUES (:id)");
+    query.bindValue(":id", batchId);
+    if (query.exec()) return true;
+    if (error) *error = query.lastError().text();
+    return false;
+}
+
+bool BingoDbWriter::batchCommitted(const QString &batchId, bool *committed)
+{
+    // Retorna false se a consulta não rodou (conexão caiu de novo)
+    *committed = false;
+    if (!m_batchMarks) return true;
+    QSqlQuery query(QSqlDatabase::database(m_connectionName, false));
+    query.prepare("SELECT 1 FROM LOTES_GRAVADOS WHERE id = :id");
+    query.bindValue(":id", batchId);
+    if (!query.exec()) return false;
+    *committed = query.next();
+    return true;
+}
+
+bool BingoDbWriter::connectionLost() const
+{
+    // O QPSQL nem sempre marca a queda como ConnectionError: confirma com uma consulta trivial
+    QSqlDatabase db = QSqlDatabase::database(m_connectionName, false);
+    if (!db.isOpen()) return true;
+    QSqlQuery ping(db);
+    return !ping.exec("SELECT 1");
+}
+
+void BingoDbWriter::run()
+{
+    while (true) {
+        QVector<Command> batch;
+        bool stopping;
+        {
+            QMutexLocker locker(&m_mutex);
+            while (m_queue.isEmpty() && !m_stopping) m_hasWork.wait(&m_mutex);
+            if (m_queue.isEmpty()) break; // Parada com a fila vazia
+            stopping = m_stopping;
+        }
+
+        // Janela de agrupamento: deixa chegar o resto da rajada (bola, prêmios, chave) e grava junto
+        if (!stopping && m_batchWindowMs > 0) msleep(m_batchWindowMs);
+        {
+            QMutexLocker locker(&m_mutex);
+            batch.swap(m_queue);
+            m_inFlightSinceMs = batch.first().enqueuedMs;
+            stopping = m_stopping;
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        QVector<bool> results(batch.size(), false);
+        const QString batchId = m_batchPrefix + QString::number(batch.first().seq);
+        int attempts = 0;
+        bool lost = false; // Caiu no meio do lote: o COMMIT pode ter chegado ao banco
+        while (true) {
+            QSqlDatabase db = QSqlDatabase::database(m_connectionName, false);
+            if (!db.isOpen() && !openConnection()) {
+                // No encerramento não dá para esperar o banco voltar indefinidamente
+                if (stopping && ++attempts >= 3) {
+                    qCritical() << "[DB-WRITER] Encerrando sem banco:" << batch.size() << "comandos perdidos";
+                    break;
+                }
+                msleep(qMin(5000, 500 * ++attempts));
+                continue;
+            }
+
+            if (lost) {
+                bool committed = false;
+                if (!batchCommitted(batchId, &committed)) {
+                    db.close();
+                    continue;
+                }
+                if (committed) {
+                    qInfo() << "[DB-WRITER] Lote de" << batch.size() << "comandos já estava gravado; não será repetido";
+                    results.fill(true);
+                    break;
+                }
+                lost = false;
+            }
+
+            QString error;
+            if (db.transaction()) {
+                bool ok = true;
+                for (const Command &cmd : batch) {
+                    if (!execute(cmd, &error)) { ok = false; break; }
+                }
+                if (ok) ok = markBatch(batchId, &error);
+                if (ok && db.commit()) {
+                    results.fill(true);
+                    break;
+                }
+                db.rollback();
+            }
+            if (connectionLost()) {
+                qWarning() << "[DB-WRITER] Conexão perdida; reconectando para repetir o lote de" << batch.size() << "comandos";
+                db.close();
+                lost = true;
+                QMutexLocker locker(&m_mutex);
+                m_reconnects++;
+                continue;
+            }
+
+            // Erro de um comando específico: grava um a um para isolar o culpado sem perder o resto
+            for (int i = 0; i < batch.size(); ++i) {
+                results[i] = execute(batch[i], &error);
+                if (!results[i]) qCritical() << "[DB-WRITER] Falha em" << batch[i].description << ":" << error;
+            }
+            break;
+        }
+
+        QMutexLocker locker(&m_mutex);
+        const qint64 now = QDateTime::currentMSecsSinceEpoch();
+        m_done = batch.last().seq;
+        m_batches++;
+        m_failed += results.count(false);
+        m_lastBatchSize = batch.size();
+        m_lastBatchMs = timer.elapsed();
+        m_lastLagMs = now - batch.first().enqueuedMs;
+        m_maxLagMs = qMax(m_maxLagMs, m_lastLagMs);
+        m_inFlightSinceMs = 0;
+        m_persisted.wakeAll();
+        locker.unlock();
+
+        if (m_lastLagMs > 1000) {
+            qWarning() << "[DB-WRITER] Persistência atrasada:" << m_lastLagMs << "ms (lote de" << batch.size() << "comandos)";
+        }
+        finish(batch, results);
+    }
+
+    QSqlDatabase::database(m_connectionName, false).close();
+    QSqlDatabase::removeDatabase(m_connectionName);
+}
+
+void BingoDbWriter::finish(const QVector<Command> &batch, const QVector<bool> &results)
+{
+    // Callbacks rodam na thread do owner (o event loop principal), na ordem dos comandos
+    for (int i = 0; i < batch.size(); ++i) {
+        if (!batch[i].done) continue;
+        Callback done = batch[i].done;
+        const bool ok = results[i];
+        QMetaObject::invokeMethod(m_owner, [done, ok]() { done(ok); }, Qt::QueuedConnection);
+    }
+}
@@ -0,0 +1,90 @@
+#ifndef BINGODBWRITER_H
+#define BINGODBWRITER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QVector>
+#include <QVariant>
+#include <QJsonObject>
+#include <functional>
+
+// Gravação assíncrona no banco. Os comandos entram numa fila única (a ordem de chegada é a
+// ordem de gravação) e uma thread com conexão própria junta o que se acumulou na janela de
+// agrupamento numa só transação (group commit). Cada comando pode ter um callback de
+// durabilidade, chamado na thread do 'owner' depois do COMMIT (ou da falha).
+// Queda de conexão não perde comandos: a thread reconecta e repete o lote inteiro. Cada lote
+// grava na mesma transação uma marca com ID próprio (LOTES_GRAVADOS); se a queda veio depois
+// do COMMIT chegar ao banco, a marca existe e o lote não é repetido (sem bolas/vendas duplicadas).
+class BingoDbWriter : public QThread
+{
+public:
+    using Binds = QVector<QPair<QString, QVariant>>;
+    using Callback = std::function<void(bool ok)>;
+
+    explicit BingoDbWriter(QObject *owner);
+    ~BingoDbWriter() override; // Grava o que ainda estiver na fila antes de encerrar
+
+    void setConnection(const QString &host, const QString &dbName, const QString &user, const QString &pass);
+    void setBatchWindow(int ms) { m_batchWindowMs = ms; }
+
+    // Enfileira um comando e retorna o número de sequência dele. A thread sobe no primeiro uso.
+    quint64 enqueue(const QString &description, const QString &sql, const Binds &binds, Callback done = Callback());
+
+    // Espera até o comando 'seq' (e todos antes dele, a fila é ordenada) estar gravado.
+    // Retorna false se estourar o tempo. flush() espera tudo o que já foi enfileirado.
+    bool waitFor(quint64 seq, int timeoutMs = 10000);
+    bool flush(int timeoutMs = 10000);
+    bool isPersisted(quint64 seq) const;
+
+    // Atraso da persistência: comandos pendentes, idade do mais antigo e tempos dos lotes
+    QJsonObject stats() const;
+
+protected:
+    void run() override;
+
+private:
+    struct Command {
+        quint64 seq = 0;
+        QString description;
+        QString sql;
+        Binds binds;
+        Callback done;
+        qint64 enqueuedMs = 0;
+    };
+
+    bool openConnection();
+    bool execute(const Command &cmd, QString *error);
+    bool connectionLost() const;
+    // Marca do lote: gravada junto com ele e consultada depois de uma queda
+    bool markBatch(const QString &batchId, QString *error);
+    bool batchCommitted(const QString &batchId, bool *committed);
+    void finish(const QVector<Command> &batch, const QVector<bool> &results);
+
+    QObject *m_owner;
+    QString m_host, m_dbName, m_user, m_pass;
+    QString m_connectionName;
+    QString m_batchPrefix;      // Único por processo: ID do lote = prefixo + seq do primeiro comando
+    bool m_batchMarks = false;  // Tabela de marcas disponível (sem ela, a repetição pode duplicar)
+    int m_batchWindowMs = 5;
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_hasWork;   // Fila deixou de estar vazia (ou pedido de parada)
+    QWaitCondition m_persisted; // Um lote terminou
+    QVector<Command> m_queue;
+    bool m_stopping = false;
+    quint64 m_enqueued = 0;     // Último seq enfileirado
+    quint64 m_done = 0;         // Último seq concluído (gravado ou com erro definitivo)
+
+    // Métricas (protegidas por m_mutex)
+    qint64 m_batches = 0;
+    qint64 m_failed = 0;
+    qint64 m_reconnects = 0;
+    int m_lastBatchSize = 0;
+    qint64 m_lastBatchMs = 0;
+    qint64 m_lastLagMs = 0;     // Da entrada na fila ao COMMIT, do comando mais antigo do último lote
+    qint64 m_maxLagMs = 0;
+    qint64 m_inFlightSinceMs = 0; // Entrada do mais antigo do lote em gravação (0 = nenhum)
+};
+
+#endif // BINGODBWRITER_H
@@ -0,0 +1,96 @@
+#include "BingoGameActors.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QJsonArray>
+
+BingoGameActors::BingoGameActors(QObject *owner)
+    : QObject(nullptr),
+      m_owner(owner)
+{
+}
+
+BingoGameActors::~BingoGameActors()
+{
+    // Os 'done' que ainda estiverem na fila do owner são descartados junto com ele
+    for (Actor &actor : m_actors) {
+        actor.thread->quit();
+        actor.thread->wait();
+        delete actor.context;
+        delete actor.thread;
+    }
+}
+
+int BingoGameActors::actorFor(int sorteioId)
+{
+    auto it = m_pinned.constFind(sorteioId);
+    if (it != m_pinned.constEnd()) return it.value();
+
+    if (m_actors.isEmpty()) {
+        const int threads = qMax(1, m_threadCount > 0 ? m_threadCount : QThread::idealThreadCount());
+        for (int i = 0; i < threads; ++i) {
+            Actor actor;
+            actor.thread = new QThread();
+            actor.thread->setObjectName(QString("bingo-game-%1").arg(i));
+            actor.context = new QObject();
+            actor.context->moveToThread(actor.thread);
+            actor.thread->start();
+            m_actors.append(actor);
+        }
+        qInfo() << "BingoServer: Sorteios distribuídos entre" << threads << "threads de jogo.";
+    }
+
+    // Fixa na thread com menos sorteios
+    int best = 0;
+    for (int i = 1; i < m_actors.size(); ++i) {
+        if (m_actors[i].sorteios < m_actors[best].sorteios) best = i;
+    }
+    m_actors[best].sorteios++;
+    m_pinned.insert(sorteioId, best);
+    return best;
+}
+
+void BingoGameActors::unpin(int sorteioId)
+{
+    auto it = m_pinned.find(sorteioId);
+    if (it == m_pinned.end()) return;
+    m_actors[it.value()].sorteios--;
+    m_pinned.erase(it);
+}
+
+void BingoGameActors::post(int sorteioId, Task work, Task done)
+{
+    const int index = actorFor(sorteioId);
+    QObject *owner = m_owner;
+    BingoGameActors *self = this;
+    QMetaObject::invokeMethod(m_actors[index].context, [owner, self, index, work, done]() {
+        QElapsedTimer timer;
+        timer.start();
+        work();
+        const qint64 ns = timer.nsecsElapsed();
+        // Volta para a thread do owner; as métricas também só são tocadas lá
+        QMetaObject::invokeMethod(owner, [self, index, ns, done]() {
+            Actor &actor = self->m_actors[index];
+            actor.jobs++;
+            actor.totalNs += ns;
+            actor.maxNs = qMax(actor.maxNs, ns);
+            done();
+        }, Qt::QueuedConnection);
+    }, Qt::QueuedConnection);
+}
+
+QJsonObject BingoGameActors::stats() const
+{
+    QJsonArray threads;
+    for (const Actor &actor : m_actors) {
+        QJsonObject obj;
+        obj["sorteios"] = actor.sorteios;
+        obj["jobs"] = double(actor.jobs);
+        obj["busyMs"] = double(actor.totalNs / 1000000);
+        obj["avgUs"] = actor.jobs ? double(actor.totalNs / actor.jobs / 1000) : 0.0;
+        obj["maxUs"] = double(actor.maxNs / 1000);
+        threads.append(obj);
+    }
+    QJsonObject obj;
+    obj["threads"] = threads;
+    return obj;
+}
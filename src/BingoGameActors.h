@@ -0,0 +1,56 @@
+#ifndef BINGOGAMEACTORS_H
+#define BINGOGAMEACTORS_H
+
+#include <QObject>
+#include <QThread>
+#include <QHash>
+#include <QVector>
+#include <QJsonObject>
+#include <functional>
+
+// Threads dos sorteios (modelo de atores). Cada sorteio é fixado numa thread do pool no primeiro
+// trabalho e fica nela: o trabalho pesado do motor dele (bolas, undo, correção, reinício) roda
+// ali, um de cada vez e na ordem em que foi postado. Um sorteio grande ocupa só a thread dele.
+//
+// API entre threads: a thread do owner (a principal, dona das sessões, do banco e do protocolo)
+// chama post(); 'work' roda na thread do sorteio e 'done' volta pela fila de eventos do owner.
+// Quem posta garante que o motor não é tocado por outra thread entre o post() e o 'done'.
+class BingoGameActors : public QObject
+{
+public:
+    using Task = std::function<void()>;
+
+    explicit BingoGameActors(QObject *owner);
+    ~BingoGameActors() override; // Termina o trabalho em andamento e encerra as threads
+
+    // Antes do primeiro post(): quantidade de threads (0 = todos os núcleos)
+    void setThreadCount(int threads) { m_threadCount = threads; }
+
+    void post(int sorteioId, Task work, Task done);
+
+    // Solta o sorteio da thread (o motor dele foi descartado); o próximo post() o fixa de novo
+    // na thread com menos sorteios. Só sem trabalho pendente: a ordem vale dentro de uma thread.
+    void unpin(int sorteioId);
+
+    // Carga por thread: sorteios fixados, trabalhos feitos e tempo ocupado
+    QJsonObject stats() const;
+
+private:
+    struct Actor {
+        QThread *thread = nullptr;
+        QObject *context = nullptr; // Vive na thread do ator; destino dos trabalhos enfileirados
+        int sorteios = 0; // Fixados agora (unpin() devolve)
+        qint64 jobs = 0;
+        qint64 totalNs = 0;
+        qint64 maxNs = 0;
+    };
+
+    int actorFor(int sorteioId);
+
+    QObject *m_owner;
+    int m_threadCount = 0;
+    QVector<Actor> m_actors;
+    QHash<int, int> m_pinned; // Sorteio -> índice da thread
+};
+
+#endif // BINGOGAMEACTORS_H
@@ -1,77 +1,337 @@
 #include "BingoGameEngine.h"
+#include "BingoMatchKernel.h"
 #include <QDebug>
 #include <QJsonObject>
 #include <QJsonArray>
+#include <QThread>
+#include <QRunnable>
+#include <QAtomicInt>
+#include <QDataStream>
 #include <algorithm>
+#include <vector>
 
 BingoGameEngine::BingoGameEngine(QObject *parent) 
-    : QObject(parent), m_currentGridIndex(0), m_maxBalls(75), m_numChances(1)
+    : QObject(parent), m_currentGridIndex(0), m_maxBalls(75), m_numChances(1),
+      m_workerThreads(1), m_shardSize(8192), m_pool(nullptr), m_statesBuilt(false), m_registeredCount(0)
 {
 }
 
-void BingoGameEngine::loadBase(int baseId, const QVector<BingoTicket> &tickets)
+namespace {
+
+// Linhas de quina de uma grade de 5 colunas armazenada coluna a coluna (idx = c * rows + r):
+// horizontais primeiro e, em grades 5x5, verticais e as duas diagonais.
+QVector<QVector<int>> quinaLines(int cellCount)
+{
+    QVector<QVector<int>> lines;
+    const int cols = 5;
+    const int rows = cellCount / cols;
+    for (int r = 0; r < rows; ++r) {
+        QVector<int> idxs;
+        for (int c = 0; c < cols; ++c) idxs.append(c * rows + r);
+        lines.append(idxs);
+    }
+    if (rows == 5) {
+        for (int c = 0; c < cols; ++c) {
+            QVector<int> idxs;
+            for (int r = 0; r < rows; ++r) idxs.append(c * rows + r);
+            lines.append(idxs);
+        }
+        QVector<int> d1, d2;
+        for (int i = 0; i < 5; ++i) {
+            d1.append(i * 5 + i);
+            d2.append(i * 5 + (4 - i));
+        }
+        lines.append(d1);
+        lines.append(d2);
+    }
+    return lines;
+}
+
+void appendLineMasks(CompiledPattern &pattern, const TicketBase::GridView &grid, const BallMask &drawn)
+{
+    for (const auto &line : pattern.lines) {
+        BallMask m;
+        for (int idx : line) {
+            if (idx >= 0 && idx < grid.size) m.set(grid[idx]);
+        }
+        pattern.masks.append(m);
+        pattern.remaining.append(quint8(m.missingIn(drawn)));
+    }
+}
+
+// Menor número de bolas que falta numa linha ainda válida do slot (NoBucket se nenhuma)
+quint8 bestMissing(const CompiledPattern &pattern, const TicketGroup &group, int slot)
+{
+    if (group.closed[slot]) return CompiledPattern::NoBucket;
+    const int nLines = pattern.lines.size();
+    const quint8 *remaining = pattern.remaining.constData() + slot * nLines;
+    quint8 best = CompiledPattern::NoBucket;
+    for (int l = 0; l < nLines; ++l) {
+        if (pattern.lines[l].isEmpty()) continue;
+        if (pattern.kind == CompiledPattern::Quina && (group.usedLines[slot] & (1u << l))) continue;
+        best = qMin(best, remaining[l]);
+    }
+    return best;
+}
+
+// Move o slot para outro balde do histograma trocando-o com o último do balde antigo
+void moveToBucket(CompiledPattern &pattern, int slot, quint8 bucket)
+{
+    const quint8 old = pattern.best[slot];
+    if (old == bucket) return;
+    if (old != CompiledPattern::NoBucket) {
+        QVector<int> &from = pattern.buckets[old];
+        const int pos = pattern.bucketPos[slot];
+        const int last = from.last();
+        from[pos] = last;
+        pattern.bucketPos[last] = pos;
+        from.removeLast();
+    }
+    pattern.best[slot] = bucket;
+    if (bucket != CompiledPattern::NoBucket) {
+        QVector<int> &to = pattern.buckets[bucket];
+        pattern.bucketPos[slot] = to.size();
+        to.append(slot);
+    }
+}
+
+// Insere no histograma um slot recém-criado (máscaras e contadores já anexados)
+void placeSlot(CompiledPattern &pattern, const TicketGroup &group, int slot)
+{
+    pattern.best.append(CompiledPattern::NoBucket);
+    pattern.bucketPos.append(-1);
+    moveToBucket(pattern, slot, bestMissing(pattern, group, slot));
+}
+
+const quint32 SNAPSHOT_MAGIC = 0x424E4753; // "BNGS"
+const quint32 SNAPSHOT_VERSION = 1;
+
+const quint8 SLOT_CHEIA = 1;     // TicketGroup::closed: fez Cheia nesta base
+const quint8 SLOT_REMOVIDO = 2;  // TicketGroup::closed: venda desfeita com o jogo em andamento
+
+inline quint32 packPosting(int slot, int cell) { return (quint32(slot) << 8) | quint32(cell); }
+inline int postingSlot(quint32 posting) { return int(posting >> 8); }
+inline int postingCell(quint32 posting) { return int(posting & 0xFF); }
+
+int slotOf(const TicketGroup &group, int ticketId)
+{
+    const int row = group.base ? group.base->rowOf(ticketId) : -1;
+    return row >= 0 ? group.slotByRow[row] : -1;
+}
+
+// Chama fn(slot, célula) para cada ocorrência da bola nos slots [begin, end) do grupo, em
+// ordem de slot: primeiro a parte ordenada (índice da base filtrado pelos slots do grupo),
+// depois as cartelas que entraram fora de ordem
+template <typename Fn>
+void forEachPosting(const TicketGroup &group, int ball, int begin, int end, Fn &&fn)
+{
+    if (ball <= 0 || ball >= group.tailByBall.size()) return;
+    const int orderedEnd = qMin(end, group.orderedSlots);
+    if (begin < orderedEnd) {
+        const TicketBase::PostingList list = group.base->postingsWithBall(group.gridIndex, ball);
+        const quint32 *it = std::lower_bound(list.begin(), list.end(), quint32(group.rows[begin]) << 8);
+        const bool bounded = orderedEnd < group.orderedSlots;
+        const quint32 stop = bounded ? quint32(group.rows[orderedEnd]) << 8 : 0;
+        for (; it != list.end() && (!bounded || *it < stop); ++it) {
+            const int slot = group.slotByRow[TicketBase::PostingList::row(*it)];
+            if (slot >= begin && slot < orderedEnd) fn(slot, TicketBase::PostingList::cell(*it));
+        }
+    }
+    if (end > group.orderedSlots) {
+        const QVector<quint32> &tail = group.tailByBall[ball];
+        auto it = std::lower_bound(tail.begin(), tail.end(), packPosting(qMax(begin, group.orderedSlots), 0));
+        for (; it != tail.end() && postingSlot(*it) < end; ++it) fn(postingSlot(*it), postingCell(*it));
+    }
+}
+
+} // namespace
+
+void BingoGameEngine::loadBase(int baseId, const TicketBaseHandle &tickets)
 {
-    m_bases[baseId] = tickets;
-    m_idToDigitByBase[baseId].clear();
-    for(const auto& t : tickets) {
-        m_idToDigitByBase[baseId].insert(t.id, t.checkDigit);
+    ++m_stateVersion;
+    if (tickets.isNull()) return;
+    if (!tickets->hasBallIndex()) {
+        // Bases do BingoBaseStore já chegam indexadas; as demais ganham o índice aqui
+        TicketBase indexed = *tickets;
+        indexed.buildBallIndex();
+        m_bases[baseId] = TicketBaseHandle(new TicketBase(indexed));
+    } else {
+        m_bases[baseId] = tickets;
     }
-    qInfo() << "GameEngine: Carregada base" << baseId << "com" << tickets.size() << "cartelas.";
+    qInfo() << "GameEngine: Carregada base" << baseId << "com" << tickets->size() << "cartelas.";
 }
 
 void BingoGameEngine::setGameMode(int gridIndex)
 {
+    ++m_stateVersion;
     m_currentGridIndex = gridIndex;
-    m_activeTickets.clear();
     m_winners.clear();
-    m_nearWins.clear();
-    m_numToTicketsByBase.clear();
-
-    if (m_registeredTickets.isEmpty()) return;
-
-    // Inicializa estados para todas as combinações de (Base x Ticket Registrado)
-    // conforme os prêmios cadastrados
-    for (const auto &prize : m_prizes) {
-        int bid = prize.baseId;
-        int gidx = prize.gridIndex;
-        if (!m_bases.contains(bid)) continue;
-        const auto &tickets = m_bases[bid];
-
-        for (int ticketId : m_registeredTickets) {
-            // Verifica se já inicializamos este par (baseId, ticketId)
-            QPair<int, int> key(bid, ticketId);
-            if (m_activeTickets.contains(key)) continue;
-
-            int idx = ticketId - 1; 
-            if (idx < 0 || idx >= tickets.size()) continue;
-            const auto &ticket = tickets[idx];
-            if (gidx < 0 || gidx >= ticket.grids.size()) continue;
-
-            TicketState state;
-            state.ticketId = ticket.id;
-            state.baseId = bid;
-            state.matches = 0;
-            const QVector<int> &grid = ticket.grids[gidx];
-            state.totalNumbers = grid.size();
-            for(int n : grid) {
-                state.missingNumbers.insert(n);
-                m_numToTicketsByBase[bid][n].append(ticket.id);
-            }
-            m_activeTickets.insert(key, state);
+    m_scannedPrizeIds.clear();
+    m_journal.clear();
+
+    // Recria os slots de todas as combinações (Base/Grade x Ticket Registrado)
+    // conforme os prêmios cadastrados, com máscaras e linhas usadas zeradas
+    m_statesBuilt = false;
+    rebuildGroups();
+    m_statesBuilt = true;
+
+    int total = 0;
+    for (const auto &g : m_groups) total += g.ticketIds.size();
+    qInfo() << "GameEngine: Estados ativos inicializados para" << total << "combinações base/cartela.";
+}
+
+void BingoGameEngine::rebuildGroups()
+{
+    m_groups.clear();
+    for (auto &prize : m_prizes) {
+        prize.groupIndex = ensureGroup(prize.baseId, prize.gridIndex);
+        prize.patternIndex = (prize.groupIndex >= 0) ? compilePattern(m_groups[prize.groupIndex], prize) : -1;
+    }
+
+    for (auto &g : m_groups) fillGroup(g);
+}
+
+void BingoGameEngine::fillGroup(TicketGroup &group)
+{
+    // Slots na ordem das linhas da base: todos caem na parte ordenada do grupo e a
+    // varredura segue a ordem das cartelas
+    const TicketBase &base = *group.base;
+    group.ticketIds.reserve(qMin(base.size(), m_registeredCount));
+    for (int row = 0; row < base.size(); ++row) {
+        const int ticketId = base.ticketId(row);
+        if (isTicketRegistered(ticketId)) addTicketToGroup(group, ticketId, row);
+    }
+}
+
+int BingoGameEngine::ensureGroup(int baseId, int gridIndex)
+{
+    for (int i = 0; i < m_groups.size(); ++i) {
+        if (m_groups[i].baseId == baseId && m_groups[i].gridIndex == gridIndex) return i;
+    }
+    if (!m_bases.contains(baseId)) return -1;
+    const TicketBase &tickets = *m_bases[baseId];
+    if (tickets.isEmpty() || gridIndex < 0 || gridIndex >= tickets.gridCount()) return -1;
+
+    TicketGroup g;
+    g.baseId = baseId;
+    g.gridIndex = gridIndex;
+    g.cellCount = tickets.cellCount(gridIndex);
+    g.base = m_bases[baseId];
+    g.slotByRow.fill(-1, tickets.size());
+    g.tailByBall.resize(128);
+    m_groups.append(g);
+    return m_groups.size() - 1;
+}
+
+int BingoGameEngine::compilePattern(TicketGroup &group, const Prize &prize)
+{
+    CompiledPattern pattern;
+    if (prize.tipo == "quina") {
+        pattern.kind = CompiledPattern::Quina;
+        pattern.key = "quina";
+        pattern.lines = quinaLines(group.cellCount);
+    } else if (prize.tipo == "cheia") {
+        pattern.kind = CompiledPattern::Cheia;
+        pattern.key = "cheia";
+        QVector<int> all;
+        for (int i = 0; i < group.cellCount; ++i) all.append(i);
+        pattern.lines.append(all);
+    } else if (prize.tipo == "forma") {
+        pattern.kind = CompiledPattern::Forma;
+        QList<int> idxs = prize.padraoIndices.values();
+        std::sort(idxs.begin(), idxs.end());
+        QVector<int> line;
+        QStringList parts;
+        for (int idx : idxs) {
+            parts << QString::number(idx);
+            if (idx >= 0 && idx < group.cellCount) line.append(idx);
         }
+        pattern.key = "forma:" + parts.join(',');
+        pattern.lines.append(line);
+    } else {
+        pattern.key = prize.tipo;
     }
-    qInfo() << "GameEngine: Estados ativos inicializados para" << m_activeTickets.size() << "combinações base/cartela.";
+
+    // Prêmios com o mesmo desenho na mesma grade compartilham as máscaras
+    for (int i = 0; i < group.patterns.size(); ++i) {
+        if (group.patterns[i].key == pattern.key) return i;
+    }
+
+    int longestLine = 0;
+    pattern.linesByCell.resize(group.cellCount);
+    for (int l = 0; l < pattern.lines.size(); ++l) {
+        longestLine = qMax(longestLine, pattern.lines[l].size());
+        for (int idx : pattern.lines[l]) {
+            if (idx >= 0 && idx < group.cellCount) pattern.linesByCell[idx].append(l);
+        }
+    }
+    pattern.buckets.resize(longestLine + 1);
+
+    for (int slot = 0; slot < group.ticketIds.size(); ++slot) {
+        appendLineMasks(pattern, group.base->grid(group.rows[slot], group.gridIndex), m_drawnMask);
+        placeSlot(pattern, group, slot);
+    }
+    group.patterns.append(pattern);
+    return group.patterns.size() - 1;
+}
+
+TicketBase::GridView BingoGameEngine::gridOf(const TicketGroup &group, int ticketId) const
+{
+    if (!group.base) return {};
+    TicketBase::GridView grid = group.base->grid(group.base->rowOf(ticketId), group.gridIndex);
+
+    // Grade ausente na linha do arquivo fica toda com 0: a cartela não joga nesta grade
+    for (quint8 n : grid) {
+        if (n != 0) return grid;
+    }
+    return {};
+}
+
+void BingoGameEngine::addTicketToGroup(TicketGroup &group, int ticketId, int row)
+{
+    if (!group.base) return;
+    // ID repetido na base: vale a primeira linha, como em rowOf()
+    if (row < 0 || group.base->rowOf(ticketId) != row) row = group.base->rowOf(ticketId);
+    if (row < 0 || group.slotByRow[row] >= 0) return;
+    const TicketBase::GridView grid = gridOf(group, ticketId);
+    if (grid.isEmpty()) return;
+
+    const int slot = group.ticketIds.size();
+    const bool ordered = slot == group.orderedSlots && (slot == 0 || row > group.rows[slot - 1]);
+    BallMask gridMask;
+    for (int i = 0; i < grid.size; ++i) {
+        int n = grid[i];
+        gridMask.set(n);
+        if (!ordered && BallMask::isValidBall(n) && i < 256) group.tailByBall[n].append(packPosting(slot, i));
+    }
+    if (ordered) group.orderedSlots++;
+
+    group.slotByRow[row] = slot;
+    group.rows.append(row);
+    group.ticketIds.append(ticketId);
+    group.gridMasks.append(gridMask);
+    group.usedLines.append(0);
+    group.closed.append(0);
+    for (auto &pattern : group.patterns) {
+        appendLineMasks(pattern, grid, m_drawnMask);
+        placeSlot(pattern, group, slot);
+    }
+
+    // Cartela vendida com o jogo em andamento: verificada por completo na próxima chamada
+    if (m_statesBuilt) group.freshSlots.append(slot);
 }
 
 void BingoGameEngine::startNewGame()
 {
+    ++m_stateVersion;
     qInfo() << "GameEngine: Reiniciando sorteio (limpando bolas e estado)...";
     m_drawnNumbers.clear();
+    m_drawnMask.clear();
     m_winners.clear();
-    m_nearWins.clear();
     // Limpa ganhadores de cada prêmio e reseta a flag realizada
     for(auto &p : m_prizes) {
         p.winners.clear();
+        p.winnerSet.clear();
         p.realizada = false;
         p.winnerPatterns.clear();
     }
@@ -82,10 +342,24 @@ void BingoGameEngine::startNewGame()
 
 bool BingoGameEngine::processNumber(int number)
 {
+    ++m_stateVersion;
     if (number != 0) {
         if (number < 1 || number > m_maxBalls) return false;
-        if (m_drawnNumbers.contains(number)) return false;
+        if (m_drawnMask.test(number)) return false;
+
+        // Abre o registro desta bola: daqui até a próxima, tudo que mudar é anotado nele
+        BallJournal journal;
+        journal.number = number;
+        journal.globalWinners = m_winners.size();
+        journal.prizeWinners.reserve(m_prizes.size());
+        for (const auto &p : m_prizes) journal.prizeWinners.append(p.winners.size());
+        journal.scannedPrizeIds = m_scannedPrizeIds;
+        journal.freshSlots.reserve(m_groups.size());
+        for (const auto &g : m_groups) journal.freshSlots.append(g.freshSlots);
+        m_journal.append(journal);
+
         m_drawnNumbers.append(number);
+        m_drawnMask.set(number);
     }
 
     bool hasUpdates = false;
@@ -102,154 +376,276 @@ bool BingoGameEngine::processNumber(int number)
     
     if (number != 0) {
         qDebug() << "GameEngine: processNumber" << number << "Turno Sequencial ID:" << sequentialTurnId;
-        // 1. Atualização de estados em todas as bases que contêm o número
-        for (auto it = m_numToTicketsByBase.begin(); it != m_numToTicketsByBase.end(); ++it) {
-            int bid = it.key();
-            const auto &targets = it.value()[number];
-            for (int ticketId : targets) {
-                QPair<int, int> key(bid, ticketId);
-                if (!m_activeTickets.contains(key)) continue;
-                TicketState &state = m_activeTickets[key];
-                if (state.missingNumbers.contains(number)) {
-                    state.missingNumbers.remove(number);
-                    state.matches++;
+    }
+
+    // Novidades desta chamada por prêmio. São anexadas ordenadas por ID ao final,
+    // mantendo a ordem de ganhadores independente da ordem dos slots.
+    QVector<QList<int>> newWinners(m_prizes.size());
+    QList<QPair<int, int>> closedNow; // (baseId, ticketId) que fizeram Cheia nesta chamada
+
+    // processNumber(0) é um pedido explícito de reavaliação completa (ex: troca de turno)
+    if (number == 0) m_scannedPrizeIds.clear();
+
+    // Prêmios elegíveis de cada grade (Turno Global + Formas Paralelas)
+    QSet<int> eligibleIds;
+    QVector<QVector<int>> eligibleByGroup(m_groups.size());
+    for (int pi = 0; pi < m_prizes.size(); ++pi) {
+        const Prize &prize = m_prizes[pi];
+        if (!prize.active || prize.realizada || prize.groupIndex < 0 || prize.patternIndex < 0) continue;
+        if (prize.tipo != "forma" && prize.id != sequentialTurnId) continue;
+        eligibleByGroup[prize.groupIndex].append(pi);
+        eligibleIds.insert(prize.id);
+    }
+
+    // Contadores e verificação por fatia de slots (em paralelo quando habilitado)
+    QVector<EvalShard> shards;
+    for (int gi = 0; gi < m_groups.size(); ++gi) {
+        const int count = m_groups[gi].ticketIds.size();
+        const int step = (m_workerThreads > 1) ? m_shardSize : qMax(count, 1);
+        for (int begin = 0; begin < count; begin += step) {
+            EvalShard shard;
+            shard.group = gi;
+            shard.begin = begin;
+            shard.end = qMin(count, begin + step);
+            shards.append(shard);
+        }
+    }
+    runShards(shards, number, eligibleByGroup);
+
+    // Aplicação dos resultados na ordem (grade, fatia): primeiro o histograma, depois os ganhos
+    for (const auto &shard : shards) {
+        TicketGroup &g = m_groups[shard.group];
+        for (const auto &move : shard.moves) {
+            CompiledPattern &pattern = g.patterns[move.pattern];
+            if (move.missing < pattern.best[move.slot] && pattern.best[move.slot] != CompiledPattern::NoBucket) {
+                moveToBucket(pattern, move.slot, move.missing);
+            }
+        }
+        if (shard.nearWin) hasUpdates = true;
+    }
+    for (int gi = 0, first = 0; gi < m_groups.size(); ++gi) {
+        int last = first;
+        while (last < shards.size() && shards[last].group == gi) ++last;
+        for (int e = 0; e < eligibleByGroup[gi].size(); ++e) {
+            for (int si = first; si < last; ++si) {
+                for (const auto &win : shards[si].wins[e]) {
+                    applyWin(eligibleByGroup[gi][e], win.slot, win.line, newWinners, closedNow);
+                    hasUpdates = true;
                 }
             }
         }
+        m_groups[gi].freshSlots.clear();
+        first = last;
     }
+    m_scannedPrizeIds = eligibleIds;
 
-    // 2. Verificação de Prêmios para TODAS as cartelas ativas (Devido a Turno Global + Formas Paralelas)
-        for (auto it = m_activeTickets.begin(); it != m_activeTickets.end(); ++it) {
-            TicketState &state = it.value();
-            if (state.usedPatterns.contains("cheia")) continue; 
-
-            for (auto &prize : m_prizes) {
-                if (!prize.active || prize.realizada) continue;
-                if (prize.baseId != state.baseId) continue; // Só avalia se for a base do prêmio
-
-                bool eligible = (prize.tipo == "forma") || (sequentialTurnId != -1 && prize.id == sequentialTurnId);
-                if (!eligible) continue;
-
-                bool won = false;
-                bool nearWin = false;
-                const auto &tickets = m_bases[prize.baseId];
-                const auto &grid = tickets[state.ticketId-1].grids[prize.gridIndex];
-
-                if (prize.tipo == "quina") {
-                    int cols = 5;
-                    int rows = grid.size() / cols;
-                    for (int r = 0; r < rows; ++r) {
-                        int miss = 0;
-                        QList<int> idxs;
-                        for (int c = 0; c < cols; ++c) {
-                            int idx = c * rows + r;
-                            idxs.append(idx);
-                            if (!m_drawnNumbers.contains(grid[idx])) miss++;
-                        }
-                        if (miss == 0) {
-                            QList<int> sorted = idxs;
-                            std::sort(sorted.begin(), sorted.end());
-                            if (!state.usedPatterns["quina"].contains(sorted)) {
-                                won = true;
-                                prize.winnerPatterns[state.ticketId] = idxs;
-                                break;
-                            }
-                        }
-                        if (miss == 1) nearWin = true;
-                    }
-                    
-                    if (!won && rows == 5 && cols == 5) {
-                        // Vertical
-                        for (int c = 0; c < cols; ++c) {
-                            int miss = 0;
-                            QList<int> idxs;
-                            for (int r = 0; r < rows; ++r) {
-                                int idx = c * rows + r;
-                                idxs.append(idx);
-                                if (!m_drawnNumbers.contains(grid[idx])) miss++;
-                            }
-                            if (miss == 0) {
-                                QList<int> sorted = idxs;
-                                std::sort(sorted.begin(), sorted.end());
-                                if (!state.usedPatterns["quina"].contains(sorted)) {
-                                    won = true;
-                                    prize.winnerPatterns[state.ticketId] = idxs;
-                                    break;
-                                }
-                            }
-                            if (miss == 1) nearWin = true;
-                        }
-                        // Diagonais
-                        if (!won) {
-                            int m1=0, m2=0;
-                            QList<int> i1, i2;
-                            for(int i=0; i<5; i++) {
-                                int id1 = i*5+i; i1 << id1; if(!m_drawnNumbers.contains(grid[id1])) m1++;
-                                int id2 = i*5+(4-i); i2 << id2; if(!m_drawnNumbers.contains(grid[id2])) m2++;
-                            }
-                            if (m1==0) { 
-                                QList<int> s=i1; std::sort(s.begin(), s.end());
-                                if(!state.usedPatterns["quina"].contains(s)) { won=true; prize.winnerPatterns[state.ticketId]=i1; }
-                            }
-                            if (!won && m2==0) {
-                                QList<int> s=i2; std::sort(s.begin(), s.end());
-                                if(!state.usedPatterns["quina"].contains(s)) { won=true; prize.winnerPatterns[state.ticketId]=i2; }
-                            }
-                            if (m1==1 || m2==1) nearWin = true;
-                        }
+    for (int pi = 0; pi < m_prizes.size(); ++pi) {
+        std::sort(newWinners[pi].begin(), newWinners[pi].end());
+        m_prizes[pi].winners.append(newWinners[pi]);
+    }
+
+    // Cheia encerra a cartela em todas as grades da mesma base (a partir da próxima verificação)
+    std::sort(closedNow.begin(), closedNow.end());
+    BallJournal *journal = currentJournal();
+    for (const auto &bt : closedNow) {
+        for (int gi = 0; gi < m_groups.size(); ++gi) {
+            TicketGroup &g = m_groups[gi];
+            if (g.baseId != bt.first) continue;
+            int slot = slotOf(g, bt.second);
+            if (slot < 0 || g.closed[slot]) continue;
+            if (journal) journal->closed.append(qMakePair(gi, slot));
+            g.closed[slot] = SLOT_CHEIA;
+            for (auto &pattern : g.patterns) moveToBucket(pattern, slot, CompiledPattern::NoBucket);
+        }
+        if (!m_winners.contains(bt.second)) m_winners.append(bt.second);
+    }
+
+    return hasUpdates; 
+}
+
+void BingoGameEngine::setWorkerThreads(int threads, int shardSize)
+{
+    m_workerThreads = (threads <= 0) ? QThread::idealThreadCount() : threads;
+    m_shardSize = qMax(256, shardSize);
+    if (m_workerThreads > 1) {
+        if (!m_pool) m_pool = new QThreadPool(this);
+        // A thread que chama processNumber() também consome fatias
+        m_pool->setMaxThreadCount(m_workerThreads - 1);
+    }
+    qInfo() << "GameEngine: Avaliação com" << m_workerThreads << "thread(s), fatias de" << m_shardSize
+            << "cartelas, kernel" << BingoMatchKernel::isaName();
+}
+
+void BingoGameEngine::runShards(QVector<EvalShard> &shards, int number, const QVector<QVector<int>> &eligibleByGroup)
+{
+    if (m_workerThreads <= 1 || !m_pool || shards.size() <= 1) {
+        for (auto &shard : shards) evaluateShard(shard, number, eligibleByGroup[shard.group]);
+        return;
+    }
+
+    // As threads escrevem nos contadores através de data(); garante que nenhum array
+    // compartilhado seja destacado (cópia) concorrentemente
+    for (auto &g : m_groups) {
+        for (auto &pattern : g.patterns) pattern.remaining.data();
+    }
+
+    // Fila única com contador atômico: quem termina uma fatia pega a próxima
+    EvalShard *data = shards.data();
+    const int total = shards.size();
+    QAtomicInt next(0);
+    auto work = [this, data, total, number, &eligibleByGroup, &next]() {
+        for (int i = next.fetchAndAddRelaxed(1); i < total; i = next.fetchAndAddRelaxed(1)) {
+            evaluateShard(data[i], number, eligibleByGroup[data[i].group]);
+        }
+    };
+    const int helpers = qMin(m_workerThreads, total) - 1;
+    for (int t = 0; t < helpers; ++t) m_pool->start(QRunnable::create(work));
+    work();
+    m_pool->waitForDone();
+}
+
+void BingoGameEngine::evaluateShard(EvalShard &shard, int number, const QVector<int> &eligible)
+{
+    TicketGroup &g = m_groups[shard.group];
+    const TicketGroup &cg = g;
+
+    // 1. Decrementa os contadores das linhas das cartelas que contêm a bola (índice invertido).
+    //    A descida de balde no histograma "falta N" fica anotada para ser aplicada em série.
+    //    Só as que chegaram a 0 ou 1 faltando podem ter mudado de situação.
+    QVector<QVector<int>> dirty(cg.patterns.size());
+    if (number != 0) {
+        forEachPosting(cg, number, shard.begin, shard.end, [&](int slot, int cell) {
+            for (int pIdx = 0; pIdx < cg.patterns.size(); ++pIdx) {
+                const CompiledPattern &pattern = cg.patterns[pIdx];
+                quint8 *remaining = g.patterns[pIdx].remaining.data() + slot * pattern.lines.size();
+                for (int l : pattern.linesByCell[cell]) {
+                    quint8 &rem = remaining[l];
+                    if (rem > 0) --rem;
+                    if (rem < pattern.best[slot] && pattern.best[slot] != CompiledPattern::NoBucket
+                        && (pattern.kind != CompiledPattern::Quina || !(cg.usedLines[slot] & (1u << l)))) {
+                        shard.moves.append({pIdx, slot, rem});
                     }
-                } else if (prize.tipo == "forma" || prize.tipo == "cheia") {
-                    int missingCount = 0;
-                    if (prize.tipo == "cheia") {
-                        missingCount = state.missingNumbers.size();
-                    } else {
-                        for (int idx : prize.padraoIndices) {
-                            if (idx >= 0 && idx < grid.size()) {
-                                if (!m_drawnNumbers.contains(grid[idx])) missingCount++;
-                            }
-                        }
+                    if (rem <= 1 && (dirty[pIdx].isEmpty() || dirty[pIdx].last() != slot)) {
+                        dirty[pIdx].append(slot);
                     }
-                    if (missingCount == 0 && (prize.tipo == "cheia" || !prize.padraoIndices.isEmpty())) won = true;
-                    if (missingCount == 1) nearWin = true;
                 }
+            }
+        });
+    }
+
+    // 2. Verificação dos prêmios elegíveis nesta fatia
+    QVector<int> fresh;
+    for (int slot : cg.freshSlots) {
+        if (slot >= shard.begin && slot < shard.end) fresh.append(slot);
+    }
+
+    shard.wins.resize(eligible.size());
+    for (int e = 0; e < eligible.size(); ++e) {
+        const Prize &prize = m_prizes.at(eligible[e]);
+        int wonLine = -1;
 
-            if (won) {
-                if (!prize.winners.contains(state.ticketId)) {
-                    prize.winners.append(state.ticketId);
-                    prize.near_winners.removeOne(state.ticketId);
-                    state.wonPrizeIds.insert(prize.id);
-                    if (prize.tipo == "quina") {
-                        QList<int> s = prize.winnerPatterns[state.ticketId]; std::sort(s.begin(), s.end());
-                        state.usedPatterns["quina"].append(s);
-                    } else if (prize.tipo == "forma") {
-                        QList<int> s = prize.padraoIndices.toList(); std::sort(s.begin(), s.end());
-                        state.usedPatterns["forma"].append(s);
-                    } else if (prize.tipo == "cheia") {
-                        state.usedPatterns["cheia"].append(QList<int>());
-                        if (!m_winners.contains(state.ticketId)) m_winners.append(state.ticketId);
+        if (!m_scannedPrizeIds.contains(prize.id)) {
+            // Prêmio recém-elegível: pode haver ganhos retroativos em qualquer cartela.
+            // O kernel em lote separa os candidatos; checkSlot() confirma e escolhe a linha.
+            const CompiledPattern &pattern = cg.patterns[prize.patternIndex];
+            if (pattern.kind == CompiledPattern::Outro) continue;
+            if (pattern.kind == CompiledPattern::Forma && prize.padraoIndices.isEmpty()) continue;
+
+            const int nLines = pattern.lines.size();
+            const quint32 *used = (pattern.kind == CompiledPattern::Quina) ? cg.usedLines.constData() : nullptr;
+            quint64 winBits[BingoMatchKernel::BlockSlots / 64];
+            quint64 nearBits[BingoMatchKernel::BlockSlots / 64];
+            for (int block = shard.begin; block < shard.end; block += BingoMatchKernel::BlockSlots) {
+                const int count = qMin(BingoMatchKernel::BlockSlots, shard.end - block);
+                BingoMatchKernel::scan(pattern.remaining.constData() + size_t(block) * nLines, nLines,
+                                       used ? used + block : nullptr, cg.closed.constData() + block,
+                                       count, winBits, nearBits);
+                for (int w = 0; w < (count + 63) / 64; ++w) {
+                    if (nearBits[w]) shard.nearWin = true;
+                    for (quint64 bits = winBits[w]; bits; bits &= bits - 1) {
+                        const int slot = block + w * 64 + int(qCountTrailingZeroBits(bits));
+                        if (checkSlot(cg, prize, slot, wonLine, shard.nearWin)) shard.wins[e].append({slot, wonLine});
                     }
-                    qInfo() << "VITÓRIA! Ticket" << state.ticketId << "ganhou prêmio paralalelo/da vez:" << prize.id << prize.nome;
-                    hasUpdates = true;
-                }
-            } else if (nearWin) {
-                if (!prize.near_winners.contains(state.ticketId) && !prize.winners.contains(state.ticketId)) {
-                    prize.near_winners.append(state.ticketId);
-                    hasUpdates = true;
                 }
             }
+            continue;
+        }
+
+        QVector<int> candidates = dirty[prize.patternIndex];
+        if (!fresh.isEmpty()) {
+            candidates += fresh;
+            std::sort(candidates.begin(), candidates.end());
+            candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+        }
+        for (int slot : candidates) {
+            if (!cg.closed[slot] && checkSlot(cg, prize, slot, wonLine, shard.nearWin)) {
+                shard.wins[e].append({slot, wonLine});
+            }
         }
     }
+}
 
-    return hasUpdates; 
+bool BingoGameEngine::checkSlot(const TicketGroup &g, const Prize &prize, int slot, int &wonLine, bool &nearWin) const
+{
+    if (prize.winnerSet.contains(g.ticketIds[slot])) return false;
+
+    const CompiledPattern &pattern = g.patterns[prize.patternIndex];
+    const int nLines = pattern.lines.size();
+    const quint8 *remaining = pattern.remaining.constData() + slot * nLines;
+
+    wonLine = -1;
+    if (pattern.kind == CompiledPattern::Quina) {
+        for (int l = 0; l < nLines; ++l) {
+            if (remaining[l] == 0 && !(g.usedLines[slot] & (1u << l))) { wonLine = l; break; }
+            if (remaining[l] == 1) nearWin = true;
+        }
+    } else if (pattern.kind == CompiledPattern::Forma || pattern.kind == CompiledPattern::Cheia) {
+        if (remaining[0] == 0 && (pattern.kind == CompiledPattern::Cheia || !prize.padraoIndices.isEmpty())) wonLine = 0;
+        if (remaining[0] == 1) nearWin = true;
+    }
+    return wonLine >= 0;
+}
+
+void BingoGameEngine::applyWin(int prizeIndex, int slot, int wonLine,
+                               QVector<QList<int>> &newWinners, QList<QPair<int, int>> &closedNow)
+{
+    Prize &prize = m_prizes[prizeIndex];
+    TicketGroup &g = m_groups[prize.groupIndex];
+    CompiledPattern &pattern = g.patterns[prize.patternIndex];
+    const int ticketId = g.ticketIds[slot];
+
+    prize.winnerSet.insert(ticketId);
+    newWinners[prizeIndex].append(ticketId);
+    if (pattern.kind == CompiledPattern::Quina) {
+        prize.winnerPatterns[ticketId] = pattern.lines[wonLine];
+        if (BallJournal *journal = currentJournal()) {
+            journal->usedLines.append({prize.groupIndex, slot, g.usedLines[slot]});
+        }
+        g.usedLines[slot] |= (1u << wonLine);
+        moveToBucket(pattern, slot, bestMissing(pattern, g, slot));
+    } else if (pattern.kind == CompiledPattern::Cheia) {
+        closedNow.append(qMakePair(g.baseId, ticketId));
+    }
+    qInfo() << "VITÓRIA! Ticket" << ticketId << "ganhou prêmio paralalelo/da vez:" << prize.id << prize.nome;
 }
 
 int BingoGameEngine::undoLastNumber(const QSet<int> &preRealizedIds)
 {
+    ++m_stateVersion;
     if (m_drawnNumbers.isEmpty()) {
         return -1;
     }
 
-    // Estratégia de Reset e Replay: Garante integridade absoluta de ganhadores, armados e turnos
+    // Caminho normal: desfaz só o que a última bola (e o que veio depois dela) alterou
+    if (!m_journal.isEmpty()) {
+        int lastNum = m_drawnNumbers.last();
+        rollbackLastBall();
+        qInfo() << "[UNDO-ENGINE] Bola" << lastNum << "desfeita pelo journal. Bolas restantes:" << m_drawnNumbers.size();
+        return lastNum;
+    }
+
+    // Sem journal (configuração de prêmios mudou depois da bola): Reset e Replay,
+    // que garante integridade absoluta de ganhadores, armados e turnos
     QList<int> balls = m_drawnNumbers;
     int lastNum = balls.takeLast();
     
@@ -276,6 +672,118 @@ int BingoGameEngine::undoLastNumber(const QSet<int> &preRealizedIds)
     return lastNum;
 }
 
+void BingoGameEngine::rollbackLastBall()
+{
+    BallJournal journal = m_journal.takeLast();
+    const int number = m_drawnNumbers.takeLast();
+    m_drawnMask.reset(number);
+
+    // 1. Status dos prêmios, do mais recente para o mais antigo
+    for (int i = journal.realizada.size() - 1; i >= 0; --i) {
+        const auto &change = journal.realizada[i];
+        if (change.first < m_prizes.size()) m_prizes[change.first].realizada = change.second;
+    }
+
+    // 2. Ganhadores: as listas só crescem, então basta truncar
+    for (int pi = 0; pi < m_prizes.size() && pi < journal.prizeWinners.size(); ++pi) {
+        Prize &p = m_prizes[pi];
+        const bool hadWinners = !p.winners.isEmpty();
+        while (p.winners.size() > journal.prizeWinners[pi]) {
+            const int ticketId = p.winners.takeLast();
+            p.winnerSet.remove(ticketId);
+            p.winnerPatterns.remove(ticketId);
+        }
+        // Prêmio que perdeu todos os ganhadores volta a ficar pendente (ex: realizado ao carregar do banco)
+        if (hadWinners && p.winners.isEmpty() && p.realizada) {
+            p.realizada = false;
+            qInfo() << "[UNDO-ENGINE] Prêmio" << p.id << p.nome << "ficou sem ganhadores e foi reaberto.";
+        }
+    }
+    while (m_winners.size() > journal.globalWinners) m_winners.removeLast();
+
+    // 3. Linhas usadas e cartelas fechadas; os slots afetados têm o balde recalculado abaixo
+    QVector<QVector<int>> refresh(m_groups.size());
+    for (int i = journal.usedLines.size() - 1; i >= 0; --i) {
+        const auto &change = journal.usedLines[i];
+        m_groups[change.group].usedLines[change.slot] = change.before;
+        refresh[change.group].append(change.slot);
+    }
+    for (const auto &gs : journal.closed) {
+        quint8 &closed = m_groups[gs.first].closed[gs.second];
+        if (closed == SLOT_CHEIA) closed = 0; // Venda desfeita depois da bola continua fora
+        refresh[gs.first].append(gs.second);
+    }
+
+    // 4. Contadores das linhas que contêm a bola, recalculados das máscaras
+    for (int gi = 0; gi < m_groups.size(); ++gi) {
+        TicketGroup &g = m_groups[gi];
+        forEachPosting(g, number, 0, g.ticketIds.size(), [&](int slot, int cell) {
+            for (auto &pattern : g.patterns) {
+                const int base = slot * pattern.lines.size();
+                for (int l : pattern.linesByCell[cell]) {
+                    pattern.remaining[base + l] = quint8(pattern.masks[base + l].missingIn(m_drawnMask));
+                }
+            }
+            refresh[gi].append(slot);
+        });
+
+        std::sort(refresh[gi].begin(), refresh[gi].end());
+        refresh[gi].erase(std::unique(refresh[gi].begin(), refresh[gi].end()), refresh[gi].end());
+        for (auto &pattern : g.patterns) {
+            for (int slot : refresh[gi]) moveToBucket(pattern, slot, bestMissing(pattern, g, slot));
+        }
+
+        // Slots ainda não verificados continuam pendentes, somados aos que eram novos antes da bola
+        if (gi < journal.freshSlots.size() && !journal.freshSlots[gi].isEmpty()) {
+            QSet<int> pending(g.freshSlots.begin(), g.freshSlots.end());
+            for (int slot : journal.freshSlots[gi]) {
+                if (!pending.contains(slot)) g.freshSlots.append(slot);
+            }
+        }
+    }
+
+    m_scannedPrizeIds = journal.scannedPrizeIds;
+}
+
+void BingoGameEngine::replayBall(int number, const QSet<int> &preRealizedIds)
+{
+    processNumber(number);
+    // Mesma automação do servidor após um sorteio (decidida antes de fechar qualquer prêmio),
+    // restrita aos prêmios que já estavam realizados
+    QList<int> toRealize;
+    for (const auto &p : m_prizes) {
+        if (preRealizedIds.contains(p.id) && p.active && !p.realizada && !p.winners.isEmpty()) toRealize.append(p.id);
+    }
+    for (int id : toRealize) setPrizeStatus(id, true);
+}
+
+bool BingoGameEngine::correctNumber(int position, int newNumber, const QSet<int> &preRealizedIds)
+{
+    ++m_stateVersion;
+    if (position < 0 || position >= m_drawnNumbers.size()) return false;
+    if (newNumber < 1 || newNumber > m_maxBalls) return false;
+    const int oldNumber = m_drawnNumbers[position];
+    if (newNumber != oldNumber && m_drawnMask.test(newNumber)) return false;
+
+    const QList<int> tail = m_drawnNumbers.mid(position + 1);
+    const int journalStart = m_drawnNumbers.size() - m_journal.size();
+    if (position >= journalStart) {
+        while (m_drawnNumbers.size() > position) rollbackLastBall();
+    } else {
+        // O journal não cobre esta posição: recomeça e reaplica as bolas anteriores
+        const QList<int> head = m_drawnNumbers.mid(0, position);
+        startNewGame();
+        for (int n : head) replayBall(n, preRealizedIds);
+    }
+
+    replayBall(newNumber, preRealizedIds);
+    for (int n : tail) replayBall(n, preRealizedIds);
+
+    qInfo() << "GameEngine: Bola" << oldNumber << "na posição" << position + 1 << "corrigida para" << newNumber
+            << "(" << tail.size() << "bolas reaplicadas)";
+    return true;
+}
+
 QList<int> BingoGameEngine::getDrawnNumbers() const
 {
     return m_drawnNumbers;
@@ -288,67 +796,191 @@ QList<int> BingoGameEngine::getWinners() const
 
 QMap<int, QList<int>> BingoGameEngine::getNearWinTickets() const
 {
-    return m_nearWins;
+    // Armados do Bingo (Cheia) que está valendo: o primeiro ativo ainda não realizado
+    QMap<int, QList<int>> result;
+    for (const auto &p : m_prizes) {
+        if (p.active && !p.realizada && p.tipo == "cheia") {
+            for (int missing = 1; missing <= 3; ++missing) {
+                QList<int> ids = getNearWinners(p.id, missing, 10);
+                if (!ids.isEmpty()) result.insert(missing, ids);
+            }
+            break;
+        }
+    }
+    return result;
+}
+
+const Prize *BingoGameEngine::findPrize(int prizeId) const
+{
+    for (const auto &p : m_prizes) {
+        if (p.id == prizeId) return &p;
+    }
+    return nullptr;
+}
+
+QMap<int, int> BingoGameEngine::getNearWinCounts(int prizeId, int maxMissing) const
+{
+    QMap<int, int> counts;
+    const Prize *prize = findPrize(prizeId);
+    if (!prize || !prize->active || prize->realizada || prize->groupIndex < 0 || prize->patternIndex < 0) return counts;
+
+    const TicketGroup &g = m_groups[prize->groupIndex];
+    const CompiledPattern &pattern = g.patterns[prize->patternIndex];
+    for (int missing = 1; missing <= maxMissing && missing < pattern.buckets.size(); ++missing) {
+        counts.insert(missing, pattern.buckets[missing].size());
+    }
+
+    // O histograma é do padrão (compartilhado); quem já ganhou este prêmio não conta como armado
+    for (int ticketId : prize->winners) {
+        const int slot = slotOf(g, ticketId);
+        if (slot < 0) continue;
+        const int missing = pattern.best[slot];
+        if (counts.contains(missing)) --counts[missing];
+    }
+    return counts;
+}
+
+QList<int> BingoGameEngine::getNearWinners(int prizeId, int missing, int limit) const
+{
+    const Prize *prize = findPrize(prizeId);
+    if (!prize || !prize->active || prize->realizada || prize->groupIndex < 0 || prize->patternIndex < 0) return {};
+
+    const TicketGroup &g = m_groups[prize->groupIndex];
+    const CompiledPattern &pattern = g.patterns[prize->patternIndex];
+    if (missing < 0 || missing >= pattern.buckets.size() || limit <= 0) return {};
+
+    // Os baldes não guardam ordem; devolvemos os 'limit' menores IDs para uma lista estável
+    std::vector<int> ids;
+    ids.reserve(pattern.buckets[missing].size());
+    for (int slot : pattern.buckets[missing]) {
+        const int ticketId = g.ticketIds[slot];
+        if (!prize->winnerSet.contains(ticketId)) ids.push_back(ticketId);
+    }
+    const int k = qMin(limit, int(ids.size()));
+    std::partial_sort(ids.begin(), ids.begin() + k, ids.end());
+    return QList<int>(ids.begin(), ids.begin() + k);
+}
+
+QList<int> BingoGameEngine::getPrizeTicketPage(int prizeId, int missing, int afterId, int limit, int *total) const
+{
+    if (total) *total = 0;
+    const Prize *prize = findPrize(prizeId);
+    if (!prize || missing < 0 || missing > 0xff || limit <= 0) return {};
+
+    SortedTickets &sorted = m_sortedTickets[(quint64(quint32(prizeId)) << 8) | quint64(missing)];
+    if (!sorted.valid || sorted.version != m_stateVersion) {
+        sorted.ids.clear();
+        if (missing == 0) {
+            sorted.ids.assign(prize->winners.begin(), prize->winners.end());
+        } else if (prize->active && !prize->realizada && prize->groupIndex >= 0 && prize->patternIndex >= 0) {
+            const TicketGroup &g = m_groups[prize->groupIndex];
+            const CompiledPattern &pattern = g.patterns[prize->patternIndex];
+            if (missing < pattern.buckets.size()) {
+                sorted.ids.reserve(pattern.buckets[missing].size());
+                for (int slot : pattern.buckets[missing]) {
+                    const int ticketId = g.ticketIds[slot];
+                    if (!prize->winnerSet.contains(ticketId)) sorted.ids.push_back(ticketId);
+                }
+            }
+        }
+        std::sort(sorted.ids.begin(), sorted.ids.end());
+        sorted.version = m_stateVersion;
+        sorted.valid = true;
+    }
+
+    if (total) *total = int(sorted.ids.size());
+    auto first = std::upper_bound(sorted.ids.begin(), sorted.ids.end(), afterId);
+    auto last = first + std::min<std::ptrdiff_t>(limit, sorted.ids.end() - first);
+    return QList<int>(first, last);
 }
 
 void BingoGameEngine::registerTicket(int ticketId)
 {
-    if (m_registeredTickets.contains(ticketId)) return; 
-    m_registeredTickets.insert(ticketId);
+    ++m_stateVersion;
+    if (ticketId < 0 || isTicketRegistered(ticketId)) return;
+    if ((ticketId >> 6) >= m_registeredBits.size()) m_registeredBits.resize((ticketId >> 6) + 1);
+    m_registeredBits[ticketId >> 6] |= quint64(1) << (ticketId & 63);
+    m_registeredCount++;
 
-    // Inicializa estados para este ticket em todas as bases requeridas pelos prêmios
-    for (const auto &prize : m_prizes) {
-        int bid = prize.baseId;
-        int gidx = prize.gridIndex;
-        if (!m_bases.contains(bid)) continue;
-        
-        QPair<int, int> key(bid, ticketId);
-        if (m_activeTickets.contains(key)) continue;
+    // Antes de setGameMode() os slots ainda não existem; serão criados em lote
+    if (!m_statesBuilt) return;
 
-        const auto &tickets = m_bases[bid];
-        int idx = ticketId - 1;
-        if (idx < 0 || idx >= tickets.size()) continue;
-        
-        const auto &ticket = tickets[idx];
-        if (gidx < 0 || gidx >= ticket.grids.size()) continue;
-
-        TicketState state;
-        state.ticketId = ticket.id;
-        state.baseId = bid;
-        state.matches = 0;
-        const QVector<int> &grid = ticket.grids[gidx];
-        state.totalNumbers = grid.size();
-        
-        for(int n : grid) {
-            if (m_drawnNumbers.contains(n)) {
-                state.matches++;
-            } else {
-                state.missingNumbers.insert(n);
+    // Inicializa o slot deste ticket em todas as grades requeridas pelos prêmios.
+    // As bolas já sorteadas são consideradas automaticamente via m_drawnMask.
+    for (auto &g : m_groups) {
+        const int slot = slotOf(g, ticketId);
+        if (slot < 0) {
+            addTicketToGroup(g, ticketId);
+            continue;
+        }
+        if (g.closed[slot] != SLOT_REMOVIDO) continue;
+        // Revendida depois de desfeita: volta com os contadores refeitos pelas bolas atuais
+        g.closed[slot] = 0;
+        for (auto &pattern : g.patterns) {
+            const int nLines = pattern.lines.size();
+            for (int l = 0; l < nLines; ++l) {
+                pattern.remaining[slot * nLines + l] = quint8(pattern.masks[slot * nLines + l].missingIn(m_drawnMask));
             }
-            m_numToTicketsByBase[bid][n].append(ticket.id);
+            moveToBucket(pattern, slot, bestMissing(pattern, g, slot));
         }
-        
-        m_activeTickets.insert(key, state);
+        g.freshSlots.append(slot);
     }
 }
 
+void BingoGameEngine::registerTickets(const QList<int> &ticketIds)
+{
+    ++m_stateVersion;
+    // Carga em lote: só liga os bits (os slots saem de setGameMode()); com o jogo já
+    // montado, entram em ordem de ID para manter a parte ordenada dos grupos
+    QList<int> ids = ticketIds;
+    std::sort(ids.begin(), ids.end());
+    for (int ticketId : ids) registerTicket(ticketId);
+}
+
 void BingoGameEngine::unregisterTicket(int ticketId)
 {
-    m_registeredTickets.remove(ticketId);
+    ++m_stateVersion;
+    if (!isTicketRegistered(ticketId)) return;
+    m_registeredBits[ticketId >> 6] &= ~(quint64(1) << (ticketId & 63));
+    m_registeredCount--;
+
+    // Slot fica, mas fora do jogo (como uma cartela fechada); sem slot, nada a fazer
+    for (auto &g : m_groups) {
+        const int slot = slotOf(g, ticketId);
+        if (slot < 0 || g.closed[slot]) continue;
+        g.closed[slot] = SLOT_REMOVIDO;
+        for (auto &pattern : g.patterns) moveToBucket(pattern, slot, CompiledPattern::NoBucket);
+        g.freshSlots.removeAll(slot);
+    }
 }
 
 void BingoGameEngine::clearRegisteredTickets()
 {
-    m_registeredTickets.clear();
+    ++m_stateVersion;
+    m_registeredBits.clear();
+    m_registeredCount = 0;
+}
+
+QSet<int> BingoGameEngine::getRegisteredTickets() const
+{
+    QSet<int> ids;
+    ids.reserve(m_registeredCount);
+    for (int w = 0; w < m_registeredBits.size(); ++w) {
+        for (quint64 bits = m_registeredBits[w]; bits; bits &= bits - 1) {
+            ids.insert(w * 64 + int(qCountTrailingZeroBits(bits)));
+        }
+    }
+    return ids;
 }
 
 QString BingoGameEngine::getFormattedBarcode(int ticketId) const
 {
     // Se não especificado base, busca na primeira base que contém o ticket
     int digit = 0;
-    for (auto it = m_idToDigitByBase.begin(); it != m_idToDigitByBase.end(); ++it) {
-        if (it.value().contains(ticketId)) {
-            digit = it.value().value(ticketId);
+    for (auto it = m_bases.begin(); it != m_bases.end(); ++it) {
+        const int row = it.value()->rowOf(ticketId);
+        if (row >= 0) {
+            digit = it.value()->checkDigit(row);
             break;
         }
     }
@@ -358,21 +990,19 @@ QString BingoGameEngine::getFormattedBarcode(int ticketId) const
 
 QVector<int> BingoGameEngine::getTicketNumbers(int baseId, int ticketId) const
 {
-    if (m_bases.contains(baseId)) {
-        const auto &tickets = m_bases[baseId];
-        int idx = ticketId - 1;
-        if (idx >= 0 && idx < tickets.size()) {
+    auto it = m_bases.find(baseId);
+    if (it != m_bases.end()) {
+        const TicketBase &tickets = *it.value();
+        int row = tickets.rowOf(ticketId);
+        if (row >= 0 && tickets.gridCount() > 0) {
             // Retorna a união de todos os números de todas as grades deste ticket nesta base?
             // Ou apenas da grade "atual" (m_currentGridIndex)?
             // Para o visual da cartela, o melhor é retornar os números da grade que o prêmio ativo ou gridIndex define.
             // Aqui vamos retornar a 1ª grade por padrão, ou a que tiver números.
-            const auto &grids = tickets[idx].grids;
-            if (!grids.isEmpty()) {
-                // Se o currentGridIndex for válido para este ticket, usa ele
-                if (m_currentGridIndex >= 0 && m_currentGridIndex < grids.size())
-                    return grids[m_currentGridIndex];
-                return grids.first();
-            }
+            // Se o currentGridIndex for válido para este ticket, usa ele
+            if (m_currentGridIndex >= 0 && m_currentGridIndex < tickets.gridCount())
+                return tickets.grid(row, m_currentGridIndex).toVector();
+            return tickets.grid(row, 0).toVector();
         }
     }
     return {};
@@ -380,10 +1010,9 @@ QVector<int> BingoGameEngine::getTicketNumbers(int baseId, int ticketId) const
 
 bool BingoGameEngine::isValidCheckDigit(int ticketId, int checkDigit) const
 {
-    for (auto it = m_idToDigitByBase.begin(); it != m_idToDigitByBase.end(); ++it) {
-        if (it.value().contains(ticketId)) {
-            if (it.value().value(ticketId) == checkDigit) return true;
-        }
+    for (auto it = m_bases.begin(); it != m_bases.end(); ++it) {
+        const int row = it.value()->rowOf(ticketId);
+        if (row >= 0 && it.value()->checkDigit(row) == checkDigit) return true;
     }
     return false;
 }
@@ -392,20 +1021,42 @@ bool BingoGameEngine::isValidCheckDigit(int ticketId, int checkDigit) const
 
 void BingoGameEngine::addPrize(const Prize &prize)
 {
+    ++m_stateVersion;
     Prize p = prize;
     p.tipo = p.tipo.toLower(); // Normaliza para evitar problemas de case (forma vs FORMA)
+    p.winnerSet = QSet<int>(p.winners.begin(), p.winners.end());
+
+    // Compila o padrão já agora; se os slots já existem, o grupo novo é preenchido na hora
+    p.groupIndex = ensureGroup(p.baseId, p.gridIndex);
+    if (p.groupIndex >= 0) {
+        TicketGroup &g = m_groups[p.groupIndex];
+        if (m_statesBuilt && g.ticketIds.isEmpty()) fillGroup(g);
+        p.patternIndex = compilePattern(g, p);
+    }
     m_prizes.append(p);
+    m_scannedPrizeIds.remove(p.id);
+    // O journal guarda estado por índice de prêmio; bolas anteriores passam a ser desfeitas por replay
+    m_journal.clear();
 }
 
 void BingoGameEngine::clearPrizes()
 {
+    ++m_stateVersion;
     m_prizes.clear();
+    m_sortedTickets.clear();
+    m_scannedPrizeIds.clear();
+    m_journal.clear();
+    // Os slots (e linhas já usadas) continuam válidos; apenas os padrões são descartados
+    for (auto &g : m_groups) g.patterns.clear();
 }
 
 void BingoGameEngine::setPrizeStatus(int id, bool realizada)
 {
-    for(auto &p : m_prizes) {
+    ++m_stateVersion;
+    for(int pi = 0; pi < m_prizes.size(); ++pi) {
+        Prize &p = m_prizes[pi];
         if (p.id == id) {
+            if (BallJournal *journal = currentJournal()) journal->realizada.append(qMakePair(pi, p.realizada));
             p.realizada = realizada;
             // Ao finalizar um prêmio, precisamos forçar uma verificação do ENGINE
             // pois o PRÓXIMO prêmio na vez pode já ter ganhadores (ganhos retroativos)
@@ -448,8 +1099,156 @@ QJsonObject BingoGameEngine::getDebugReport() const {
     
     report["prizes"] = prizesReport;
     report["drawnCount"] = m_drawnNumbers.size();
-    report["activeTicketsCount"] = m_activeTickets.size();
+    int activeTickets = 0;
+    for (const auto &g : m_groups) activeTickets += g.ticketIds.size();
+    report["activeTicketsCount"] = activeTickets;
     report["gridIndex"] = m_currentGridIndex;
     
     return report;
 }
+
+QByteArray BingoGameEngine::saveSnapshot() const
+{
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_15);
+    out << SNAPSHOT_MAGIC << SNAPSHOT_VERSION;
+    out << qint32(m_currentGridIndex) << qint32(m_maxBalls) << qint32(m_numChances);
+    out << qint32(m_registeredCount) << m_registeredBits;
+    out << m_drawnNumbers << m_winners << m_scannedPrizeIds;
+
+    out << qint32(m_prizes.size());
+    for (const auto &p : m_prizes) {
+        out << qint32(p.id) << p.active << p.realizada << p.winners << p.winnerPatterns;
+    }
+
+    // Por grade, só as cartelas com linha usada ou fechadas (o resto sai das máscaras)
+    out << qint32(m_groups.size());
+    for (const auto &g : m_groups) {
+        out << qint32(g.baseId) << qint32(g.gridIndex);
+        qint32 changed = 0;
+        for (int slot = 0; slot < g.ticketIds.size(); ++slot) {
+            if (g.usedLines[slot] || g.closed[slot]) changed++;
+        }
+        out << changed;
+        for (int slot = 0; slot < g.ticketIds.size(); ++slot) {
+            if (!g.usedLines[slot] && !g.closed[slot]) continue;
+            out << qint32(g.ticketIds[slot]) << g.usedLines[slot] << g.closed[slot];
+        }
+        QVector<qint32> fresh;
+        for (int slot : g.freshSlots) fresh.append(g.ticketIds[slot]);
+        out << fresh;
+    }
+    return data;
+}
+
+bool BingoGameEngine::restoreSnapshot(const QByteArray &data)
+{
+    ++m_stateVersion;
+    struct PrizeState {
+        bool active = true;
+        bool realizada = false;
+        QList<int> winners;
+        QMap<int, QList<int>> winnerPatterns;
+    };
+    struct SlotState {
+        qint32 ticketId = 0;
+        quint32 usedLines = 0;
+        quint8 closed = 0;
+    };
+    struct GroupState {
+        qint32 baseId = -1;
+        qint32 gridIndex = 0;
+        QVector<SlotState> changed;
+        QVector<qint32> fresh;
+    };
+
+    // Lê tudo antes de mexer no motor
+    QDataStream in(data);
+    in.setVersion(QDataStream::Qt_5_15);
+    quint32 magic = 0, version = 0;
+    in >> magic >> version;
+    if (magic != SNAPSHOT_MAGIC || version != SNAPSHOT_VERSION) return false;
+
+    qint32 gridIndex = 0, maxBalls = 0, chances = 0, registeredCount = 0;
+    QVector<quint64> registeredBits;
+    QList<int> drawn, winners;
+    QSet<int> scanned;
+    in >> gridIndex >> maxBalls >> chances >> registeredCount >> registeredBits;
+    in >> drawn >> winners >> scanned;
+
+    qint32 prizeCount = 0;
+    in >> prizeCount;
+    if (prizeCount != m_prizes.size()) return false;
+    QVector<PrizeState> prizes(prizeCount);
+    for (int i = 0; i < prizeCount; ++i) {
+        qint32 id = 0;
+        in >> id >> prizes[i].active >> prizes[i].realizada >> prizes[i].winners >> prizes[i].winnerPatterns;
+        if (id != m_prizes[i].id) return false;
+    }
+
+    qint32 groupCount = 0;
+    in >> groupCount;
+    QVector<GroupState> groups(qMax(0, groupCount));
+    for (auto &group : groups) {
+        qint32 changedCount = 0;
+        in >> group.baseId >> group.gridIndex >> changedCount;
+        if (changedCount < 0 || in.status() != QDataStream::Ok) return false;
+        group.changed.resize(changedCount);
+        for (auto &slot : group.changed) in >> slot.ticketId >> slot.usedLines >> slot.closed;
+        in >> group.fresh;
+    }
+    if (in.status() != QDataStream::Ok) return false;
+
+    // Estado base: bits das cartelas, bolas e prêmios; os slots são recriados já com as
+    // bolas sorteadas aplicadas às máscaras (contadores e histograma saem daí)
+    m_currentGridIndex = gridIndex;
+    m_maxBalls = maxBalls;
+    m_numChances = chances;
+    m_registeredBits = registeredBits;
+    m_registeredCount = registeredCount;
+    m_drawnNumbers = drawn;
+    m_drawnMask.clear();
+    for (int n : drawn) m_drawnMask.set(n);
+    for (int i = 0; i < prizeCount; ++i) {
+        Prize &p = m_prizes[i];
+        p.active = prizes[i].active;
+        p.realizada = prizes[i].realizada;
+        p.winners = prizes[i].winners;
+        p.winnerSet = QSet<int>(p.winners.begin(), p.winners.end());
+        p.winnerPatterns = prizes[i].winnerPatterns;
+    }
+
+    m_journal.clear();
+    m_statesBuilt = false;
+    rebuildGroups();
+    m_statesBuilt = true;
+
+    for (const auto &state : groups) {
+        for (auto &g : m_groups) {
+            if (g.baseId != state.baseId || g.gridIndex != state.gridIndex) continue;
+            QVector<int> touched;
+            for (const auto &slotState : state.changed) {
+                const int slot = slotOf(g, slotState.ticketId);
+                if (slot < 0) continue;
+                g.usedLines[slot] = slotState.usedLines;
+                g.closed[slot] = slotState.closed;
+                touched.append(slot);
+            }
+            for (auto &pattern : g.patterns) {
+                for (int slot : touched) moveToBucket(pattern, slot, bestMissing(pattern, g, slot));
+            }
+            for (int ticketId : state.fresh) {
+                const int slot = slotOf(g, ticketId);
+                if (slot >= 0) g.freshSlots.append(slot);
+            }
+        }
+    }
+    m_winners = winners;
+    m_scannedPrizeIds = scanned;
+
+    int total = 0;
+    for (const auto &g : m_groups) total += g.ticketIds.size();
+    qInfo() << "GameEngine: Snapshot restaurado:" << m_drawnNumbers.size() << "bolas," << total << "combinações base/cartela.";
+    return true;
+}
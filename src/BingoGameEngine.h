@@ -5,33 +5,109 @@
 #include <QList>
 #include <QSet>
 #include <QMap>
+#include <QHash>
 #include <QJsonObject>
 #include <QJsonArray>
+#include <QThreadPool>
+#include <vector>
 #include "BingoTicketParser.h"
+#include "BingoTicketBase.h"
+#include "BingoBallMask.h"
 
-struct TicketState {
-    int ticketId;
-    int baseId; // Qual base este estado representa
-    int matches; 
-    QSet<int> missingNumbers; 
-    int totalNumbers;
-    QSet<int> wonPrizeIds; 
-    QMap<QString, QList<QList<int>>> usedPatterns; 
+// Padrão de prêmio compilado para uma grade: cada "linha" é um conjunto de células
+// que precisa sair inteiro. Quina = linhas/colunas/diagonais, Cheia = grade toda,
+// Forma = células do desenho. As máscaras por cartela são geradas uma única vez
+// (addPrize/registerTicket), então a verificação vira um AND por linha.
+struct CompiledPattern {
+    enum Kind { Quina, Forma, Cheia, Outro };
+    static constexpr quint8 NoBucket = 0xFF;
+    Kind kind = Outro;
+    QString key;                 // "quina", "cheia" ou "forma:<índices>"
+    QVector<QVector<int>> lines; // Índices de célula de cada linha, na ordem de verificação
+    QVector<BallMask> masks;     // Bolas de cada linha por cartela: [slot * lines.size() + linha]
+    QVector<quint8> remaining;   // Bolas que ainda faltam em cada linha (mesmo índice de masks)
+    QVector<QVector<int>> linesByCell; // Célula -> linhas do padrão que a contêm
+
+    // Histograma "falta N": cada slot fica no balde do menor número de bolas que falta
+    // numa linha ainda válida (quina ignora linhas já premiadas; Cheia fechada sai do histograma).
+    // Mover de balde é O(1) (troca com o último), então cada bola custa só as cartelas tocadas.
+    QVector<quint8> best;             // slot -> balde atual (NoBucket = fora do histograma)
+    QVector<int> bucketPos;           // slot -> posição dentro de buckets[best]
+    QVector<QVector<int>> buckets;    // faltam N -> slots
+};
+
+// Cartelas registradas de uma (base, grade), em arrays contíguos indexados por slot
+struct TicketGroup {
+    int baseId = -1;
+    int gridIndex = 0;
+    int cellCount = 0;
+    TicketBaseHandle base;           // Base da grade (dona do índice invertido compartilhado)
+    QVector<int> ticketIds;          // slot -> ticketId
+    QVector<int> rows;               // slot -> linha na base
+    QVector<int> slotByRow;          // linha na base -> slot (-1 = cartela fora deste grupo)
+    QVector<BallMask> gridMasks;     // slot -> bolas da grade
+    QVector<quint32> usedLines;      // slot -> linhas de quina já premiadas (1 bit por linha)
+    QVector<quint8> closed;          // slot -> 1 se a cartela já fez Cheia nesta base, 2 se a venda foi desfeita
+    QVector<CompiledPattern> patterns;
+
+    // Os slots [0, orderedSlots) seguem a ordem das linhas da base: a bola sorteada é
+    // percorrida direto no índice invertido da base, filtrado por slotByRow. Cartelas que
+    // entram fora dessa ordem (vendidas com o jogo em andamento) ficam num índice próprio,
+    // bola -> (slot << 8 | célula), em ordem de slot.
+    int orderedSlots = 0;
+    QVector<QVector<quint32>> tailByBall;
+    QVector<int> freshSlots;         // Slots criados após o início do jogo, ainda não verificados
 };
 
 struct Prize {
-    int id;
+    int id = 0;
     QString nome;
     QString tipo; 
-    int baseId;      // Base de cartelas para este prêmio
-    int gridIndex;   // Qual grade da base usar
+    int baseId = -1;      // Base de cartelas para este prêmio
+    int gridIndex = 0;    // Qual grade da base usar
     QJsonObject configuracoes; // Configurações específicas (ex: acumula, etc)
     QSet<int> padraoIndices; 
     QList<int> winners;
-    QList<int> near_winners;
     QMap<int, QList<int>> winnerPatterns; 
-    bool active;
-    bool realizada;
+    bool active = true;
+    bool realizada = false;
+
+    // Preenchidos pelo motor em addPrize()
+    int groupIndex = -1;   // Índice do TicketGroup (base, grade)
+    int patternIndex = -1; // Índice do padrão compilado dentro do grupo
+    QSet<int> winnerSet;   // Espelho de 'winners' para consulta O(1)
+};
+
+// Tudo o que mudou no motor desde uma bola até a seguinte (incluindo processNumber(0) e
+// setPrizeStatus intermediários). Guardamos só os valores anteriores do que foi alterado,
+// então desfazer a bola custa o mesmo que sorteá-la. Os contadores das linhas não são
+// registrados: são recalculados das máscaras para as cartelas que contêm a bola.
+struct BallJournal {
+    struct UsedLinesChange { int group; int slot; quint32 before; };
+
+    int number = 0;
+    int globalWinners = 0;                 // Tamanho de m_winners antes da bola
+    QVector<int> prizeWinners;             // Tamanho de winners de cada prêmio antes da bola
+    QVector<QPair<int, bool>> realizada;   // (índice do prêmio, valor anterior), na ordem das mudanças
+    QVector<UsedLinesChange> usedLines;
+    QVector<QPair<int, int>> closed;       // (grupo, slot) fechados por Cheia
+    QSet<int> scannedPrizeIds;
+    QVector<QVector<int>> freshSlots;      // Por grupo, antes da bola
+};
+
+// Fatia contígua de slots de um grupo. Cada fatia é avaliada por uma única thread e só
+// escreve nos contadores dos próprios slots; o resto (baldes, ganhadores) fica em buffers
+// que processNumber() aplica depois, na ordem das fatias, igual ao modo single-thread.
+struct EvalShard {
+    struct BucketMove { int pattern; int slot; quint8 missing; };
+    struct SlotWin { int slot; int line; };
+
+    int group = -1;
+    int begin = 0;                     // Primeiro slot
+    int end = 0;                       // Um após o último slot
+    QVector<BucketMove> moves;         // Descidas de balde do histograma, na ordem das bolas
+    QVector<QVector<SlotWin>> wins;    // Por prêmio elegível do grupo, em ordem de slot
+    bool nearWin = false;
 };
 
 class BingoGameEngine : public QObject
@@ -41,31 +117,44 @@ public:
     explicit BingoGameEngine(QObject *parent = nullptr);
 
     // Carrega as cartelas de uma base para o jogo
-    void loadBase(int baseId, const QVector<BingoTicket> &tickets);
+    void loadBase(int baseId, const TicketBaseHandle &tickets);
+    void loadBase(int baseId, const TicketBase &tickets) { loadBase(baseId, TicketBaseHandle(new TicketBase(tickets))); }
+    void loadBase(int baseId, const QVector<BingoTicket> &tickets) { loadBase(baseId, TicketBase::fromTickets(tickets)); }
 
     // O modo agora é definido por prêmio, mas mantemos o global para compatibilidade se necessário
     void setGameMode(int gridIndex); 
     int getGameMode() const { return m_currentGridIndex; }
 
-    void setMaxBalls(int max) { m_maxBalls = max; }
+    void setMaxBalls(int max) { m_maxBalls = max; ++m_stateVersion; }
     int getMaxBalls() const { return m_maxBalls; }
 
-    void setNumChances(int chances) { m_numChances = chances; }
+    void setNumChances(int chances) { m_numChances = chances; ++m_stateVersion; }
     int getNumChances() const { return m_numChances; }
 
+    // Avaliação paralela: as cartelas de cada grade são divididas em fatias de 'shardSize'
+    // slots distribuídas entre 'threads' (0 = todos os núcleos, 1 = desligado)
+    void setWorkerThreads(int threads, int shardSize = 8192);
+    int getWorkerThreads() const { return m_workerThreads; }
+
     // Inicia um novo sorteio (limpa estado)
     // Se houver cartelas registradas, usa apenas elas.
     void startNewGame();
 
     // Gestão de Vendas (Cartelas Registradas)
     void registerTicket(int ticketId);
+    void registerTickets(const QList<int> &ticketIds);
+    // Desfaz a venda: com o jogo montado, a cartela sai da verificação e dos armados (o que ela
+    // já ganhou fica). Registrá-la de novo a devolve ao jogo, verificada por completo na próxima bola.
     void unregisterTicket(int ticketId);
     void clearRegisteredTickets();
-    int getRegisteredCount() const { return m_registeredTickets.size(); }
-    bool isTicketRegistered(int ticketId) const { return m_registeredTickets.contains(ticketId); }
+    int getRegisteredCount() const { return m_registeredCount; }
+    bool isTicketRegistered(int ticketId) const {
+        return ticketId >= 0 && (ticketId >> 6) < m_registeredBits.size()
+               && (m_registeredBits[ticketId >> 6] >> (ticketId & 63)) & 1;
+    }
     bool isValidCheckDigit(int ticketId, int checkDigit) const;
     QString getFormattedBarcode(int ticketId) const;
-    QSet<int> getRegisteredTickets() const { return m_registeredTickets; }
+    QSet<int> getRegisteredTickets() const;
     QVector<int> getTicketNumbers(int baseId, int ticketId) const;
 
     // Processa um numero sorteado
@@ -75,6 +164,10 @@ public:
     // Cancela a ultima bola sorteada
     int undoLastNumber(const QSet<int> &preRealizedIds = {});
 
+    // Troca a bola da posição 'position' por 'newNumber' mantendo as seguintes.
+    // Prêmios em preRealizedIds voltam a ser realizados assim que tiverem ganhadores.
+    bool correctNumber(int position, int newNumber, const QSet<int> &preRealizedIds = {});
+
     // Gestão de Premiações
     void addPrize(const Prize &prize);
     void clearPrizes();
@@ -84,28 +177,82 @@ public:
     // Getters para estado atual
     QList<int> getDrawnNumbers() const;
     QList<int> getWinners() const; // IDs das cartelas ganhadoras (BINGO/Cheia)
-    QMap<int, QList<int>> getNearWinTickets() const; // Map: Falta 1 -> [IDs], Falta 2 -> [IDs]...
+    QMap<int, QList<int>> getNearWinTickets() const; // Cheia da vez: Falta 1 -> [IDs], Falta 2 -> [IDs]...
+
+    // Histograma "falta N" de um prêmio (sem os ganhadores dele). Vazio se realizado/inativo.
+    QMap<int, int> getNearWinCounts(int prizeId, int maxMissing = 3) const; // faltam -> quantidade
+    QList<int> getNearWinners(int prizeId, int missing = 1, int limit = 10) const; // Menores IDs do balde
+    // Página das cartelas de um prêmio em ordem crescente de ID: missing = 0 são os ganhadores,
+    // N >= 1 os armados "falta N". 'afterId' é o último ID da página anterior (-1 = início).
+    // O array ordenado é montado na primeira consulta e reaproveitado até o estado mudar.
+    QList<int> getPrizeTicketPage(int prizeId, int missing, int afterId, int limit, int *total = nullptr) const;
     QJsonObject getDebugReport() const;
 
+    // Incrementada a cada mutação (bola, venda, prêmio, configuração): quem guarda algo derivado
+    // do estado compara a versão para saber se ainda vale
+    quint64 getStateVersion() const { return m_stateVersion; }
+
+    // Snapshot binário do estado do jogo: cartelas registradas, bolas, ganhadores, linhas de
+    // quina usadas, cartelas fechadas e situação de cada prêmio. As bases e os prêmios não vão
+    // no arquivo: restoreSnapshot() espera o motor já configurado igual (loadBase/addPrize, sem
+    // setGameMode) e recalcula os contadores a partir das máscaras. Retorna false sem alterar
+    // nada se o snapshot não bater com a configuração.
+    QByteArray saveSnapshot() const;
+    bool restoreSnapshot(const QByteArray &data);
+
 private:
-    QMap<int, QVector<BingoTicket>> m_bases; // baseId -> Tickets
+    // Compilação de padrões e layout das cartelas
+    int ensureGroup(int baseId, int gridIndex);
+    int compilePattern(TicketGroup &group, const Prize &prize);
+    void addTicketToGroup(TicketGroup &group, int ticketId, int row = -1);
+    void fillGroup(TicketGroup &group);
+    void rebuildGroups();
+    TicketBase::GridView gridOf(const TicketGroup &group, int ticketId) const;
+    void evaluateShard(EvalShard &shard, int number, const QVector<int> &eligible);
+    void runShards(QVector<EvalShard> &shards, int number, const QVector<QVector<int>> &eligibleByGroup);
+    bool checkSlot(const TicketGroup &group, const Prize &prize, int slot, int &wonLine, bool &nearWin) const;
+    void applyWin(int prizeIndex, int slot, int wonLine,
+                  QVector<QList<int>> &newWinners, QList<QPair<int, int>> &closedNow);
+    const Prize *findPrize(int prizeId) const;
+
+    // Journal de desfazer (um registro por bola desde a última mudança de configuração)
+    BallJournal *currentJournal() { return m_journal.isEmpty() ? nullptr : &m_journal.last(); }
+    void rollbackLastBall();
+    void replayBall(int number, const QSet<int> &preRealizedIds);
+
+    QMap<int, TicketBaseHandle> m_bases; // baseId -> Tickets (instância única do BingoBaseStore)
     int m_currentGridIndex; 
     int m_maxBalls;         
     int m_numChances;       
+    int m_workerThreads;
+    int m_shardSize;
+    QThreadPool *m_pool; // Criado por setWorkerThreads() quando há mais de uma thread
     
-    QList<int> m_drawnNumbers; 
+    QList<int> m_drawnNumbers; // Ordem do sorteio
+    BallMask m_drawnMask;      // Mesmo conjunto, para testes de bit
     
-    // Estado de cada cartela: Map (baseId, ticketId) -> State
-    QMap<QPair<int, int>, TicketState> m_activeTickets;
+    // Estado das cartelas registradas, agrupado por (base, grade)
+    QVector<TicketGroup> m_groups;
+    bool m_statesBuilt; // setGameMode() já materializou os slots das cartelas
+    QSet<int> m_scannedPrizeIds; // Prêmios elegíveis que já passaram por uma varredura completa
+    QVector<BallJournal> m_journal; // Cobre as últimas m_journal.size() bolas sorteadas
 
-    // Cache de vencedores e armados
+    // Cache de vencedores (armados vêm do histograma de cada padrão)
     QList<int> m_winners;
-    QMap<int, QList<int>> m_nearWins; 
 
-    QSet<int> m_registeredTickets; 
-    QMap<int, QHash<int, int>> m_idToDigitByBase;   // baseId -> (ID -> Digito)
-    QMap<int, QHash<int, QList<int>>> m_numToTicketsByBase; // baseId -> (Número -> Tickets)
+    // Cartelas vendidas: 1 bit por ID (os IDs das bases são densos, 1..N)
+    QVector<quint64> m_registeredBits;
+    int m_registeredCount;
     QList<Prize> m_prizes;         
+    quint64 m_stateVersion = 0;
+
+    // Arrays ordenados para a paginação, por (prêmio, faltam); valem para uma versão do estado
+    struct SortedTickets {
+        quint64 version = 0;
+        bool valid = false;
+        std::vector<int> ids;
+    };
+    mutable QHash<quint64, SortedTickets> m_sortedTickets;
 };
 
 #endif // BINGOGAMEENGINE_H
@@ -0,0 +1,278 @@
+#include "BingoIoPool.h"
+#include <QDebug>
+#include <QTcpSocket>
+#include <QJsonDocument>
+#include <QCborValue>
+#include <QCborMap>
+#include <QDateTime>
+
+BingoIoWorker::BingoIoWorker(BingoIoPool *pool, int index)
+    : m_pool(pool),
+      m_index(index)
+{
+}
+
+void BingoIoWorker::accept(qintptr descriptor)
+{
+    if (!m_handshake) {
+        // Criados aqui para pertencerem à thread de I/O
+        m_handshake = new QWebSocketServer(QStringLiteral("BingoSys Server"), QWebSocketServer::NonSecureMode, this);
+        connect(m_handshake, &QWebSocketServer::newConnection, this, &BingoIoWorker::onNewConnection);
+        m_slowTimer = new QTimer(this);
+        connect(m_slowTimer, &QTimer::timeout, this, &BingoIoWorker::checkSlowClients);
+        m_slowTimer->start(1000);
+    }
+    QTcpSocket *tcp = new QTcpSocket();
+    if (!tcp->setSocketDescriptor(descriptor)) {
+        qWarning() << "[IO" << m_index << "] Falha ao assumir a conexão:" << tcp->errorString();
+        delete tcp;
+        return;
+    }
+    m_handshake->handleConnection(tcp); // O QWebSocketServer assume o socket
+}
+
+void BingoIoWorker::onNewConnection()
+{
+    while (QWebSocket *socket = m_handshake->nextPendingConnection()) {
+        const ClientId id = (m_nextSerial++ << 8) | ClientId(m_index);
+        m_sockets.insert(id, socket);
+        m_ids.insert(socket, id);
+
+        // Decodificação na thread de I/O; a thread principal recebe o objeto pronto
+        connect(socket, &QWebSocket::textMessageReceived, this, [this, socket](const QString &message) {
+            QJsonDocument doc = QJsonDocument::fromJson(message.toUtf8());
+            if (doc.isObject()) onMessage(socket, doc.object());
+            else qWarning() << "Mensagem nao-JSON recebida:" << message;
+        });
+        connect(socket, &QWebSocket::binaryMessageReceived, this, [this, socket](const QByteArray &message) {
+            // Clientes CBOR podem mandar os comandos em binário; o conteúdo é o mesmo objeto do JSON
+            QCborParserError error;
+            QCborValue value = QCborValue::fromCbor(message, &error);
+            if (error.error == QCborError::NoError && value.isMap()) onMessage(socket, value.toMap().toJsonObject());
+            else qWarning() << "Mensagem binaria invalida recebida:" << message.size() << "bytes";
+        });
+        connect(socket, &QWebSocket::disconnected, this, [this, socket]() { onDisconnected(socket); });
+        connect(socket, &QWebSocket::bytesWritten, this, [this, socket]() { onBytesWritten(socket); });
+
+        BingoIoPool *pool = m_pool;
+        const QString peer = socket->peerAddress().toString();
+        QMetaObject::invokeMethod(pool, [pool, id, peer]() { emit pool->clientConnected(id, peer); }, Qt::QueuedConnection);
+    }
+}
+
+void BingoIoWorker::onMessage(QWebSocket *socket, const QJsonObject &json)
+{
+    const ClientId id = m_ids.value(socket);
+    if (!id) return;
+    BingoIoPool *pool = m_pool;
+    QMetaObject::invokeMethod(pool, [pool, id, json]() { emit pool->messageReceived(id, json); }, Qt::QueuedConnection);
+}
+
+void BingoIoWorker::onDisconnected(QWebSocket *socket)
+{
+    const ClientId id = m_ids.take(socket);
+    if (!id) return;
+    m_sockets.remove(id);
+    if (m_lagging.remove(id)) m_pool->m_laggingNow.fetchAndAddRelaxed(-1);
+    socket->deleteLater();
+    BingoIoPool *pool = m_pool;
+    QMetaObject::invokeMethod(pool, [pool, id]() { emit pool->clientDisconnected(id); }, Qt::QueuedConnection);
+}
+
+void BingoIoWorker::send(ClientId client, const QString &text, const QByteArray &binary)
+{
+    QWebSocket *socket = m_sockets.value(client);
+    if (!socket || !socket->isValid()) return; // Desconectou enquanto a mensagem estava na fila
+    // Resposta a um pedido do próprio cliente: vai mesmo atrasado, só o teto de memória barra
+    if (socket->bytesToWrite() > 4 * m_pool->m_sendBudget) {
+        dropSlowClient(client, socket, "teto de memória");
+        return;
+    }
+    if (!binary.isEmpty()) socket->sendBinaryMessage(binary);
+    else socket->sendTextMessage(text);
+}
+
+void BingoIoWorker::sendToMany(const QVector<ClientId> &textClients, const QString &text,
+                               const QVector<ClientId> &binaryClients, const QByteArray &binary, bool coalescible)
+{
+    for (ClientId client : textClients) {
+        QWebSocket *socket = m_sockets.value(client);
+        if (socket && socket->isValid()) sendUpdate(client, socket, text, QByteArray(), coalescible);
+    }
+    for (ClientId client : binaryClients) {
+        QWebSocket *socket = m_sockets.value(client);
+        if (socket && socket->isValid()) sendUpdate(client, socket, QString(), binary, coalescible);
+    }
+}
+
+void BingoIoWorker::sendUpdate(ClientId client, QWebSocket *socket, const QString &text, const QByteArray &binary,
+                               bool coalescible)
+{
+    if (!coalescible) {
+        // Evento de controle: o sync não o substitui, vai mesmo atrasado (só o teto de memória barra)
+        send(client, text, binary);
+        return;
+    }
+    if (overBudget(client, socket)) {
+        // Estado intermediário que o cliente nunca vai precisar: ele recebe o sync ao esvaziar a fila
+        m_pool->m_droppedFrames.fetchAndAddRelaxed(1);
+        m_pool->m_droppedBytes.fetchAndAddRelaxed(binary.isEmpty() ? text.size() : binary.size());
+        return;
+    }
+    if (!binary.isEmpty()) socket->sendBinaryMessage(binary);
+    else socket->sendTextMessage(text);
+}
+
+bool BingoIoWorker::overBudget(ClientId client, QWebSocket *socket)
+{
+    if (m_lagging.contains(client)) return true;
+    if (socket->bytesToWrite() <= m_pool->m_sendBudget) return false;
+    m_lagging.insert(client, QDateTime::currentMSecsSinceEpoch());
+    m_pool->m_slowClients.fetchAndAddRelaxed(1);
+    m_pool->m_laggingNow.fetchAndAddRelaxed(1);
+    qInfo() << "[IO" << m_index << "] Cliente lento" << socket->peerAddress().toString() << ":"
+            << socket->bytesToWrite() << "bytes na fila; atualizações suspensas até esvaziar.";
+    return true;
+}
+
+void BingoIoWorker::onBytesWritten(QWebSocket *socket)
+{
+    const ClientId id = m_ids.value(socket);
+    if (!id || !m_lagging.contains(id)) return;
+    // Histerese: só volta a receber com a fila na metade do orçamento
+    if (socket->bytesToWrite() > m_pool->m_sendBudget / 2) return;
+    m_lagging.remove(id);
+    m_pool->m_laggingNow.fetchAndAddRelaxed(-1);
+    m_pool->m_resyncs.fetchAndAddRelaxed(1);
+    BingoIoPool *pool = m_pool;
+    QMetaObject::invokeMethod(pool, [pool, id]() { emit pool->clientNeedsResync(id); }, Qt::QueuedConnection);
+}
+
+void BingoIoWorker::checkSlowClients()
+{
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    QList<ClientId> expired;
+    for (auto it = m_lagging.constBegin(); it != m_lagging.constEnd(); ++it) {
+        if (now - it.value() > m_pool->m_slowTimeoutMs) expired.append(it.key());
+    }
+    for (ClientId client : expired) {
+        if (QWebSocket *socket = m_sockets.value(client)) dropSlowClient(client, socket, "tempo limite");
+    }
+}
+
+void BingoIoWorker::dropSlowClient(ClientId client, QWebSocket *socket, const char *reason)
+{
+    qWarning() << "[IO" << m_index << "] Desconectando cliente lento" << socket->peerAddress().toString()
+               << "(" << reason << "," << socket->bytesToWrite() << "bytes na fila)";
+    m_pool->m_slowDisconnects.fetchAndAddRelaxed(1);
+    if (!m_lagging.contains(client)) {
+        m_lagging.insert(client, QDateTime::currentMSecsSinceEpoch());
+        m_pool->m_laggingNow.fetchAndAddRelaxed(1);
+    }
+    socket->abort(); // Descarta o buffer; o disconnected limpa o resto
+}
+
+void BingoIoWorker::closeClient(ClientId client)
+{
+    if (QWebSocket *socket = m_sockets.value(client)) socket->close();
+}
+
+void BingoIoWorker::shutdown()
+{
+    // Encerramento: fecha sem avisar a thread principal (ela já está saindo)
+    for (QWebSocket *socket : m_sockets) {
+        socket->disconnect(this);
+        socket->abort();
+        delete socket;
+    }
+    m_sockets.clear();
+    m_ids.clear();
+    m_lagging.clear();
+    delete m_handshake;
+    m_handshake = nullptr;
+}
+
+BingoIoPool::BingoIoPool(QObject *parent)
+    : QTcpServer(parent)
+{
+}
+
+BingoIoPool::~BingoIoPool()
+{
+    close();
+    for (int i = 0; i < m_workers.size(); ++i) {
+        BingoIoWorker *worker = m_workers[i];
+        QMetaObject::invokeMethod(worker, [worker]() { worker->shutdown(); }, Qt::BlockingQueuedConnection);
+        m_threads[i]->quit();
+        m_threads[i]->wait();
+        delete worker;
+        delete m_threads[i];
+    }
+}
+
+bool BingoIoPool::listen(const QHostAddress &address, quint16 port)
+{
+    if (m_workers.isEmpty()) {
+        const int threads = qBound(1, m_threadCount > 0 ? m_threadCount : QThread::idealThreadCount() / 2, 255);
+        for (int i = 0; i < threads; ++i) {
+            QThread *thread = new QThread();
+            thread->setObjectName(QString("bingo-io-%1").arg(i));
+            BingoIoWorker *worker = new BingoIoWorker(this, i);
+            worker->moveToThread(thread);
+            thread->start();
+            m_threads.append(thread);
+            m_workers.append(worker);
+        }
+        qInfo() << "BingoServer: WebSocket atendido por" << threads << "threads de I/O.";
+    }
+    return QTcpServer::listen(address, port);
+}
+
+void BingoIoPool::incomingConnection(qintptr descriptor)
+{
+    // Rodízio entre as threads; o socket só é criado lá, na thread que vai atendê-lo
+    BingoIoWorker *worker = m_workers[m_nextWorker];
+    m_nextWorker = (m_nextWorker + 1) % m_workers.size();
+    QMetaObject::invokeMethod(worker, [worker, descriptor]() { worker->accept(descriptor); }, Qt::QueuedConnection);
+}
+
+void BingoIoPool::send(ClientId client, const QString &text, const QByteArray &binary)
+{
+    const int index = workerOf(client);
+    if (index >= m_workers.size()) return;
+    BingoIoWorker *worker = m_workers[index];
+    QMetaObject::invokeMethod(worker, [worker, client, text, binary]() { worker->send(client, text, binary); },
+                              Qt::QueuedConnection);
+}
+
+void BingoIoPool::sendToMany(int index, const QVector<ClientId> &textClients, const QString &text,
+                             const QVector<ClientId> &binaryClients, const QByteArray &binary, bool coalescible)
+{
+    if (index >= m_workers.size()) return;
+    BingoIoWorker *worker = m_workers[index];
+    QMetaObject::invokeMethod(worker, [worker, textClients, text, binaryClients, binary, coalescible]() {
+        worker->sendToMany(textClients, text, binaryClients, binary, coalescible);
+    }, Qt::QueuedConnection);
+}
+
+void BingoIoPool::closeClient(ClientId client)
+{
+    const int index = workerOf(client);
+    if (index >= m_workers.size()) return;
+    BingoIoWorker *worker = m_workers[index];
+    QMetaObject::invokeMethod(worker, [worker, client]() { worker->closeClient(client); }, Qt::QueuedConnection);
+}
+
+QJsonObject BingoIoPool::stats() const
+{
+    QJsonObject obj;
+    obj["threads"] = m_workers.size();
+    obj["sendBudgetBytes"] = double(m_sendBudget);
+    obj["slowClients"] = double(m_slowClients.loadRelaxed());
+    obj["laggingNow"] = double(m_laggingNow.loadRelaxed());
+    obj["droppedFrames"] = double(m_droppedFrames.loadRelaxed());
+    obj["droppedBytes"] = double(m_droppedBytes.loadRelaxed());
+    obj["resyncs"] = double(m_resyncs.loadRelaxed());
+    obj["slowDisconnects"] = double(m_slowDisconnects.loadRelaxed());
+    return obj;
+}
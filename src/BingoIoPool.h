@@ -0,0 +1,128 @@
+#ifndef BINGOIOPOOL_H
+#define BINGOIOPOOL_H
+
+#include <QObject>
+#include <QTcpServer>
+#include <QWebSocketServer>
+#include <QWebSocket>
+#include <QThread>
+#include <QTimer>
+#include <QAtomicInteger>
+#include <QHash>
+#include <QVector>
+#include <QJsonObject>
+
+// Conexão de um cliente. Não é ponteiro: o QWebSocket vive na thread de I/O dele e a lógica
+// do jogo só conhece o ID. Os 8 bits baixos dizem em qual thread de I/O a conexão está.
+using ClientId = quint64;
+
+class BingoIoPool;
+
+// Uma thread de I/O: faz o handshake, lê e decodifica as mensagens (JSON ou CBOR) e escreve
+// os frames das conexões que recebeu. Tudo o que chega da lógica do jogo vem pela fila de
+// eventos da thread (QMetaObject::invokeMethod enfileirado).
+//
+// Cliente lento: com a fila do socket (bytesToWrite) acima do orçamento, os broadcasts de estado
+// (game_delta/sync_status, marcados como coalescíveis) são descartados para ele, porque o próximo
+// sync_status substitui todos. Eventos de controle (jogo iniciado, rodada apagada, venda,
+// configuração, carga) não são substituídos pelo sync e entram na fila mesmo assim. Quando a
+// fila esvazia, a thread principal é avisada para mandar o estado atual. Quem passa do tempo
+// limite acima do orçamento, ou do teto de memória, é desconectado.
+class BingoIoWorker : public QObject
+{
+    Q_OBJECT
+public:
+    BingoIoWorker(BingoIoPool *pool, int index);
+
+    // Chamados na thread do worker
+    void accept(qintptr descriptor);
+    void send(ClientId client, const QString &text, const QByteArray &binary);
+    void sendToMany(const QVector<ClientId> &textClients, const QString &text,
+                    const QVector<ClientId> &binaryClients, const QByteArray &binary, bool coalescible);
+    void closeClient(ClientId client);
+    void shutdown();
+
+private:
+    void onNewConnection();
+    void onMessage(QWebSocket *socket, const QJsonObject &json);
+    void onDisconnected(QWebSocket *socket);
+    void onBytesWritten(QWebSocket *socket);
+    // Broadcast: o coalescível é descartado se o cliente está atrasado
+    void sendUpdate(ClientId client, QWebSocket *socket, const QString &text, const QByteArray &binary, bool coalescible);
+    bool overBudget(ClientId client, QWebSocket *socket);
+    void checkSlowClients();
+    void dropSlowClient(ClientId client, QWebSocket *socket, const char *reason);
+
+    BingoIoPool *m_pool;
+    int m_index;
+    quint64 m_nextSerial = 1;
+    QWebSocketServer *m_handshake = nullptr; // Não escuta porta: só faz o upgrade dos sockets recebidos
+    QHash<ClientId, QWebSocket *> m_sockets;
+    QHash<QWebSocket *, ClientId> m_ids;
+    QHash<ClientId, qint64> m_lagging; // Clientes acima do orçamento -> desde quando (ms)
+    QTimer *m_slowTimer = nullptr;
+};
+
+// Porta de entrada: aceita as conexões TCP na thread principal, entrega cada descritor a uma
+// thread de I/O (rodízio) e repassa para a thread principal as mensagens já decodificadas.
+// O broadcast é dividido por thread: cada uma escreve nos seus sockets em paralelo.
+class BingoIoPool : public QTcpServer
+{
+    Q_OBJECT
+public:
+    explicit BingoIoPool(QObject *parent = nullptr);
+    ~BingoIoPool() override;
+
+    // Antes de listen(): quantidade de threads de I/O (0 = metade dos núcleos, no mínimo 1)
+    void setThreadCount(int threads) { m_threadCount = threads; }
+    // Antes de listen(): orçamento de envio por cliente (bytes na fila do socket) e quanto tempo
+    // um cliente pode passar acima dele antes de ser desconectado
+    void setSendBudget(qint64 bytes) { m_sendBudget = bytes; }
+    void setSlowClientTimeout(int ms) { m_slowTimeoutMs = ms; }
+    int threadCount() const { return m_workers.size(); }
+    bool listen(const QHostAddress &address, quint16 port);
+
+    static int workerOf(ClientId client) { return int(client & 0xff); }
+
+    // Chamados na thread principal; o envio acontece na thread de I/O da conexão.
+    // 'binary' vazio = frame de texto. 'coalescible' = o próximo sync_status substitui a
+    // mensagem, então ela pode ser descartada para cliente atrasado.
+    void send(ClientId client, const QString &text, const QByteArray &binary = QByteArray());
+    void sendToMany(int worker, const QVector<ClientId> &textClients, const QString &text,
+                    const QVector<ClientId> &binaryClients, const QByteArray &binary, bool coalescible);
+    void closeClient(ClientId client);
+
+    // Clientes lentos: quantos ficaram atrasados, frames descartados, ressincronizações e quedas
+    QJsonObject stats() const;
+
+Q_SIGNALS:
+    // Emitidos na thread principal
+    void clientConnected(ClientId client, const QString &peer);
+    void messageReceived(ClientId client, const QJsonObject &json);
+    void clientDisconnected(ClientId client);
+    void clientNeedsResync(ClientId client); // Cliente lento esvaziou a fila: precisa do estado atual
+
+protected:
+    void incomingConnection(qintptr descriptor) override;
+
+private:
+    friend class BingoIoWorker;
+
+    int m_threadCount = 0;
+    int m_nextWorker = 0;
+    QVector<BingoIoWorker *> m_workers;
+    QVector<QThread *> m_threads;
+
+    qint64 m_sendBudget = 1024 * 1024;
+    int m_slowTimeoutMs = 30 * 1000;
+
+    // Somadas pelas threads de I/O
+    QAtomicInteger<qint64> m_slowClients = 0;     // Vezes que um cliente passou do orçamento
+    QAtomicInteger<qint64> m_laggingNow = 0;      // Atrasados neste momento
+    QAtomicInteger<qint64> m_droppedFrames = 0;
+    QAtomicInteger<qint64> m_droppedBytes = 0;
+    QAtomicInteger<qint64> m_resyncs = 0;
+    QAtomicInteger<qint64> m_slowDisconnects = 0;
+};
+
+#endif // BINGOIOPOOL_H
@@ -0,0 +1,176 @@
+#include "BingoMatchKernel.h"
+#include <cstring>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define BINGO_KERNEL_X86 1
+#include <immintrin.h>
+#endif
+
+namespace BingoMatchKernel {
+
+namespace {
+
+void clearBits(quint64 *winBits, quint64 *nearBits, int count)
+{
+    const size_t words = size_t((count + 63) / 64);
+    std::memset(winBits, 0, words * sizeof(quint64));
+    std::memset(nearBits, 0, words * sizeof(quint64));
+}
+
+inline void setBit(quint64 *bits, int s) { bits[s >> 6] |= quint64(1) << (s & 63); }
+
+// s múltiplo de 32: os 32 bits cabem inteiros numa palavra
+inline void setBits32(quint64 *bits, int s, quint32 m) { bits[s >> 6] |= quint64(m) << (s & 63); }
+
+inline void scanSlot(const quint8 *remaining, int nLines, const quint32 *usedLines, const quint8 *closed,
+                     int s, quint64 *winBits, quint64 *nearBits)
+{
+    if (closed[s]) return;
+    const quint8 *r = remaining + size_t(s) * nLines;
+    const quint32 used = usedLines ? usedLines[s] : 0;
+    bool win = false, near = false;
+    for (int l = 0; l < nLines; ++l) {
+        if (r[l] == 0 && !(l < 32 && (used & (1u << l)))) win = true;
+        if (r[l] == 1) near = true;
+    }
+    if (win) setBit(winBits, s);
+    if (near) setBit(nearBits, s);
+}
+
+void scanScalar(const quint8 *remaining, int nLines, const quint32 *usedLines, const quint8 *closed,
+                int count, quint64 *winBits, quint64 *nearBits)
+{
+    clearBits(winBits, nearBits, count);
+    for (int s = 0; s < count; ++s) scanSlot(remaining, nLines, usedLines, closed, s, winBits, nearBits);
+}
+
+#if defined(BINGO_KERNEL_X86)
+
+// Padrões de várias linhas (quina): um slot por vez, todas as linhas num único registrador
+__attribute__((target("sse2")))
+void scanLinesSse2(const quint8 *remaining, int nLines, const quint32 *usedLines, const quint8 *closed,
+                   int count, quint64 *winBits, quint64 *nearBits)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+    const quint32 lineMask = (1u << nLines) - 1;
+    const size_t total = size_t(count) * nLines;
+    for (int s = 0; s < count; ++s) {
+        const size_t offset = size_t(s) * nLines;
+        if (offset + 16 > total) {
+            // Últimos slots: a carga de 16 bytes passaria do fim do array
+            scanSlot(remaining, nLines, usedLines, closed, s, winBits, nearBits);
+            continue;
+        }
+        if (closed[s]) continue;
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(remaining + offset));
+        quint32 win = quint32(_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero))) & lineMask;
+        const quint32 near = quint32(_mm_movemask_epi8(_mm_cmpeq_epi8(v, one))) & lineMask;
+        if (usedLines) win &= ~usedLines[s];
+        if (win) setBit(winBits, s);
+        if (near) setBit(nearBits, s);
+    }
+}
+
+__attribute__((target("sse2")))
+void scanSse2(const quint8 *remaining, int nLines, const quint32 *usedLines, const quint8 *closed,
+              int count, quint64 *winBits, quint64 *nearBits)
+{
+    clearBits(winBits, nearBits, count);
+    if (nLines > 16) {
+        for (int s = 0; s < count; ++s) scanSlot(remaining, nLines, usedLines, closed, s, winBits, nearBits);
+        return;
+    }
+    if (nLines > 1 || usedLines) {
+        scanLinesSse2(remaining, nLines, usedLines, closed, count, winBits, nearBits);
+        return;
+    }
+
+    // Padrão de uma linha (cheia/forma): 16 cartelas por comparação, contadores contíguos
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+    int s = 0;
+    for (; s + 32 <= count; s += 32) {
+        quint32 win = 0, near = 0;
+        for (int half = 0; half < 2; ++half) {
+            const int at = s + half * 16;
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(remaining + at));
+            const __m128i open = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(closed + at)), zero);
+            win |= quint32(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(v, zero), open))) << (half * 16);
+            near |= quint32(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(v, one), open))) << (half * 16);
+        }
+        setBits32(winBits, s, win);
+        setBits32(nearBits, s, near);
+    }
+    for (; s < count; ++s) scanSlot(remaining, nLines, usedLines, closed, s, winBits, nearBits);
+}
+
+__attribute__((target("avx2")))
+void scanAvx2(const quint8 *remaining, int nLines, const quint32 *usedLines, const quint8 *closed,
+              int count, quint64 *winBits, quint64 *nearBits)
+{
+    if (nLines != 1 || usedLines) {
+        // Quina: as linhas de um slot cabem em 16 bytes, AVX2 não traz ganho sobre SSE2
+        scanSse2(remaining, nLines, usedLines, closed, count, winBits, nearBits);
+        return;
+    }
+
+    // Padrão de uma linha (cheia/forma): 32 cartelas por comparação
+    clearBits(winBits, nearBits, count);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi8(1);
+    int s = 0;
+    for (; s + 32 <= count; s += 32) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(remaining + s));
+        const __m256i open = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(closed + s)), zero);
+        setBits32(winBits, s, quint32(_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(v, zero), open))));
+        setBits32(nearBits, s, quint32(_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(v, one), open))));
+    }
+    for (; s < count; ++s) scanSlot(remaining, nLines, usedLines, closed, s, winBits, nearBits);
+}
+
+#endif // BINGO_KERNEL_X86
+
+typedef void (*ScanFn)(const quint8 *, int, const quint32 *, const quint8 *, int, quint64 *, quint64 *);
+
+struct Dispatch {
+    ScanFn fn;
+    const char *name;
+};
+
+Dispatch pickImplementation()
+{
+#if defined(BINGO_KERNEL_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return { scanAvx2, "avx2" };
+    if (__builtin_cpu_supports("sse2")) return { scanSse2, "sse2" };
+#endif
+    return { scanScalar, "scalar" };
+}
+
+const Dispatch &dispatch()
+{
+    static const Dispatch d = pickImplementation();
+    return d;
+}
+
+} // namespace
+
+void scan(const quint8 *remaining, int nLines, const quint32 *usedLines, const quint8 *closed,
+          int count, quint64 *winBits, quint64 *nearBits)
+{
+    if (count <= 0) return;
+    if (nLines <= 0) {
+        // Sem linhas não há ganho nem armada
+        clearBits(winBits, nearBits, count);
+        return;
+    }
+    dispatch().fn(remaining, nLines, usedLines, closed, count, winBits, nearBits);
+}
+
+const char *isaName()
+{
+    return dispatch().name;
+}
+
+} // namespace BingoMatchKernel
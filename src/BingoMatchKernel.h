@@ -0,0 +1,28 @@
+#ifndef BINGOMATCHKERNEL_H
+#define BINGOMATCHKERNEL_H
+
+#include <QtGlobal>
+
+// Varredura em lote dos contadores de um padrão compilado (CompiledPattern::remaining).
+// Em vez de testar cartela por cartela, compara blocos contíguos de contadores com 0 e 1
+// usando SIMD (AVX2 ou SSE2, escolhido em tempo de execução) e devolve bitmaps de
+// "ganhou" e "armada" por slot. Usada nas varreduras completas (prêmio recém-elegível,
+// processNumber(0) após setPrizeStatus e replays).
+namespace BingoMatchKernel {
+
+// Slots por chamada típica; os bitmaps têm (count + 63) / 64 palavras
+constexpr int BlockSlots = 4096;
+
+// remaining: contadores [slot * nLines + linha] a partir do primeiro slot do lote
+// usedLines: linhas já premiadas por slot (nullptr = nenhuma), closed: 1 se a cartela fechou
+// Ganhou: alguma linha não usada com 0 faltando. Armada: alguma linha com 1 faltando.
+// Cartelas fechadas ficam fora dos dois bitmaps.
+void scan(const quint8 *remaining, int nLines, const quint32 *usedLines, const quint8 *closed,
+          int count, quint64 *winBits, quint64 *nearBits);
+
+// Implementação em uso: "avx2", "sse2" ou "scalar"
+const char *isaName();
+
+} // namespace BingoMatchKernel
+
+#endif // BINGOMATCHKERNEL_H
@@ -1,6 +1,9 @@
 #include "BingoServer.h"
 #include "BingoTicketParser.h"
+#include "BingoBaseStore.h"
 #include <algorithm>
+#include <functional>
+#include <memory>
 #include <QDebug>
 #include <QFile>
 #include <QFileInfo>
@@ -9,15 +12,38 @@
 #include <QJsonArray>
 #include <QDateTime>
 #include <QRandomGenerator>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QCborValue>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QSaveFile>
+
+namespace {
+const quint32 SNAPSHOT_FILE_MAGIC = 0x424E4757; // "BNGW"
+const quint32 SNAPSHOT_FILE_VERSION = 1;
+// Listas de cartelas no sync/delta levam só a prévia e o total; o resto é paginado
+const int TICKET_PREVIEW = 10;
+const int TICKET_PAGE_MAX = 200;
+// Carga adiada enquanto o sorteio tiver gravações na fila do writer
+const int LOAD_RETRY_MS = 500;
+}
 
 BingoServer::BingoServer(quint16 port, QObject *parent) :
     QObject(parent),
-    m_pWebSocketServer(new QWebSocketServer(QStringLiteral("BingoSys Server"),
-                                            QWebSocketServer::NonSecureMode, this)),
+    m_io(new BingoIoPool(this)),
+    m_actors(new BingoGameActors(this)),
     m_port(port),
     m_db(new BingoDatabaseManager(this)),
-    m_historyLimit(10)
+    m_historyLimit(10),
+    m_engineThreads(1),
+    m_snapshotDir("snapshots"),
+    m_snapshotTimer(new QTimer(this))
 {
+    // Snapshot periódico: após uma queda o sorteio volta do último snapshot + eventos mais novos
+    connect(m_snapshotTimer, &QTimer::timeout, this, &BingoServer::saveAllSnapshots);
+    m_snapshotTimer->start(30 * 1000);
+
     // Conecta ao banco na inicialização (valores fixos conforme ambiente do usuário)
     if (m_db->connectToDatabase("localhost", "bingosys", "bingosys", "bingosys")) {
         qInfo() << "BingoServer: Inicializado com PostgreSQL Local.";
@@ -26,87 +52,160 @@ BingoServer::BingoServer(quint16 port, QObject *parent) :
 
 BingoServer::~BingoServer()
 {
-    m_pWebSocketServer->close();
-    qDeleteAll(m_clients.begin(), m_clients.end());
+    delete m_actors; // Termina o trabalho em andamento nos motores antes de gravar e destruir
+    m_actors = nullptr;
+    m_mailboxes.clear();
+    m_db->aguardarGravacoes(); // No encerramento pode esperar: o snapshot só sai com o banco em dia
+    saveAllSnapshots();
+    delete m_io; // Fecha as conexões e encerra as threads de I/O
     // Limpa instancias de jogo
     for(auto& inst : m_gameInstances) delete inst.engine;
 }
 
 bool BingoServer::start()
 {
-    if (m_pWebSocketServer->listen(QHostAddress::Any, m_port)) {
-        connect(m_pWebSocketServer, &QWebSocketServer::newConnection,
-                this, &BingoServer::onNewConnection);
-        return true;
-    }
+    // Conexões chegam das threads de I/O já como mensagens decodificadas
+    connect(m_io, &BingoIoPool::clientConnected, this, &BingoServer::onClientConnected);
+    connect(m_io, &BingoIoPool::messageReceived, this, &BingoServer::handleJsonMessage);
+    connect(m_io, &BingoIoPool::clientDisconnected, this, &BingoServer::onClientDisconnected);
+    connect(m_io, &BingoIoPool::clientNeedsResync, this, &BingoServer::onClientNeedsResync);
+    if (m_io->listen(QHostAddress::Any, m_port)) return true;
+    m_io->disconnect(this);
     return false;
 }
 
+void BingoServer::setSnapshotInterval(int seconds)
+{
+    if (seconds > 0) m_snapshotTimer->start(seconds * 1000);
+    else m_snapshotTimer->stop();
+}
 
-BingoGameEngine* BingoServer::getEngine(int sorteioId)
+QString BingoServer::snapshotPath(int sorteioId) const
 {
-    if (m_gameInstances.contains(sorteioId)) {
-        return m_gameInstances[sorteioId].engine;
-    }
+    return QDir(m_snapshotDir).filePath(QString("sorteio_%1.snap").arg(sorteioId));
+}
 
-    QJsonObject sorteio = m_db->getSorteio(sorteioId);
-    if (sorteio.isEmpty()) return nullptr;
+void BingoServer::saveAllSnapshots()
+{
+    for (auto it = m_gameInstances.begin(); it != m_gameInstances.end(); ++it) {
+        if (isBusy(it.key())) continue; // Motor em uso na thread do sorteio; fica para o próximo ciclo
+        saveSnapshot(it.key(), it.value());
+    }
+}
 
-    QJsonArray rodadasArr = m_db->getRodadas(sorteioId);
-    if (rodadasArr.isEmpty()) {
-        qWarning() << "BingoServer: Sorteio" << sorteioId << "não possui rodadas cadastradas.";
+bool BingoServer::saveSnapshot(int sorteioId, GameInstance &inst)
+{
+    if (m_snapshotDir.isEmpty() || !inst.engine) return false;
+    const QByteArray state = inst.engine->saveSnapshot();
+    const uint stateHash = qHash(state);
+    if (stateHash == inst.savedStateHash) return true;
+
+    // Vendas e bolas passam pelo servidor antes de chegar ao motor, então o banco, sem gravação
+    // pendente do sorteio, é exatamente o que o motor já processou. Com fila, fica para a próxima
+    // rodada em vez de segurar a thread principal esperando o banco.
+    if (m_db->temGravacaoPendente(sorteioId)) return false;
+    const QPair<int, int> marca = m_db->getMarcaDagua(sorteioId);
+    const QList<QPair<int, int>> bolas = m_db->getBolasSorteadasComId(sorteioId);
+    QList<int> numeros;
+    for (const auto &bola : bolas) numeros.append(bola.second);
+    if (numeros != inst.engine->getDrawnNumbers()) {
+        qWarning() << "BingoServer: Bolas do sorteio" << sorteioId << "divergem do banco, snapshot não gravado.";
+        return false;
     }
 
-    GameInstance inst;
-    inst.engine = new BingoGameEngine(this);
-    inst.modeloId = sorteio["modelo_id"].toInt();
-    
-    // Carrega todas as bases requeridas pelas rodadas
-    QSet<int> requiredBases;
-    for (int i = 0; i < rodadasArr.size(); ++i) {
-        requiredBases.insert(rodadasArr[i].toObject()["base_id"].toInt());
-    }
-
-    for (int bid : requiredBases) {
-        // Precisamos do caminho_dados desta base. 
-        // Como o getRodadas já retornou o caminho_dados para cada rodada (via JOIN), 
-        // vamos pegá-lo da primeira rodada que usa esta base.
-        QString dataPath;
-        for (int i = 0; i < rodadasArr.size(); ++i) {
-            QJsonObject rObj = rodadasArr[i].toObject();
-            if (rObj["base_id"].toInt() == bid) {
-                dataPath = rObj["caminho_dados"].toString();
-                break;
-            }
-        }
+    QDir().mkpath(m_snapshotDir);
+    QSaveFile file(snapshotPath(sorteioId));
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "BingoServer: Não foi possível gravar" << file.fileName() << ":" << file.errorString();
+        return false;
+    }
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_15);
+    out << SNAPSHOT_FILE_MAGIC << SNAPSHOT_FILE_VERSION << qint32(sorteioId) << inst.configHash;
+    out << qint32(marca.first) << qint32(marca.second) << bolas << state;
+    if (out.status() != QDataStream::Ok || !file.commit()) {
+        qWarning() << "BingoServer: Falha ao gravar o snapshot do sorteio" << sorteioId;
+        return false;
+    }
+    inst.savedStateHash = stateHash;
+    return true;
+}
 
-        if (dataPath.isEmpty()) {
-            qWarning() << "BingoServer: Base" << bid << "não possui caminho de dados válido.";
-            continue;
-        }
+bool BingoServer::restoreSnapshot(int sorteioId, GameInstance &inst, const QHash<int, bool> &premiosRealizados,
+                                  const EngineLoadInput &input) const
+{
+    if (m_snapshotDir.isEmpty()) return false;
+    QFile file(snapshotPath(sorteioId));
+    if (!file.open(QIODevice::ReadOnly)) return false;
+
+    QElapsedTimer timer;
+    timer.start();
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_15);
+    quint32 magic = 0, version = 0;
+    qint32 sid = 0, hwmBola = 0, hwmVenda = 0;
+    QByteArray configHash, state;
+    QList<QPair<int, int>> bolas;
+    in >> magic >> version >> sid >> configHash >> hwmBola >> hwmVenda >> bolas >> state;
+    if (in.status() != QDataStream::Ok || magic != SNAPSHOT_FILE_MAGIC || version != SNAPSHOT_FILE_VERSION || sid != sorteioId) {
+        qWarning() << "BingoServer: Snapshot" << file.fileName() << "inválido, refazendo o sorteio pelo banco.";
+        return false;
+    }
+    if (configHash != inst.configHash) {
+        qInfo() << "BingoServer: Rodadas/prêmios/bases do sorteio" << sorteioId << "mudaram desde o snapshot, refazendo pelo banco.";
+        return false;
+    }
 
-        if (!m_ticketCache.contains(dataPath)) {
-            qInfo() << "BingoServer: Carregando base de cartelas:" << dataPath;
-            auto tickets = BingoTicketParser::parseFile(dataPath);
-            if (!tickets.isEmpty()) m_ticketCache.insert(dataPath, tickets);
-        }
+    // As bolas do snapshot têm que continuar sendo o início da lista do banco
+    // (bola desfeita ou corrigida depois do snapshot invalida o estado salvo)
+    const QList<QPair<int, int>> &bolasBanco = input.bolas;
+    if (bolasBanco.size() < bolas.size() || bolasBanco.mid(0, bolas.size()) != bolas) {
+        qInfo() << "BingoServer: Bolas do sorteio" << sorteioId << "mudaram desde o snapshot, refazendo pelo banco.";
+        return false;
+    }
+    if (!inst.engine->restoreSnapshot(state)) {
+        qWarning() << "BingoServer: Snapshot do sorteio" << sorteioId << "não confere com o motor, refazendo pelo banco.";
+        return false;
+    }
 
-        if (m_ticketCache.contains(dataPath)) {
-            inst.engine->loadBase(bid, m_ticketCache[dataPath]);
-        }
+    // Eventos posteriores à marca d'água: status dos prêmios, vendas novas e bolas novas
+    for (const Prize &p : inst.engine->getPrizes()) {
+        const bool realizada = premiosRealizados.value(p.id, p.realizada);
+        if (p.realizada != realizada) inst.engine->setPrizeStatus(p.id, realizada);
+    }
+    QList<int> novas;
+    for (const auto &venda : input.vendas) {
+        if (venda.first > hwmVenda) novas.append(venda.second);
     }
+    inst.engine->registerTickets(novas);
+    for (int i = bolas.size(); i < bolasBanco.size(); ++i) inst.engine->processNumber(bolasBanco[i].second);
+    if (!novas.isEmpty() && bolas.size() == bolasBanco.size()) inst.engine->processNumber(0); // Confere as vendas novas
 
-    // Carrega cartelas validadas
-    for (int ticketId : m_db->getCartelasValidadas(sorteioId)) {
-        inst.engine->registerTicket(ticketId);
+    qInfo() << "BingoServer: Sorteio" << sorteioId << "retomado do snapshot em" << timer.elapsed() << "ms ("
+            << novas.size() << "vendas e" << bolasBanco.size() - bolas.size() << "bolas reaplicadas)";
+    return true;
+}
+
+QHash<int, QString> BingoServer::basePathsFromRodadas(const QJsonArray &rodadas)
+{
+    // O getRodadas já traz o caminho_dados de cada rodada (via JOIN); vale o da primeira
+    // rodada que usa a base
+    QHash<int, QString> paths;
+    for (int i = 0; i < rodadas.size(); ++i) {
+        QJsonObject rObj = rodadas[i].toObject();
+        int bid = rObj["base_id"].toInt();
+        if (!paths.contains(bid) || paths.value(bid).isEmpty()) paths.insert(bid, rObj["caminho_dados"].toString());
     }
-    
-    // Adiciona prêmios ao motor
-    for (int i = 0; i < rodadasArr.size(); ++i) {
-        QJsonObject rodadaObj = rodadasArr[i].toObject();
+    return paths;
+}
+
+QList<Prize> BingoServer::prizesFromRodadas(const QJsonArray &rodadas, const QHash<int, TicketBaseHandle> &bases)
+{
+    QList<Prize> prizes;
+    for (int i = 0; i < rodadas.size(); ++i) {
+        QJsonObject rodadaObj = rodadas[i].toObject();
         int baseId = rodadaObj["base_id"].toInt();
         QString tipoGrade = rodadaObj["tipo_grade"].toString();
-        QString caminhoDados = rodadaObj["caminho_dados"].toString();
         QJsonObject configuracoesRodada = rodadaObj["configuracoes"].toObject();
 
         // Determina o gridIndex com base no tipo_grade (Ex: "75x25" -> 25)
@@ -114,11 +213,10 @@ BingoGameEngine* BingoServer::getEngine(int sorteioId)
         if (tipoGrade.contains('x')) nNums = tipoGrade.split('x').last().toInt();
         
         int gridIdx = 0;
-        const auto &baseTickets = m_ticketCache[caminhoDados];
-        if (!baseTickets.isEmpty()) {
-            const auto &grids = baseTickets.first().grids;
-            for (int j = 0; j < grids.size(); ++j) {
-                if (grids[j].size() == nNums) { gridIdx = j; break; }
+        const TicketBaseHandle baseTickets = bases.value(baseId);
+        if (baseTickets) {
+            for (int j = 0; j < baseTickets->gridCount(); ++j) {
+                if (baseTickets->cellCount(j) == nNums) { gridIdx = j; break; }
             }
         }
 
@@ -138,73 +236,430 @@ BingoGameEngine* BingoServer::getEngine(int sorteioId)
 
             QJsonArray padrao = premioObj["padrao"].toArray();
             for (const QJsonValue &v : padrao) p.padraoIndices.insert(v.toInt());
-            
-            inst.engine->addPrize(p);
+            prizes.append(p);
+        }
+    }
+    return prizes;
+}
+
+QByteArray BingoServer::configHash(const QJsonArray &rodadas, const QHash<int, TicketBaseHandle> &bases)
+{
+    // O status dos prêmios muda durante o jogo e não faz parte da configuração
+    QCryptographicHash config(QCryptographicHash::Md5);
+    for (int i = 0; i < rodadas.size(); ++i) {
+        QJsonObject rodadaObj = rodadas[i].toObject();
+        QJsonArray premiosArr = rodadaObj["premios"].toArray();
+        for (int j = 0; j < premiosArr.size(); ++j) {
+            QJsonObject premioObj = premiosArr[j].toObject();
+            premioObj.remove("realizada");
+            premiosArr[j] = premioObj;
+        }
+        rodadaObj["premios"] = premiosArr;
+        config.addData(QJsonDocument(rodadaObj).toJson(QJsonDocument::Compact));
+    }
+    for (auto it = bases.constBegin(); it != bases.constEnd(); ++it) {
+        config.addData(QString("%1:%2").arg(it.key()).arg(it.value()->contentHash()).toUtf8());
+    }
+    return config.result();
+}
+
+BingoGameEngine* BingoServer::getEngine(int sorteioId)
+{
+    auto it = m_gameInstances.constFind(sorteioId);
+    return it != m_gameInstances.constEnd() ? it.value().engine : nullptr;
+}
+
+bool BingoServer::loadEngine(int sorteioId, BingoGameActors::Task loaded)
+{
+    // Leituras do banco aqui (a conexão é da thread principal); parse das bases, vendas e
+    // replay das bolas vão para a thread do sorteio
+    QJsonObject sorteio = m_db->getSorteio(sorteioId);
+    if (sorteio.isEmpty()) return false;
+
+    // O motor é refeito das bolas e vendas do banco: com gravações do sorteio ainda na fila ele
+    // voltaria com menos do que os clientes já viram. Sem bloquear a thread principal, as
+    // mensagens do sorteio esperam na caixa e a carga tenta de novo até o writer alcançar.
+    if (m_db->temGravacaoPendente(sorteioId)) {
+        qWarning() << "BingoServer: Sorteio" << sorteioId << "com gravações pendentes; carga adiada.";
+        m_mailboxes[sorteioId].busy = true;
+        publishLoading(sorteioId, "gravacoes", 0, 0);
+        QTimer::singleShot(LOAD_RETRY_MS, this, [this, sorteioId, loaded]() {
+            m_mailboxes[sorteioId].busy = false;
+            if (loadEngine(sorteioId, loaded)) return;
+            if (loaded) loaded();
+            drainMailbox(sorteioId);
+        });
+        return true;
+    }
+
+    EngineLoadInput input;
+    input.rodadas = m_db->getRodadas(sorteioId);
+    if (input.rodadas.isEmpty()) {
+        qWarning() << "BingoServer: Sorteio" << sorteioId << "não possui rodadas cadastradas.";
+    }
+    input.vendas = m_db->getCartelasValidadasDesde(sorteioId, 0);
+    input.bolas = m_db->getBolasSorteadasComId(sorteioId);
+
+    // O motor é criado aqui para ser filho do servidor; só é preenchido na thread do sorteio
+    auto inst = std::make_shared<GameInstance>();
+    inst->engine = new BingoGameEngine(this);
+    if (m_engineThreads != 1) inst->engine->setWorkerThreads(m_engineThreads);
+    inst->modeloId = sorteio["modelo_id"].toInt();
+
+    qInfo() << "BingoServer: Carregando o sorteio" << sorteioId << "em segundo plano.";
+    auto elapsedMs = std::make_shared<qint64>(0);
+    runOnActor(sorteioId, [this, sorteioId, inst, input, elapsedMs]() {
+        QElapsedTimer timer;
+        timer.start();
+        buildEngine(sorteioId, *inst, input);
+        *elapsedMs = timer.elapsed();
+    }, [this, sorteioId, inst, loaded, elapsedMs]() {
+        m_gameInstances.insert(sorteioId, *inst);
+        m_mailboxes[sorteioId].loading = QJsonObject();
+        qInfo() << "BingoServer: Sorteio" << sorteioId << "carregado em" << *elapsedMs << "ms.";
+        if (loaded) loaded();
+    });
+    publishLoading(sorteioId, "bases", 0, 0);
+    return true;
+}
+
+void BingoServer::dropEngine(int sorteioId)
+{
+    if (m_gameInstances.contains(sorteioId)) {
+        delete m_gameInstances[sorteioId].engine;
+        m_gameInstances.remove(sorteioId);
+    }
+    // Sem trabalho na fila (caixa livre): a próxima carga escolhe a thread pela carga atual
+    m_actors->unpin(sorteioId);
+}
+
+void BingoServer::buildEngine(int sorteioId, GameInstance &inst, const EngineLoadInput &input)
+{
+    // Progresso vai pela fila de eventos da thread principal, na ordem, antes do fim da carga
+    auto progress = [this, sorteioId](const QString &stage, int done, int total) {
+        QMetaObject::invokeMethod(this, [this, sorteioId, stage, done, total]() {
+            publishLoading(sorteioId, stage, done, total);
+        }, Qt::QueuedConnection);
+    };
+
+    // Carrega todas as bases requeridas pelas rodadas
+    QHash<int, TicketBaseHandle> loadedBases;
+    const QHash<int, QString> basePaths = basePathsFromRodadas(input.rodadas);
+    int basesDone = 0;
+    for (auto it = basePaths.constBegin(); it != basePaths.constEnd(); ++it) {
+        progress("bases", basesDone++, basePaths.size());
+        if (it.value().isEmpty()) {
+            qWarning() << "BingoServer: Base" << it.key() << "não possui caminho de dados válido.";
+            continue;
+        }
+
+        // Instância única por conteúdo, compartilhada entre todos os sorteios que usam a base
+        TicketBaseHandle tickets = BingoBaseStore::instance().acquire(it.value());
+        if (tickets) {
+            inst.engine->loadBase(it.key(), tickets);
+            loadedBases.insert(it.key(), tickets);
         }
     }
 
-    // Inicializa o modo de jogo (isso vai criar os TicketStates com os gridIndices corretos)
-    inst.engine->setGameMode(0); 
+    // Adiciona prêmios ao motor
+    QHash<int, bool> premiosRealizados;
+    for (const Prize &p : prizesFromRodadas(input.rodadas, loadedBases)) {
+        premiosRealizados.insert(p.id, p.realizada);
+        inst.engine->addPrize(p);
+    }
+    inst.configHash = configHash(input.rodadas, loadedBases);
+
+    // Retomada rápida pelo snapshot; sem ele (ou se não servir) refaz tudo pelo banco
+    progress("snapshot", 0, 0);
+    if (restoreSnapshot(sorteioId, inst, premiosRealizados, input)) return;
+
+    // Carrega cartelas validadas
+    progress("vendas", 0, input.vendas.size());
+    QList<int> cartelas;
+    cartelas.reserve(input.vendas.size());
+    for (const auto &venda : input.vendas) cartelas.append(venda.second);
+    inst.engine->registerTickets(cartelas);
+
+    // Inicializa o modo de jogo (cria os slots das cartelas e compila os padrões de cada grade)
+    inst.engine->setGameMode(0);
 
     // Carrega bolas sorteadas
-    for (int bola : m_db->getBolasSorteadas(sorteioId)) {
-        inst.engine->processNumber(bola);
+    const int step = qMax(1, input.bolas.size() / 10);
+    for (int i = 0; i < input.bolas.size(); ++i) {
+        if (i % step == 0) progress("bolas", i, input.bolas.size());
+        inst.engine->processNumber(input.bolas[i].second);
     }
+}
+
+void BingoServer::publishLoading(int sorteioId, const QString &stage, int done, int total)
+{
+    auto box = m_mailboxes.find(sorteioId);
+    if (box == m_mailboxes.end()) return;
+
+    QJsonObject msg;
+    msg["action"] = "loading";
+    msg["sorteio_id"] = sorteioId;
+    msg["stage"] = stage;
+    msg["done"] = done;
+    msg["total"] = total;
+    msg["progress"] = total > 0 ? done * 100 / total : 0;
+    box.value().loading = msg;
+
+    // Inscritos (recarga depois de mudar rodadas) e quem está esperando na caixa (logins)
+    broadcastToGame(sorteioId, msg);
+    QSet<ClientId> notified = m_subscribers.value(sorteioId);
+    for (const auto &pending : box.value().pending) {
+        if (notified.contains(pending.first)) continue;
+        notified.insert(pending.first);
+        sendJson(pending.first, msg);
+    }
+}
+
+bool BingoServer::deferUntilLoaded(int sorteioId, ClientId client, const QJsonObject &json)
+{
+    if (m_gameInstances.contains(sorteioId)) return false;
+    // Sorteio inexistente segue sem motor, como antes
+    if (!loadEngine(sorteioId)) return false;
+    return deferIfBusy(sorteioId, client, json);
+}
+
+void BingoServer::onClientConnected(ClientId client, const QString &peer)
+{
+    m_peers.insert(client, peer);
+    qInfo() << "Novo cliente conectado:" << peer;
+}
+
+void BingoServer::onClientDisconnected(ClientId client)
+{
+    qInfo() << "Cliente desconectado:" << m_peers.value(client);
+    removeSession(client);
+    m_peers.remove(client);
+}
+
+void BingoServer::onClientNeedsResync(ClientId client)
+{
+    // Cliente lento perdeu atualizações descartadas: manda o estado atual como se ele tivesse
+    // pedido get_sync (passa pela caixa do sorteio se o motor estiver ocupado)
+    auto it = m_sessions.constFind(client);
+    if (it == m_sessions.constEnd() || it.value().sorteioId == 0) return;
+    QJsonObject request;
+    request["action"] = "get_sync";
+    handleJsonMessage(client, request);
+}
 
-    m_gameInstances.insert(sorteioId, inst);
-    return inst.engine;
+QByteArray BingoServer::encodeCbor(const QJsonObject &json)
+{
+    // Números inteiros do JSON (double) viram inteiros CBOR de 1 a 5 bytes; frações usam o menor float exato
+    return QCborValue::fromJsonValue(json).toCbor(QCborValue::UseFloat16);
 }
 
-void BingoServer::onNewConnection()
+const QString &BingoServer::EncodedMessage::asText()
 {
-    QWebSocket *pSocket = m_pWebSocketServer->nextPendingConnection();
+    if (text.isEmpty()) text = QString::fromUtf8(QJsonDocument(json).toJson(QJsonDocument::Compact));
+    return text;
+}
 
-    connect(pSocket, &QWebSocket::textMessageReceived, this, &BingoServer::processTextMessage);
-    connect(pSocket, &QWebSocket::disconnected, this, &BingoServer::socketDisconnected);
+const QByteArray &BingoServer::EncodedMessage::asCbor()
+{
+    if (cbor.isEmpty()) cbor = encodeCbor(json);
+    return cbor;
+}
 
-    m_clients << pSocket;
-    qInfo() << "Novo cliente conectado:" << pSocket->peerAddress().toString();
+void BingoServer::sendJson(ClientId client, const QJsonObject &json)
+{
+    EncodedMessage message;
+    message.json = json;
+    sendMessage(client, message);
 }
 
-void BingoServer::processTextMessage(QString message)
+void BingoServer::sendMessage(ClientId client, EncodedMessage &message)
 {
-    QWebSocket *pClient = qobject_cast<QWebSocket *>(sender());
-    // Tenta parsear como JSON
-    QJsonDocument doc = QJsonDocument::fromJson(message.toUtf8());
-    if (doc.isObject()) {
-        handleJsonMessage(pClient, doc.object());
+    if (!m_peers.contains(client)) return;
+    auto it = m_sessions.constFind(client);
+    if (it != m_sessions.constEnd() && it.value().binary) m_io->send(client, QString(), message.asCbor());
+    else m_io->send(client, message.asText());
+}
+
+void BingoServer::broadcastToGame(int sorteioId, const QJsonObject &json)
+{
+    EncodedMessage message;
+    message.json = json;
+    broadcastMessage(sorteioId, message);
+}
+
+void BingoServer::broadcastMessage(int sorteioId, EncodedMessage &message)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    // Separa os inscritos por thread de I/O e por protocolo; cada protocolo é serializado uma
+    // única vez e o buffer é compartilhado (implicit sharing) por todas as threads
+    const QSet<ClientId> subscribers = m_subscribers.value(sorteioId);
+    const int workers = m_io->threadCount();
+    QVector<QVector<ClientId>> textClients(workers), binaryClients(workers);
+    for (ClientId client : subscribers) {
+        const int worker = BingoIoPool::workerOf(client);
+        if (worker >= workers) continue;
+        if (m_sessions.value(client).binary) binaryClients[worker].append(client);
+        else textClients[worker].append(client);
+    }
+    int textCount = 0, binaryCount = 0;
+    for (int i = 0; i < workers; ++i) {
+        textCount += textClients[i].size();
+        binaryCount += binaryClients[i].size();
+    }
+    const QString text = textCount ? message.asText() : QString();
+    const QByteArray binary = binaryCount ? message.asCbor() : QByteArray();
+    const qint64 encodeNs = timer.nsecsElapsed();
+
+    // Só o estado do jogo pode ser descartado para cliente lento (ele ressincroniza com o sync);
+    // os demais eventos são de controle e sempre chegam
+    const QString action = message.json.value("action").toString();
+    const bool coalescible = action == "game_delta" || action == "sync_status";
+
+    // Cada thread de I/O escreve nos seus sockets em paralelo; aqui só entra na fila delas
+    for (int i = 0; i < workers; ++i) {
+        if (textClients[i].isEmpty() && binaryClients[i].isEmpty()) continue;
+        m_io->sendToMany(i, textClients[i], text, binaryClients[i], binary, coalescible);
+    }
+    const qint64 bytes = qint64(text.size()) * textCount + qint64(binary.size()) * binaryCount;
+    const qint64 totalNs = timer.nsecsElapsed();
+
+    BroadcastStats &stats = m_broadcastStats[sorteioId];
+    stats.messages++;
+    stats.frames += subscribers.size();
+    stats.bytes += bytes;
+    stats.totalNs += totalNs;
+    stats.maxNs = qMax(stats.maxNs, totalNs);
+
+    // Fan-out lento vai para o log; o caso normal fica só no debug
+    if (totalNs >= 50 * 1000000LL) {
+        qInfo() << "[BROADCAST] Sorteio" << sorteioId << "Evento:" << message.json.value("action").toString()
+                << "Clientes:" << subscribers.size() << "Bytes JSON/CBOR:" << text.size() << "/" << binary.size()
+                << "Serialização:" << encodeNs / 1000 << "us Despacho:" << (totalNs - encodeNs) / 1000 << "us";
     } else {
-        qWarning() << "Mensagem nao-JSON recebida:" << message;
+        qDebug() << "Broadcast p/ Sorteio" << sorteioId << "Evento:" << message.json.value("action").toString()
+                 << "Enviado p/" << subscribers.size() << "clientes em" << totalNs / 1000 << "us";
     }
 }
 
-void BingoServer::sendJson(QWebSocket *client, const QJsonObject &json)
+bool BingoServer::deferIfBusy(int sorteioId, ClientId client, const QJsonObject &json)
 {
-    if (client && client->isValid()) {
-        QJsonDocument doc(json);
-        client->sendTextMessage(QString::fromUtf8(doc.toJson(QJsonDocument::Compact)));
+    auto it = m_mailboxes.find(sorteioId);
+    if (it == m_mailboxes.end() || !it.value().busy) return false;
+    it.value().pending.enqueue(qMakePair(client, json));
+    if (!it.value().loading.isEmpty()) sendJson(client, it.value().loading);
+    return true;
+}
+
+void BingoServer::runOnActor(int sorteioId, BingoGameActors::Task work, BingoGameActors::Task done)
+{
+    m_mailboxes[sorteioId].busy = true;
+    m_actors->post(sorteioId, work, [this, sorteioId, done]() {
+        done();
+        m_mailboxes[sorteioId].busy = false;
+        drainMailbox(sorteioId);
+    });
+}
+
+void BingoServer::drainMailbox(int sorteioId)
+{
+    // Cada mensagem pode postar um novo trabalho; aí o resto volta a esperar o próximo 'done'
+    while (true) {
+        auto it = m_mailboxes.find(sorteioId);
+        if (it == m_mailboxes.end()) return;
+        if (it.value().busy) return;
+        if (!it.value().internal.isEmpty()) {
+            const BingoGameActors::Task task = it.value().internal.dequeue();
+            task();
+            continue;
+        }
+        if (it.value().pending.isEmpty()) {
+            m_mailboxes.erase(it);
+            return;
+        }
+        const QPair<ClientId, QJsonObject> message = it.value().pending.dequeue();
+        if (!m_peers.contains(message.first)) continue; // Desconectou enquanto esperava
+        handleJsonMessage(message.first, message.second);
     }
 }
 
-void BingoServer::broadcastToGame(int sorteioId, const QJsonObject &json)
+void BingoServer::whenIdle(int sorteioId, BingoGameActors::Task task)
 {
-    QJsonDocument doc(json);
-    QString msg = QString::fromUtf8(doc.toJson(QJsonDocument::Compact));
-    
-    int count = 0;
-    for (auto it = m_sessions.begin(); it != m_sessions.end(); ++it) {
-        if (it.value().sorteioId == sorteioId) {
-            it.key()->sendTextMessage(msg);
-            count++;
+    auto it = m_mailboxes.find(sorteioId);
+    if (it == m_mailboxes.end() || !it.value().busy) {
+        task();
+        return;
+    }
+    it.value().internal.enqueue(task);
+}
+
+void BingoServer::desfazerVenda(int sorteioId, int ticketId)
+{
+    qCritical() << "[VENDA] Cartela" << ticketId << "do sorteio" << sorteioId << "não foi gravada no banco; retirando do jogo.";
+    whenIdle(sorteioId, [this, sorteioId, ticketId]() {
+        BingoGameEngine *engine = getEngine(sorteioId);
+        if (!engine || !engine->isTicketRegistered(ticketId)) return; // Recarregado ou vendas limpas nesse meio tempo
+        runOnActor(sorteioId, [engine, ticketId]() { engine->unregisterTicket(ticketId); }, [this, sorteioId, ticketId]() {
+            BingoGameEngine *engine = getEngine(sorteioId);
+            if (!engine) return;
+            QJsonObject resp;
+            resp["action"] = "ticket_unregistered";
+            resp["ticketId"] = ticketId;
+            resp["totalRegistered"] = engine->getRegisteredCount();
+            broadcastToGame(sorteioId, resp);
+            publishDelta(sorteioId, QString()); // Armados/ganhadores sem a cartela
+        });
+    });
+}
+
+BingoDatabaseManager::Concluido BingoServer::concluirVendaEmLote(const QSharedPointer<VendaEmLote> &lote, int ticketId)
+{
+    // Os callbacks do banco chegam pela fila de eventos, depois do lote inteiro ter sido enfileirado
+    lote->pendentes++;
+    return [this, lote, ticketId](bool ok) {
+        if (!ok) {
+            lote->falhas.append(ticketId);
+            desfazerVenda(lote->sorteioId, ticketId);
         }
+        if (--lote->pendentes > 0 || lote->falhas.isEmpty()) return;
+        QJsonArray ids;
+        for (int id : lote->falhas) ids.append(id);
+        QJsonObject error;
+        error["action"] = "batch_registration_error";
+        error["origem"] = lote->origem;
+        error["count"] = lote->falhas.size();
+        error["ticketIds"] = ids;
+        error["message"] = QString("%1 cartela(s) do lote não puderam ser gravadas no banco de dados e foram retiradas do jogo.")
+                               .arg(lote->falhas.size());
+        sendJson(lote->operador, error); // Ignorado se a conexão já caiu
+    };
+}
+
+void BingoServer::setSession(ClientId client, const ClientSession &session)
+{
+    // Troca de sorteio (novo login na mesma conexão) sai da lista anterior
+    removeSession(client);
+    m_sessions[client] = session;
+    m_subscribers[session.sorteioId].insert(client);
+}
+
+void BingoServer::removeSession(ClientId client)
+{
+    auto it = m_sessions.find(client);
+    if (it == m_sessions.end()) return;
+    auto sub = m_subscribers.find(it.value().sorteioId);
+    if (sub != m_subscribers.end()) {
+        sub.value().remove(client);
+        if (sub.value().isEmpty()) m_subscribers.erase(sub);
     }
-    qInfo() << "Broadcast p/ Sorteio" << sorteioId << "Evento:" << json["action"].toString() << "Enviado p/" << count << "clientes.";
+    m_sessions.erase(it);
 }
 
-void BingoServer::handleJsonMessage(QWebSocket *client, const QJsonObject &json)
+void BingoServer::handleJsonMessage(ClientId client, const QJsonObject &json)
 {
     QString action = json["action"].toString();
-    qInfo() << "Mensagem Recebida - Açao:" << action << "Client:" << client->peerAddress().toString();
+    qInfo() << "Mensagem Recebida - Açao:" << action << "Client:" << m_peers.value(client);
     if (action == "ping") {
         QJsonObject pong;
         pong["action"] = "pong";
@@ -214,19 +669,23 @@ void BingoServer::handleJsonMessage(QWebSocket *client, const QJsonObject &json)
 
     if (action == "login") {
         QString chave = json["chave"].toString();
+        // Negociação do protocolo: clientes novos pedem "cbor"; sem o campo continua JSON texto
+        const bool wantsBinary = json["protocol"].toString() == "cbor";
         
         // Verifica se é o Token Mestre atual
         if (!m_masterToken.isEmpty() && chave == m_masterToken) {
             ClientSession session;
             session.sorteioId = 0;
             session.isOperator = true;
-            m_sessions[client] = session;
+            session.binary = wantsBinary;
+            setSession(client, session);
 
             QJsonObject response;
             response["action"] = "login_response";
             response["status"] = "ok";
             response["is_master"] = true;
             response["sorteio_id"] = 0;
+            response["protocol"] = wantsBinary ? "cbor" : "json";
             sendJson(client, response);
             return;
         }
@@ -238,24 +697,24 @@ void BingoServer::handleJsonMessage(QWebSocket *client, const QJsonObject &json)
         
         if (!res.isEmpty()) {
             int sid = res["sorteio_id"].toInt();
+            // O sync inicial lê o motor: espera o trabalho em andamento no sorteio (refaz o login depois)
+            if (deferIfBusy(sid, client, json)) return;
+            if (deferUntilLoaded(sid, client, json)) return;
             ClientSession session;
             session.sorteioId = sid;
             session.chaveId = res["id"].toInt();
             session.accessKey = chave;
             session.isOperator = (res["status"].toString() == "ativa"); // Chave valida = operador
-            m_sessions[client] = session;
+            session.binary = wantsBinary;
+            setSession(client, session);
 
             response["status"] = "ok";
+            response["protocol"] = wantsBinary ? "cbor" : "json";
             response["sorteio_id"] = sid;
             response["is_operator"] = session.isOperator;
             
             // Sincroniza estado inicial do jogo
-            BingoGameEngine *engine = getEngine(sid);
-            if (engine) {
-                QJsonObject sync = getGameStatusJson(sid);
-                sync["action"] = "sync_status";
-                sendJson(client, sync);
-            }
+            if (getEngine(sid)) sendMessage(client, syncStatus(sid, false));
         } else {
             response["status"] = "error";
             response["message"] = "Chave invalida ou ja utilizada";
@@ -274,7 +733,7 @@ void BingoServer::handleJsonMessage(QWebSocket *client, const QJsonObject &json)
             ClientSession session;
             session.sorteioId = 0; // 0 = Acesso Global
             session.isOperator = true;
-            m_sessions[client] = session;
+            setSession(client, session);
 
             // Gera um token de sessão mestre para persistência (refresh de página)
             m_masterToken = "MASTER-" + QString::number(QRandomGenerator::global()->generate()).mid(0, 8);
@@ -344,6 +803,7 @@ void BingoServer::handleJsonMessage(QWebSocket *client, const QJsonObject &json)
             // base_id e preferencias agora são por prêmio, mas aceitamos se enviados globalmente para legado
             
             if (m_db->atualizarConfigSorteio(sid, modeloId)) {
+                invalidateStatusCache(sid);
                 // Se houver campos de agendamento, atualiza
                 if (json.contains("data")) {
                     QDate d = QDate::fromString(json["data"].toString(), Qt::ISODate);
@@ -381,6 +841,7 @@ void BingoServer::handleJsonMessage(QWebSocket *client, const QJsonObject &json)
         return;
     }
     ClientSession &session = m_sessions[client];
+    if (deferIfBusy(session.sorteioId, client, json)) return;
     qInfo() << "Açao de Jogo:" << action << "SorteioID:" << session.sorteioId << "IsOperator:" << session.isOperator;
 
     // --- AÇÕES QUE NÃO EXIGEM MOTOR (ENGINE) CARREGADO ---
@@ -415,6 +876,7 @@ void BingoServer::handleJsonMessage(QWebSocket *client, const QJsonObject &json)
     }
 
     if (action == "get_my_tickets") {
+        if (deferUntilLoaded(session.sorteioId, client, json)) return;
         QString telefone = json["telefone"].toString();
         QList<int> ids = m_db->getCartelasPorTelefone(session.sorteioId, telefone);
         
@@ -433,6 +895,7 @@ void BingoServer::handleJsonMessage(QWebSocket *client, const QJsonObject &json)
         int modeloId = json["modelo_id"].toInt();
         
         if (m_db->atualizarConfigSorteio(session.sorteioId, modeloId)) {
+            invalidateStatusCache(session.sorteioId);
             // Agendamento
             if (json.contains("data")) {
                 QDate d = QDate::fromString(json["data"].toString(), Qt::ISODate);
@@ -447,21 +910,17 @@ void BingoServer::handleJsonMessage(QWebSocket *client, const QJsonObject &json)
             resp["status"] = "ok";
             sendJson(client, resp);
 
-            // Força recarga do motor se necessário (pode mudar prêmios/bases)
-            if (m_gameInstances.contains(session.sorteioId)) {
-                delete m_gameInstances[session.sorteioId].engine;
-                m_gameInstances.remove(session.sorteioId);
-            }
-            getEngine(session.sorteioId);
-
-            QJsonObject sync = getGameStatusJson(session.sorteioId);
-            sync["action"] = "sync_status";
-            broadcastToGame(session.sorteioId, sync);
+            // Força recarga do motor se necessário (pode mudar prêmios/bases); o sync vai ao fim da carga
+            dropEngine(session.sorteioId);
+            const int sid = session.sorteioId;
+            auto broadcastSync = [this, sid]() { broadcastMessage(sid, syncStatus(sid, true)); };
+            if (!loadEngine(sid, broadcastSync)) broadcastSync();
         }
         return;
     }
 
     // --- AÇÕES QUE EXIGEM MOTOR (ENGINE) CARREGADO ---
+    if (deferUntilLoaded(session.sorteioId, client, json)) return;
     BingoGameEngine *engine = getEngine(session.sorteioId);
     if (!engine) {
         qWarning() << "BingoServer: Falha ao carregar motor para sorteio" << session.sorteioId << ". Verifique a base de dados.";
@@ -471,8 +930,7 @@ void BingoServer::handleJsonMessage(QWebSocket *client, const QJsonObject &json)
     if (action == "draw_number" && session.isOperator) {
         // REGRA CRÍTICA: Se o sorteio já terminou, não permite novos números de jeito nenhum.
         // Isso evita que números "fantasmas" entrem no cache e corrompam o 'Desfazer'.
-        QJsonObject currentStatus = getGameStatusJson(session.sorteioId);
-        if (currentStatus["isFinished"].toBool()) {
+        if (isGameFinished(engine)) {
              QJsonObject error;
              error["action"] = "draw_number_error";
              error["message"] = "Sorteio já concluído. Não é possível inserir mais números.";
@@ -535,127 +993,212 @@ void BingoServer::handleJsonMessage(QWebSocket *client, const QJsonObject &json)
             return;
         }
 
-        int number = json["number"].toInt();
-        engine->processNumber(number); 
-        m_db->salvarBolaSorteada(session.sorteioId, number);
-        
-        // --- AUTOMAÇÃO: Verifica se algum prêmio foi ganho agora ---
-        prizes = engine->getPrizes();
-        QList<Prize*> winningPrizes;
-        
-        // Identifica prêmios que NÃO estavam realizados mas AGORA tem ganhadores
-        for(int i = 0; i < prizes.size(); ++i) {
-            if (prizes[i].active && !prizes[i].realizada && !prizes[i].winners.isEmpty()) {
-                int pid = prizes[i].id;
-                m_db->atualizarStatusPremio(pid, true);
-                engine->setPrizeStatus(pid, true);
-                qInfo() << "BingoServer: Prêmio" << pid << "(" << prizes[i].nome << ") marcado automaticamente como REALIZADO.";
+        const int number = json["number"].toInt();
+        const int sid = session.sorteioId;
+        const int chaveId = session.isOperator ? session.chaveId : 0;
+
+        // A bola e a automação dos prêmios rodam na thread do sorteio; banco e publicação voltam para cá
+        struct Resultado {
+            QList<Prize> realizados;
+            bool finished = false;
+        };
+        auto r = std::make_shared<Resultado>();
+        runOnActor(sid, [engine, number, r]() {
+            engine->processNumber(number);
+
+            // --- AUTOMAÇÃO: prêmios que NÃO estavam realizados mas AGORA tem ganhadores ---
+            const QList<Prize> prizes = engine->getPrizes();
+            for (const Prize &p : prizes) {
+                if (p.active && !p.realizada && !p.winners.isEmpty()) {
+                    engine->setPrizeStatus(p.id, true);
+                    r->realizados.append(p);
+                }
+            }
+            r->finished = isGameFinished(engine);
+        }, [this, sid, number, chaveId, r]() {
+            m_db->salvarBolaSorteada(sid, number);
+            for (const Prize &p : r->realizados) {
+                m_db->atualizarStatusPremio(p.id, true);
+                qInfo() << "BingoServer: Prêmio" << p.id << "(" << p.nome << ") marcado automaticamente como REALIZADO.";
             }
-        }
-        
-        QJsonObject broadcast = getGameStatusJson(session.sorteioId);
-        broadcast["action"] = "number_drawn";
-        broadcast["number"] = number;
-        
-        broadcastToGame(session.sorteioId, broadcast);
 
-        // Se o sorteio terminou, bloqueia a chave que iniciou o processo (se for operador)
-        if (broadcast["isFinished"].toBool() && session.isOperator && session.chaveId > 0) {
-            m_db->bloquearChave(session.chaveId);
-            qInfo() << "[SECURITY] Sorteio" << session.sorteioId << "concluído. Chave" << session.chaveId << "inativada.";
-        }
+            // Só o que mudou com a bola (bola, ganhadores novos, faixas "falta N", status dos prêmios)
+            QJsonObject extra;
+            extra["number"] = number;
+            publishDelta(sid, "number_drawn", extra);
+
+            // Se o sorteio terminou, bloqueia a chave que iniciou o processo (se for operador)
+            if (r->finished && chaveId > 0) {
+                m_db->bloquearChave(chaveId);
+                qInfo() << "[SECURITY] Sorteio" << sid << "concluído. Chave" << chaveId << "inativada.";
+            }
+        });
     }
     else if (action == "finalize_prize" && session.isOperator) {
         int premioId = json["prizeId"].toInt();
         bool realizada = json["realizada"].toBool(true);
 
         if (m_db->atualizarStatusPremio(premioId, realizada)) {
-             // Atualiza no motor vivo diretamente
-             engine->setPrizeStatus(premioId, realizada);
-
-             QJsonObject sync = getGameStatusJson(session.sorteioId);
-             
-             QJsonObject resp;
-             resp["action"] = "premio_status_updated";
-             resp["prizeId"] = premioId;
-             resp["realizada"] = realizada;
-             resp["isFinished"] = sync["isFinished"]; // Redundância de segurança
-             broadcastToGame(session.sorteioId, resp);
-
-             sync["action"] = "sync_status";
-             broadcastToGame(session.sorteioId, sync);
-
-             // REGRA DE SEGURANÇA: Bloqueio/Reativação de Chave
-             bool isFinished = sync["isFinished"].toBool();
-             if (session.isOperator && session.chaveId > 0) {
-                 if (isFinished) {
-                     m_db->bloquearChave(session.chaveId);
-                     qInfo() << "[SECURITY] Sorteio" << session.sorteioId << "concluído (manual). Chave" << session.chaveId << "inativada.";
-                 } else if (!realizada) {
-                     // Se reabriu um prêmio, garante que a chave volte a ser ATIVA
-                     m_db->reativarChave(session.chaveId);
-                     qInfo() << "[SECURITY] Sorteio" << session.sorteioId << "REABERTO (manual). Chave" << session.chaveId << "reativada.";
+             const int sid = session.sorteioId;
+             const int chaveId = session.isOperator ? session.chaveId : 0;
+             auto isFinished = std::make_shared<bool>(false);
+             // Atualiza o motor vivo na thread do sorteio (reavalia armados e turnos)
+             runOnActor(sid, [engine, premioId, realizada, isFinished]() {
+                 engine->setPrizeStatus(premioId, realizada);
+                 *isFinished = isGameFinished(engine);
+             }, [this, sid, chaveId, premioId, realizada, isFinished]() {
+                 QJsonObject extra;
+                 extra["prizeId"] = premioId;
+                 extra["realizada"] = realizada;
+                 publishDelta(sid, "premio_status_updated", extra, true);
+
+                 // REGRA DE SEGURANÇA: Bloqueio/Reativação de Chave
+                 if (chaveId > 0) {
+                     if (*isFinished) {
+                         m_db->bloquearChave(chaveId);
+                         qInfo() << "[SECURITY] Sorteio" << sid << "concluído (manual). Chave" << chaveId << "inativada.";
+                     } else if (!realizada) {
+                         // Se reabriu um prêmio, garante que a chave volte a ser ATIVA
+                         m_db->reativarChave(chaveId);
+                         qInfo() << "[SECURITY] Sorteio" << sid << "REABERTO (manual). Chave" << chaveId << "reativada.";
+                     }
                  }
-             }
+             });
         }
     }
     else if (action == "undo_last" && session.isOperator) {
-        // 1. Captura o estado dos prêmios ANTES do undo para saber quais reabrir (se necessário)
-        QSet<int> preRealizedIds;
-        auto prizesBefore = engine->getPrizes();
-        for (const auto &p : prizesBefore) {
-            if (p.realizada) preRealizedIds.insert(p.id);
-        }
+        const int sid = session.sorteioId;
+        const int chaveId = session.isOperator ? session.chaveId : 0;
+
+        // O undo e a reavaliação rodam na thread do sorteio; banco e publicação voltam para cá
+        struct Resultado {
+            int num = -1;
+            QList<Prize> reabertos;
+            bool finished = false;
+        };
+        auto r = std::make_shared<Resultado>();
+        runOnActor(sid, [engine, r]() {
+            // 1. Captura o estado dos prêmios ANTES do undo para saber quais reabrir (se necessário)
+            QSet<int> preRealizedIds;
+            for (const auto &p : engine->getPrizes()) {
+                if (p.realizada) preRealizedIds.insert(p.id);
+            }
 
-        // 2. Executa o undo no motor passando os IDs que já estavam realizados
-        int num = engine->undoLastNumber(preRealizedIds);
+            // 2. Executa o undo no motor passando os IDs que já estavam realizados
+            r->num = engine->undoLastNumber(preRealizedIds);
+            if (r->num == -1) return;
 
-        if (num != -1) {
-            bool dbOk = m_db->removerUltimaBola(session.sorteioId, num);
-            qInfo() << "[UNDO] Bola" << num << "removida. DB status:" << dbOk;
-            
             // 3. RE-AVALIAÇÃO DE REABERTURA:
-            // Sincronizamos o status no DB apenas para prêmios que estavam realizados mas agora não estão.
-            auto prizesAfter = engine->getPrizes();
-            int reabertos = 0;
-            QString reabertosNomes;
-
-            for(const auto &p : prizesAfter) {
-                // Se o prêmio estava realizado ANTES, mas no replay sem a última bola o motor diz que NÃO está 'realizada'
-                // (isso acontece porque ele perdeu os ganhadores com a remoção da bola).
-                if (preRealizedIds.contains(p.id) && !p.realizada) {
-                    m_db->atualizarStatusPremio(p.id, false);
-                    reabertos++;
-                    reabertosNomes += p.nome + " ";
-                }
-            }
-
-            if (reabertos > 0) {
-                qInfo() << "[UNDO-REOPEN] Sorteio" << session.sorteioId << ". Prêmios reabertos automaticamente:" << reabertosNomes;
+            // O motor volta ao estado exato de antes da bola (journal); prêmios realizados por ela reabrem.
+            // Se o prêmio estava realizado ANTES, mas sem a última bola o motor diz que NÃO está 'realizada'
+            // (isso acontece porque ele perdeu os ganhadores com a remoção da bola).
+            for (const auto &p : engine->getPrizes()) {
+                if (preRealizedIds.contains(p.id) && !p.realizada) r->reabertos.append(p);
             }
 
             // Força o motor a processar o estado sem a bola (para atualizar armados e turnos)
             engine->processNumber(0);
+            r->finished = isGameFinished(engine);
+        }, [this, sid, chaveId, r]() {
+            if (r->num == -1) return;
+            const int num = r->num;
+            m_db->removerUltimaBola(sid, num, [sid, num](bool dbOk) {
+                qInfo() << "[UNDO] Bola" << num << "do sorteio" << sid << "removida. DB status:" << dbOk;
+            });
 
-            // Gera status sincronizado após as reaberturas
-            QJsonObject sync = getGameStatusJson(session.sorteioId);
-            sync["action"] = "number_cancelled";
-            sync["number"] = num;
-            sync["reabertos"] = reabertos;
-            broadcastToGame(session.sorteioId, sync);
+            // Sincronizamos o status no DB apenas para prêmios que estavam realizados mas agora não estão.
+            QString reabertosNomes;
+            for (const Prize &p : r->reabertos) {
+                m_db->atualizarStatusPremio(p.id, false);
+                reabertosNomes += p.nome + " ";
+            }
+            if (!r->reabertos.isEmpty()) {
+                qInfo() << "[UNDO-REOPEN] Sorteio" << sid << ". Prêmios reabertos automaticamente:" << reabertosNomes;
+            }
 
-            // CRITICAL FIX: Força uma sincronização completa para garantir que o painel atualize os status dos prêmios
-            QJsonObject fullSync = getGameStatusJson(session.sorteioId);
-            fullSync["action"] = "sync_status";
-            broadcastToGame(session.sorteioId, fullSync);
+            // Publica só o que mudou após as reaberturas; resync pede ao painel que redesenhe os prêmios
+            QJsonObject extra;
+            extra["number"] = num;
+            extra["reabertos"] = r->reabertos.size();
+            publishDelta(sid, "number_cancelled", extra, true);
 
             // REGRA DE SEGURANÇA: Reativa a chave se o sorteio não estiver mais concluído
-            bool isFinished = sync["isFinished"].toBool();
-            if (!isFinished && session.isOperator && session.chaveId > 0) {
-                m_db->reativarChave(session.chaveId);
-                qInfo() << "[SECURITY] Sorteio" << session.sorteioId << "REABERTO via Undo. Chave" << session.chaveId << "reativada.";
+            if (!r->finished && chaveId > 0) {
+                m_db->reativarChave(chaveId);
+                qInfo() << "[SECURITY] Sorteio" << sid << "REABERTO via Undo. Chave" << chaveId << "reativada.";
             }
+        });
+    }
+    else if (action == "correct_number" && session.isOperator) {
+        // Corrige uma bola lançada errada no meio da sequência, mantendo as seguintes
+        int position = json["position"].toInt(-1);
+        int number = json["number"].toInt();
+        QList<int> drawn = engine->getDrawnNumbers();
+
+        int antigo = (position >= 0 && position < drawn.size()) ? drawn[position] : -1;
+        if (antigo == -1) {
+            QJsonObject error;
+            error["action"] = "correct_number_error";
+            error["message"] = "Não foi possível corrigir a bola: posição inválida ou número já sorteado.";
+            sendJson(client, error);
+            return;
         }
+        const int sid = session.sorteioId;
+        const int chaveId = session.isOperator ? session.chaveId : 0;
+
+        struct Resultado {
+            bool ok = false;
+            QList<int> reabertos;
+            QList<int> realizados;
+            bool finished = false;
+        };
+        auto r = std::make_shared<Resultado>();
+        runOnActor(sid, [engine, position, number, r]() {
+            QSet<int> preRealizedIds;
+            for (const auto &p : engine->getPrizes()) {
+                if (p.realizada) preRealizedIds.insert(p.id);
+            }
+            if (!engine->correctNumber(position, number, preRealizedIds)) return;
+            r->ok = true;
+
+            // Sincroniza o status dos prêmios: reabre os que perderam ganhadores e
+            // realiza os que passaram a ter (mesma automação do draw_number)
+            for (const auto &p : engine->getPrizes()) {
+                if (preRealizedIds.contains(p.id) && !p.realizada) r->reabertos.append(p.id);
+            }
+            for (const auto &p : engine->getPrizes()) {
+                if (p.active && !p.realizada && !p.winners.isEmpty()) {
+                    engine->setPrizeStatus(p.id, true);
+                    r->realizados.append(p.id);
+                }
+            }
+            r->finished = isGameFinished(engine);
+        }, [this, client, sid, chaveId, position, number, antigo, r]() {
+            if (!r->ok) {
+                QJsonObject error;
+                error["action"] = "correct_number_error";
+                error["message"] = "Não foi possível corrigir a bola: posição inválida ou número já sorteado.";
+                sendJson(client, error);
+                return;
+            }
+
+            m_db->corrigirBola(sid, antigo, number, [sid, antigo, number, position](bool dbOk) {
+                qInfo() << "[CORRECAO] Sorteio" << sid << "bola" << antigo << "-> " << number
+                        << "na posição" << position + 1 << ". DB status:" << dbOk;
+            });
+            for (int pid : r->reabertos) m_db->atualizarStatusPremio(pid, false);
+            for (int pid : r->realizados) m_db->atualizarStatusPremio(pid, true);
+
+            QJsonObject extra;
+            extra["position"] = position;
+            extra["number"] = number;
+            publishDelta(sid, "number_corrected", extra, true);
+
+            if (chaveId > 0) {
+                if (r->finished) m_db->bloquearChave(chaveId);
+                else m_db->reativarChave(chaveId);
+            }
+        });
     }
     else if (action == "start_game" && session.isOperator) {
         // 1. Verificação de Segurança via Banco de Dados (Ultimate Source of Truth)
@@ -671,8 +1214,7 @@ void BingoServer::handleJsonMessage(QWebSocket *client, const QJsonObject &json)
         }
 
         // 2. Bloqueio de reset para sorteios já concluídos (via estado do motor)
-        QJsonObject currentStatus = getGameStatusJson(session.sorteioId);
-        bool finished = currentStatus["isFinished"].toBool();
+        bool finished = isGameFinished(engine);
         
         qInfo() << "[DEBUG] Solicitação de RESET para SorteioID:" << session.sorteioId 
                 << "Status isFinished:" << finished;
@@ -688,19 +1230,78 @@ void BingoServer::handleJsonMessage(QWebSocket *client, const QJsonObject &json)
             return;
         }
 
-        engine->startNewGame();
-        m_db->limparSorteio(session.sorteioId);
-        QJsonObject broadcast;
-        broadcast["action"] = "game_started";
-        broadcastToGame(session.sorteioId, broadcast);
-        
-        // Envia sync completo logo após reset
-        QJsonObject sync = getGameStatusJson(session.sorteioId);
-        sync["action"] = "sync_status";
-        broadcastToGame(session.sorteioId, sync);
+        const int sid = session.sorteioId;
+        runOnActor(sid, [engine]() { engine->startNewGame(); }, [this, sid]() {
+            m_db->limparSorteio(sid);
+            QJsonObject broadcast;
+            broadcast["action"] = "game_started";
+            broadcastToGame(sid, broadcast);
+
+            // Envia sync completo logo após reset
+            broadcastMessage(sid, syncStatus(sid, true));
+        });
+    }
+    else if (action == "get_prize_tickets") {
+        // Lista completa de ganhadores/armados de um prêmio, em páginas ordenadas por ID.
+        // cursor = último ticketId recebido (ausente = início); nextCursor nulo = fim da lista.
+        const int prizeId = json["prizeId"].toInt();
+        const QString kind = json["kind"].toString("winners");
+        const int missing = kind == "near_winners" ? qBound(1, json["missing"].toInt(1), 3) : 0;
+        const int cursor = json["cursor"].isDouble() ? json["cursor"].toInt() : -1;
+        const int limit = qBound(1, json["limit"].toInt(50), TICKET_PAGE_MAX);
+
+        const QList<Prize> prizes = engine->getPrizes();
+        auto prize = std::find_if(prizes.begin(), prizes.end(), [prizeId](const Prize &p) { return p.id == prizeId; });
+        if (prize == prizes.end() || (kind != "winners" && kind != "near_winners")) {
+            QJsonObject error;
+            error["action"] = "prize_tickets_error";
+            error["prizeId"] = prizeId;
+            error["message"] = "Prêmio ou tipo de lista inválido.";
+            sendJson(client, error);
+            return;
+        }
+
+        // Pede um a mais: só há próxima página se ele existir (uma última página exata fecha a lista)
+        int total = 0;
+        QList<int> ids = engine->getPrizeTicketPage(prizeId, missing, cursor, limit + 1, &total);
+        const bool hasMore = ids.size() > limit;
+        if (hasMore) ids.removeLast();
+        QJsonArray tickets;
+        for (int id : ids) {
+            tickets.append(missing == 0 ? getPrizeWinnerJson(session.sorteioId, *prize, id)
+                                        : getTicketDetailsJson(session.sorteioId, id, prize->baseId));
+        }
+
+        QJsonObject resp;
+        resp["action"] = "prize_tickets";
+        resp["prizeId"] = prizeId;
+        resp["kind"] = kind;
+        if (missing > 0) resp["missing"] = missing;
+        resp["cursor"] = cursor;
+        resp["total"] = total;
+        resp["tickets"] = tickets;
+        // A próxima página começa depois do último ID desta
+        resp["nextCursor"] = hasMore ? QJsonValue(ids.last()) : QJsonValue();
+        sendJson(client, resp);
+    }
+    else if (action == "get_sync") {
+        // Cliente perdeu um game_delta (lacuna no seq): reenvia o estado completo
+        sendMessage(client, syncStatus(session.sorteioId, false));
     }
     else if (action == "get_server_debug") {
         QJsonObject resp = engine->getDebugReport();
+        resp["db_writer"] = m_db->estatisticasGravacao();
+        const BroadcastStats stats = m_broadcastStats.value(session.sorteioId);
+        QJsonObject broadcast;
+        broadcast["subscribers"] = m_subscribers.value(session.sorteioId).size();
+        broadcast["messages"] = double(stats.messages);
+        broadcast["frames"] = double(stats.frames);
+        broadcast["bytes"] = double(stats.bytes);
+        broadcast["avgUs"] = stats.messages ? double(stats.totalNs / stats.messages / 1000) : 0.0;
+        broadcast["maxUs"] = double(stats.maxNs / 1000);
+        resp["broadcast"] = broadcast;
+        resp["actors"] = m_actors->stats();
+        resp["io"] = m_io->stats();
         resp["action"] = "server_debug_report";
         sendJson(client, resp);
         qInfo() << "BingoServer: Relatório de depuração solicitado pelo cliente. Enviado.";
@@ -737,6 +1338,7 @@ void BingoServer::handleJsonMessage(QWebSocket *client, const QJsonObject &json)
         // 1. Salva a Rodada (Grupo Pai)
         int rodadaId = m_db->addRodada(session.sorteioId, nome, baseId, config, ordem);
         if (rodadaId > 0) {
+            invalidateStatusCache(session.sorteioId);
             qInfo() << "[DEBUG] add_rodada: Rodada salva com ID:" << rodadaId << ". Salvando prêmios...";
             // 2. Salva cada Prêmio (Regras Filhas)
             for (int i = 0; i < premios.size(); ++i) {
@@ -745,21 +1347,17 @@ void BingoServer::handleJsonMessage(QWebSocket *client, const QJsonObject &json)
             }
             qInfo() << "[DEBUG] add_rodada: Rodada e prêmios concluídos. Recarregando engine.";
 
-            // Força recarga do motor para incluir a nova estrutura
-            if (m_gameInstances.contains(session.sorteioId)) {
-                delete m_gameInstances[session.sorteioId].engine;
-                m_gameInstances.remove(session.sorteioId);
-            }
-            getEngine(session.sorteioId);
+            // Força recarga do motor para incluir a nova estrutura (em segundo plano; o sync vai ao fim da carga)
+            dropEngine(session.sorteioId);
 
             QJsonObject resp;
             resp["action"] = "rodada_added";
             resp["status"] = "ok";
             sendJson(client, resp);
-            
-            QJsonObject sync = getGameStatusJson(session.sorteioId);
-            sync["action"] = "sync_status";
-            broadcastToGame(session.sorteioId, sync);
+
+            const int sid = session.sorteioId;
+            auto broadcastSync = [this, sid]() { broadcastMessage(sid, syncStatus(sid, true)); };
+            if (!loadEngine(sid, broadcastSync)) broadcastSync();
         } else {
             qCritical() << "[DEBUG] add_rodada: Falha ao salvar no DB!";
             QJsonObject error;
@@ -777,6 +1375,7 @@ void BingoServer::handleJsonMessage(QWebSocket *client, const QJsonObject &json)
     else if (action == "delete_rodada" && session.isOperator) {
         int rodadaId = json["id"].toInt();
         if (m_db->removerRodada(rodadaId)) {
+            invalidateStatusCache(session.sorteioId);
             // Recarrega prêmios no motor para sincronizar
             engine->clearPrizes();
             QJsonArray dbRodadas = m_db->getRodadas(session.sorteioId);
@@ -802,9 +1401,7 @@ void BingoServer::handleJsonMessage(QWebSocket *client, const QJsonObject &json)
             resp["id"] = rodadaId;
             broadcastToGame(session.sorteioId, resp);
             
-            QJsonObject sync = getGameStatusJson(session.sorteioId);
-            sync["action"] = "sync_status";
-            broadcastToGame(session.sorteioId, sync);
+            broadcastMessage(session.sorteioId, syncStatus(session.sorteioId, true));
         }
     }
     else if (action == "register_ticket" && session.isOperator) {
@@ -813,8 +1410,19 @@ void BingoServer::handleJsonMessage(QWebSocket *client, const QJsonObject &json)
         int ticketId = barcode / 10;
         int checkDigit = barcode % 10;
         
-        if (engine->isValidCheckDigit(ticketId, checkDigit)) {
-            if (m_db->registrarVenda(session.sorteioId, ticketId, telefone)) {
+        // A venda é gravada em segundo plano: a duplicidade é conferida na memória do motor
+        if (engine->isValidCheckDigit(ticketId, checkDigit) && !engine->isTicketRegistered(ticketId)) {
+            const int sid = session.sorteioId;
+            const ClientId operador = client;
+            if (m_db->registrarVenda(sid, ticketId, telefone, "Manual", [this, operador, sid, ticketId](bool ok) {
+                    if (ok) return;
+                    desfazerVenda(sid, ticketId);
+                    QJsonObject error;
+                    error["action"] = "register_ticket_error";
+                    error["ticketId"] = ticketId;
+                    error["message"] = "A venda não pôde ser gravada no banco de dados e foi cancelada.";
+                    sendJson(operador, error); // Ignorado se a conexão já caiu
+                })) {
                 engine->registerTicket(ticketId);
                 
                 QJsonObject resp;
@@ -850,10 +1458,15 @@ void BingoServer::handleJsonMessage(QWebSocket *client, const QJsonObject &json)
         QList<int> availableList = availableIds.toList();
         std::shuffle(availableList.begin(), availableList.end(), *QRandomGenerator::global());
 
+        QSharedPointer<VendaEmLote> lote(new VendaEmLote);
+        lote->operador = client;
+        lote->sorteioId = session.sorteioId;
+        lote->origem = "Teste";
+
         int limit = qMin(count, availableList.size());
         for(int i = 0; i < limit; ++i) {
             int tid = availableList[i];
-            if (m_db->registrarVenda(session.sorteioId, tid, telefone, "Teste")) {
+            if (m_db->registrarVenda(session.sorteioId, tid, telefone, "Teste", concluirVendaEmLote(lote, tid))) {
                 engine->registerTicket(tid);
                 registered++;
             }
@@ -869,6 +1482,10 @@ void BingoServer::handleJsonMessage(QWebSocket *client, const QJsonObject &json)
     else if (action == "import_sales" && session.isOperator) {
         QJsonArray list = json["list"].toArray();
         int count = 0;
+        QSharedPointer<VendaEmLote> lote(new VendaEmLote);
+        lote->operador = client;
+        lote->sorteioId = session.sorteioId;
+        lote->origem = "Importacao";
         for(int i = 0; i < list.size(); ++i) {
             QJsonObject item = list[i].toObject();
             int barcode = item["barcode"].toInt();
@@ -877,7 +1494,7 @@ void BingoServer::handleJsonMessage(QWebSocket *client, const QJsonObject &json)
             int check = barcode % 10;
 
             if (engine->isValidCheckDigit(tid, check) && !engine->isTicketRegistered(tid)) {
-                if (m_db->registrarVenda(session.sorteioId, tid, tel, "Importacao")) {
+                if (m_db->registrarVenda(session.sorteioId, tid, tel, "Importacao", concluirVendaEmLote(lote, tid))) {
                     engine->registerTicket(tid);
                     count++;
                 }
@@ -908,17 +1525,6 @@ void BingoServer::handleJsonMessage(QWebSocket *client, const QJsonObject &json)
     }
 }
 
-void BingoServer::socketDisconnected()
-{
-    QWebSocket *pClient = qobject_cast<QWebSocket *>(sender());
-    if (pClient) {
-        qInfo() << "Cliente desconectado:" << pClient->peerAddress().toString();
-        m_clients.removeAll(pClient);
-        m_sessions.remove(pClient);
-        pClient->deleteLater();
-    }
-}
-
 QJsonObject BingoServer::getTicketDetailsJson(int sorteioId, int ticketId, int baseId)
 {
     QJsonObject obj;
@@ -946,6 +1552,176 @@ QJsonObject BingoServer::getTicketDetailsJson(int sorteioId, int ticketId, int b
 }
 
 
+QJsonObject BingoServer::getPrizeWinnerJson(int sorteioId, const Prize &prize, int ticketId)
+{
+    QJsonObject winObj = getTicketDetailsJson(sorteioId, ticketId, prize.baseId);
+    if (prize.winnerPatterns.contains(ticketId)) {
+        QJsonArray dynPadrao;
+        for(int idx : prize.winnerPatterns[ticketId]) dynPadrao.append(idx);
+        winObj["padrao"] = dynPadrao;
+    }
+    return winObj;
+}
+
+QJsonObject BingoServer::nearCountsJson(const QMap<int, int> &counts)
+{
+    QJsonObject obj;
+    for(auto it = counts.begin(); it != counts.end(); ++it) obj[QString::number(it.key())] = it.value();
+    return obj;
+}
+
+QJsonObject BingoServer::turnNearCountsJson(BingoGameEngine *engine)
+{
+    // Histograma "faltam 1/2/3" do prêmio da vez (mantido pelo motor a cada bola)
+    QJsonObject nearCounts;
+    for (const auto &p : engine->getPrizes()) {
+        if (p.active && !p.realizada && p.tipo != "forma") {
+            nearCounts = nearCountsJson(engine->getNearWinCounts(p.id));
+            nearCounts["prizeId"] = p.id;
+            break;
+        }
+    }
+    return nearCounts;
+}
+
+BingoServer::PublishedState BingoServer::captureState(BingoGameEngine *engine) const
+{
+    PublishedState state;
+    state.drawn = engine->getDrawnNumbers();
+    state.totalRegistered = engine->getRegisteredCount();
+    const QList<int> winners = engine->getWinners();
+    state.winners = winners.mid(0, TICKET_PREVIEW);
+    state.winnersTotal = winners.size();
+    state.nearWins = engine->getNearWinTickets().value(1);
+    state.finished = isGameFinished(engine);
+
+    state.nearCounts = turnNearCountsJson(engine);
+
+    for (const auto &p : engine->getPrizes()) {
+        PublishedState::PrizeView view;
+        view.realizada = p.realizada;
+        view.winners = p.winners.mid(0, TICKET_PREVIEW);
+        view.winnersTotal = p.winners.size();
+        view.nearWinners = engine->getNearWinners(p.id, 1, TICKET_PREVIEW);
+        view.nearCounts = nearCountsJson(engine->getNearWinCounts(p.id));
+        state.prizes.insert(p.id, view);
+    }
+    return state;
+}
+
+void BingoServer::publishDelta(int sorteioId, const QString &event, const QJsonObject &extra, bool resync)
+{
+    if (!m_gameInstances.contains(sorteioId)) return;
+    BingoGameEngine *engine = m_gameInstances[sorteioId].engine;
+    PublishedState &published = m_published[sorteioId];
+    PublishedState now = captureState(engine);
+
+    int firstBaseId = -1;
+    const QList<Prize> prizes = engine->getPrizes();
+    if (!prizes.isEmpty()) firstBaseId = prizes.first().baseId;
+
+    // Lista que só cresceu vai como "<chave>_added" (só os novos); qualquer outra mudança
+    // (undo, correção) reenvia a lista inteira em "<chave>"
+    auto diffTickets = [](QJsonObject &out, const QString &key, const QList<int> &before, const QList<int> &after,
+                          const std::function<QJsonObject(int)> &details) {
+        if (before == after) return;
+        QJsonArray arr;
+        const bool appended = after.size() > before.size() && after.mid(0, before.size()) == before;
+        for (int i = appended ? before.size() : 0; i < after.size(); ++i) arr.append(details(after[i]));
+        out[appended ? key + "_added" : key] = arr;
+    };
+
+    QJsonObject delta = extra;
+    if (published.drawn != now.drawn) {
+        int common = 0;
+        while (common < published.drawn.size() && common < now.drawn.size() && published.drawn[common] == now.drawn[common]) ++common;
+        if (published.drawn.size() > common) delta["balls_removed"] = published.drawn.size() - common;
+        QJsonArray added;
+        for (int i = common; i < now.drawn.size(); ++i) added.append(now.drawn[i]);
+        if (!added.isEmpty()) delta["balls_added"] = added;
+    }
+    if (published.totalRegistered != now.totalRegistered) delta["totalRegistered"] = now.totalRegistered;
+    diffTickets(delta, "winners", published.winners, now.winners,
+                [&](int id) { return getTicketDetailsJson(sorteioId, id, firstBaseId); });
+    if (published.winnersTotal != now.winnersTotal) delta["winners_total"] = now.winnersTotal;
+    if (published.nearWins != now.nearWins) {
+        QJsonArray arr;
+        for (int id : now.nearWins) arr.append(getTicketDetailsJson(sorteioId, id, firstBaseId));
+        QJsonObject nearWins;
+        if (!arr.isEmpty()) nearWins["1"] = arr;
+        delta["near_wins"] = nearWins;
+    }
+    if (published.nearCounts != now.nearCounts) delta["near_counts"] = now.nearCounts;
+    if (published.finished != now.finished) delta["isFinished"] = now.finished;
+
+    QJsonArray premios;
+    for (const auto &p : prizes) {
+        const PublishedState::PrizeView before = published.prizes.value(p.id);
+        const PublishedState::PrizeView &after = now.prizes[p.id];
+        QJsonObject po;
+        if (!published.prizes.contains(p.id) || before.realizada != after.realizada) po["realizada"] = after.realizada;
+        diffTickets(po, "winners", before.winners, after.winners,
+                    [&](int id) { return getPrizeWinnerJson(sorteioId, p, id); });
+        if (before.winnersTotal != after.winnersTotal) po["winners_total"] = after.winnersTotal;
+        if (before.nearWinners != after.nearWinners) {
+            QJsonArray arr;
+            for (int id : after.nearWinners) arr.append(getTicketDetailsJson(sorteioId, id, p.baseId));
+            po["near_winners"] = arr;
+        }
+        if (before.nearCounts != after.nearCounts) po["near_counts"] = after.nearCounts;
+        if (po.isEmpty()) continue;
+        po["id"] = p.id;
+        premios.append(po);
+    }
+    if (!premios.isEmpty()) delta["premios"] = premios;
+
+    // Sem evento e sem mudança não há o que publicar
+    if (event.isEmpty() && delta.isEmpty()) return;
+
+    now.seq = published.seq + 1;
+    published = now;
+    delta["action"] = "game_delta";
+    delta["event"] = event.isEmpty() ? QString("state_changed") : event;
+    delta["seq"] = double(now.seq);
+    if (resync) delta["resync"] = true;
+    broadcastToGame(sorteioId, delta);
+}
+
+BingoServer::EncodedMessage &BingoServer::syncStatus(int sorteioId, bool broadcast)
+{
+    BingoGameEngine *engine = getEngine(sorteioId);
+    if (broadcast) {
+        // Enviado a todos: o próprio sync é o próximo ponto da sequência
+        const quint64 seq = m_published.value(sorteioId).seq + 1;
+        PublishedState state = engine ? captureState(engine) : PublishedState();
+        state.seq = seq;
+        m_published[sorteioId] = state;
+    } else {
+        // Enviado a um cliente: os demais recebem antes o que ainda não foi publicado
+        publishDelta(sorteioId, QString());
+    }
+
+    const quint64 seq = m_published.value(sorteioId).seq;
+    const quint64 version = engine ? engine->getStateVersion() : 0;
+    StatusCache &cache = m_statusCache[sorteioId];
+    if (cache.sync.json.isEmpty() || cache.engine != engine || cache.version != version) {
+        cache.engine = engine;
+        cache.version = version;
+        cache.sync = EncodedMessage();
+        cache.sync.json = getGameStatusJson(sorteioId);
+        cache.sync.json["action"] = "sync_status";
+    } else if (cache.seq != seq) {
+        // Só o seq mudou (ex.: delta sem efeito no estado): reaproveita o objeto, refaz os buffers
+        cache.sync.text.clear();
+        cache.sync.cbor.clear();
+    } else {
+        return cache.sync;
+    }
+    cache.seq = seq;
+    cache.sync.json["seq"] = double(seq);
+    return cache.sync;
+}
+
 QJsonObject BingoServer::getGameStatusJson(int sorteioId)
 {
     QJsonObject sync;
@@ -963,23 +1739,24 @@ QJsonObject BingoServer::getGameStatusJson(int sorteioId)
     int firstBaseId = -1;
     if (!engine->getPrizes().isEmpty()) firstBaseId = engine->getPrizes().first().baseId;
 
-    for(int w : engine->getWinners()) 
+    // Só a prévia: com milhares de ganhadores o sync continua do mesmo tamanho
+    const QList<int> winners = engine->getWinners();
+    for (int w : winners.mid(0, TICKET_PREVIEW))
         winnersArray.append(getTicketDetailsJson(sorteioId, w, firstBaseId));
     sync["winners"] = winnersArray;
+    sync["winners_total"] = winners.size();
 
-    // Near Wins (Boas)
+    // Near Wins (Boas): a lista da UI é só "falta 1"; as demais faixas vão como contagem
     QJsonObject nearWins;
     auto nwMap = engine->getNearWinTickets();
-    for(auto it = nwMap.begin(); it != nwMap.end(); ++it) {
+    if (nwMap.contains(1)) {
         QJsonArray arr;
-        int count = 0;
-        for(int id : it.value()) {
-            arr.append(getTicketDetailsJson(sorteioId, id, firstBaseId));
-            if (++count >= 10) break;
-        }
-        nearWins[QString::number(it.key())] = arr;
+        for(int id : nwMap.value(1)) arr.append(getTicketDetailsJson(sorteioId, id, firstBaseId));
+        nearWins["1"] = arr;
     }
     sync["near_wins"] = nearWins;
+
+    sync["near_counts"] = turnNearCountsJson(engine);
     
     // Rodadas e Prêmios (Sempre enviamos a estrutura aninhada do DB para a UI)
     QJsonArray rodadas = m_db->getRodadas(sorteioId);
@@ -996,21 +1773,16 @@ QJsonObject BingoServer::getGameStatusJson(int sorteioId)
         po["active"] = p.active;
         
         QJsonArray pWinners;
-        for(int id : p.winners) {
-            QJsonObject winObj = getTicketDetailsJson(sorteioId, id, p.baseId);
-            if (p.winnerPatterns.contains(id)) {
-                QJsonArray dynPadrao;
-                for(int idx : p.winnerPatterns[id]) dynPadrao.append(idx);
-                winObj["padrao"] = dynPadrao;
-            }
-            pWinners.append(winObj);
-        }
+        for (int id : p.winners.mid(0, TICKET_PREVIEW)) pWinners.append(getPrizeWinnerJson(sorteioId, p, id));
         po["winners"] = pWinners;
+        po["winners_total"] = p.winners.size();
 
         QJsonArray pNearWinners;
-        for(int id : p.near_winners) pNearWinners.append(getTicketDetailsJson(sorteioId, id, p.baseId));
+        for(int id : engine->getNearWinners(p.id, 1, TICKET_PREVIEW)) pNearWinners.append(getTicketDetailsJson(sorteioId, id, p.baseId));
         po["near_winners"] = pNearWinners;
 
+        po["near_counts"] = nearCountsJson(engine->getNearWinCounts(p.id));
+
         QJsonArray padraoArr;
         for(int idx : p.padraoIndices) padraoArr.append(idx);
         po["padrao"] = padraoArr;
@@ -1037,29 +1809,17 @@ QJsonObject BingoServer::getGameStatusJson(int sorteioId)
     sync["hora_inicio"] = sorteio["hora_inicio"].toString();
     sync["hora_fim"] = sorteio["hora_fim"].toString();
 
-    // Verificação de conclusão
-    bool allRealized = true;
-    auto prizesList = engine->getPrizes();
-    if (prizesList.isEmpty()) {
-        allRealized = false;
-        qDebug() << "[DEBUG] getGameStatusJson: SorteioID" << sorteioId << "sem prêmios - isFinished=false";
-    } else {
-        QString debugPrizes;
-        for(const auto &p : prizesList) {
-            debugPrizes += QString("[%1: A=%2, R=%3] ").arg(p.nome).arg(p.active).arg(p.realizada);
-            if (p.active && !p.realizada) {
-                allRealized = false;
-                // Não break aqui para logar todos os estados se necessário, mas para performance:
-                // break; 
-            }
-        }
-        if (!allRealized) {
-             qDebug() << "[DEBUG] getGameStatusJson: SorteioID" << sorteioId << "em aberto. Estados:" << debugPrizes;
-        } else {
-             qInfo() << "[DEBUG] getGameStatusJson: SorteioID" << sorteioId << "CONCLUÍDO. Todos prêmios realizados.";
-        }
-    }
-    sync["isFinished"] = allRealized;
-
+    sync["isFinished"] = isGameFinished(engine);
     return sync;
 }
+
+bool BingoServer::isGameFinished(BingoGameEngine *engine)
+{
+    // Concluído quando todos os prêmios ativos foram realizados (sem prêmios = em aberto)
+    const QList<Prize> prizes = engine->getPrizes();
+    if (prizes.isEmpty()) return false;
+    for (const auto &p : prizes) {
+        if (p.active && !p.realizada) return false;
+    }
+    return true;
+}
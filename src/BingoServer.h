@@ -2,12 +2,17 @@
 #define BINGOSERVER_H
 
 #include <QObject>
-#include <QWebSocketServer>
-#include <QWebSocket>
+#include "BingoIoPool.h"
+#include "BingoGameActors.h"
 #include <QList>
 #include <QJsonObject>
 #include <QJsonDocument>
 #include <QJsonArray>
+#include <QTimer>
+#include <QHash>
+#include <QSet>
+#include <QQueue>
+#include <QSharedPointer>
 #include "BingoGameEngine.h"
 #include "BingoDatabaseManager.h"
 
@@ -16,6 +21,7 @@ struct ClientSession {
     int chaveId;
     QString accessKey;
     bool isOperator; // Se acessou com a chave de gerenciamento
+    bool binary = false; // Protocolo negociado no login: CBOR em frames binários (false = JSON texto)
 };
 
 class BingoServer : public QObject
@@ -27,37 +33,194 @@ public:
 
     bool start();
 
+    // Threads usadas por cada motor para avaliar as bolas (1 = single-thread, 0 = todos os núcleos)
+    void setEngineThreads(int threads) { m_engineThreads = threads; }
+
+    // Pasta dos snapshots dos motores (vazio = desativado) e intervalo da gravação periódica
+    void setSnapshotDir(const QString &dir) { m_snapshotDir = dir; }
+    void setSnapshotInterval(int seconds);
+
+    // Janela de agrupamento (group commit) da fila de gravação do banco
+    void setDbBatchWindow(int ms) { m_db->setJanelaGravacao(ms); }
+
+    // Grava o snapshot de todos os sorteios carregados (chamado também no encerramento)
+    void saveAllSnapshots();
+
+    // Montagem do motor a partir das rodadas do banco (usada também pela auditoria offline)
+    static QHash<int, QString> basePathsFromRodadas(const QJsonArray &rodadas); // base -> caminho_dados
+    static QList<Prize> prizesFromRodadas(const QJsonArray &rodadas, const QHash<int, TicketBaseHandle> &bases);
+
+    // Threads de I/O dos WebSockets (0 = metade dos núcleos); vale se chamado antes de start()
+    void setIoThreads(int threads) { m_io->setThreadCount(threads); }
+
+    // Orçamento de envio por cliente (KB na fila do socket) antes de ser tratado como lento
+    void setClientSendBudget(int kb) { m_io->setSendBudget(qint64(kb) * 1024); }
+
+    // Threads dos sorteios (0 = todos os núcleos); vale se chamado antes do primeiro jogo
+    void setGameThreads(int threads) { m_actors->setThreadCount(threads); }
+
 private Q_SLOTS:
-    void onNewConnection();
-    void processTextMessage(QString message);
-    void socketDisconnected();
+    void onClientConnected(ClientId client, const QString &peer);
+    void onClientDisconnected(ClientId client);
+    void onClientNeedsResync(ClientId client);
+    void handleJsonMessage(ClientId client, const QJsonObject &json);
 
 private:
     struct GameInstance {
         BingoGameEngine *engine;
         int modeloId;
+        QByteArray configHash;  // Rodadas, prêmios e bases usados na montagem do motor
+        uint savedStateHash = 0; // Estado do último snapshot gravado (evita regravar sem mudança)
+    };
+
+    // O que os clientes de um sorteio já receberam (só IDs e contagens): base para os deltas
+    struct PublishedState {
+        struct PrizeView {
+            bool realizada = false;
+            QList<int> winners;    // Prévia (primeiros ganhadores); o resto via get_prize_tickets
+            int winnersTotal = 0;
+            QList<int> nearWinners;
+            QJsonObject nearCounts;
+        };
+        quint64 seq = 0;           // Último número de sequência enviado no sorteio
+        QList<int> drawn;
+        int totalRegistered = 0;
+        QList<int> winners;        // Ganhadores globais (cheia), só a prévia
+        int winnersTotal = 0;
+        QList<int> nearWins;       // "Falta 1" da cheia da vez
+        QJsonObject nearCounts;    // Histograma do prêmio da vez
+        bool finished = false;
+        QHash<int, PrizeView> prizes;
     };
 
-    void sendJson(QWebSocket *client, const QJsonObject &json);
+    // Métricas do fan-out por sorteio (acumuladas desde o início do servidor)
+    struct BroadcastStats {
+        qint64 messages = 0;  // Broadcasts feitos
+        qint64 frames = 0;    // Envios (mensagens x clientes)
+        qint64 bytes = 0;
+        qint64 totalNs = 0;
+        qint64 maxNs = 0;
+    };
+
+    // Mensagem serializada sob demanda e guardada, uma vez por protocolo
+    struct EncodedMessage {
+        QJsonObject json;
+        QString text;
+        QByteArray cbor;
+        const QString &asText();
+        const QByteArray &asCbor();
+    };
+
+    // sync_status memorizado por sorteio: vale enquanto o motor, a versão do estado dele e o seq
+    // publicado não mudarem (logins em massa e get_sync reaproveitam o mesmo buffer)
+    struct StatusCache {
+        const BingoGameEngine *engine = nullptr;
+        quint64 version = 0;
+        quint64 seq = 0;
+        EncodedMessage sync;
+    };
+
+    void sendJson(ClientId client, const QJsonObject &json);
+    void sendMessage(ClientId client, EncodedMessage &message);
+    static QByteArray encodeCbor(const QJsonObject &json);
+    // Caixa de mensagens do sorteio: enquanto um trabalho do motor está na thread do sorteio,
+    // as mensagens seguintes dele esperam aqui na ordem de chegada e o motor não é tocado pela
+    // thread principal. Os outros sorteios continuam sendo atendidos normalmente.
+    struct Mailbox {
+        bool busy = false;
+        QQueue<QPair<ClientId, QJsonObject>> pending;
+        QQueue<BingoGameActors::Task> internal; // Trabalho do próprio servidor (ex: venda desfeita), antes das mensagens
+        QJsonObject loading; // Último progresso da carga do motor (vazio = não está carregando)
+    };
+
+    bool isBusy(int sorteioId) const { return m_mailboxes.value(sorteioId).busy; }
+    bool deferIfBusy(int sorteioId, ClientId client, const QJsonObject &json);
+    // Roda 'work' na thread do sorteio e 'done' aqui; depois atende as mensagens que esperaram
+    void runOnActor(int sorteioId, BingoGameActors::Task work, BingoGameActors::Task done);
+    void drainMailbox(int sorteioId);
+    // Roda 'task' na thread principal assim que o motor do sorteio estiver livre (na hora, se já estiver)
+    void whenIdle(int sorteioId, BingoGameActors::Task task);
+
+    // Venda aceita que o banco não gravou: a cartela sai do motor (na thread do sorteio) e os
+    // clientes recebem a contagem corrigida. 'operador' recebe o aviso (lote = um aviso no fim).
+    struct VendaEmLote {
+        ClientId operador = 0;
+        int sorteioId = 0;
+        QString origem;
+        int pendentes = 0;
+        QList<int> falhas;
+    };
+    void desfazerVenda(int sorteioId, int ticketId);
+    BingoDatabaseManager::Concluido concluirVendaEmLote(const QSharedPointer<VendaEmLote> &lote, int ticketId);
+
     void broadcastToGame(int sorteioId, const QJsonObject &json);
-    void handleJsonMessage(QWebSocket *client, const QJsonObject &json);
+    void broadcastMessage(int sorteioId, EncodedMessage &message);
+    // Sessão e inscrição no sorteio andam juntas: o broadcast percorre só os inscritos
+    void setSession(ClientId client, const ClientSession &session);
+    void removeSession(ClientId client);
     QJsonObject getTicketDetailsJson(int sorteioId, int ticketId, int baseId = -1);
+    QJsonObject getPrizeWinnerJson(int sorteioId, const Prize &prize, int ticketId);
     QJsonObject getGameStatusJson(int sorteioId);
+
+    // Protocolo de atualização: cada mudança do jogo vai como game_delta com o número de
+    // sequência do sorteio; o sync_status completo fica para login, pedido de snapshot
+    // (get_sync, quando o cliente detecta um buraco na sequência) e mudanças de configuração.
+    PublishedState captureState(BingoGameEngine *engine) const;
+    void publishDelta(int sorteioId, const QString &event, const QJsonObject &extra = QJsonObject(), bool resync = false);
+    EncodedMessage &syncStatus(int sorteioId, bool broadcast);
+    // Rodadas/configuração mudaram no banco sem passar pelo motor
+    void invalidateStatusCache(int sorteioId) { m_statusCache.remove(sorteioId); }
+    static bool isGameFinished(BingoGameEngine *engine);
+    static QJsonObject nearCountsJson(const QMap<int, int> &counts);
+    static QJsonObject turnNearCountsJson(BingoGameEngine *engine);
     
-    // Inicializa ou retorna um motor para um sorteio específico
+    // Dados do banco para montar o motor, lidos na thread principal (dona da conexão)
+    struct EngineLoadInput {
+        QJsonArray rodadas;
+        QList<QPair<int, int>> vendas; // (id, cartela) na ordem de gravação
+        QList<QPair<int, int>> bolas;  // (id, número) na ordem do sorteio
+    };
+
+    // Motor já carregado do sorteio (nullptr se não estiver na memória)
     BingoGameEngine* getEngine(int sorteioId);
+    // Carga em segundo plano na thread do sorteio, com progresso ("loading") para os clientes.
+    // Enquanto carrega a caixa do sorteio fica ocupada: as mensagens esperam e nenhuma outra
+    // carga começa. 'loaded' roda aqui depois que o motor entrou em m_gameInstances.
+    // Retorna false se o sorteio não existe.
+    bool loadEngine(int sorteioId, BingoGameActors::Task loaded = BingoGameActors::Task());
+    void buildEngine(int sorteioId, GameInstance &inst, const EngineLoadInput &input); // Thread do sorteio
+    // Descarta o motor do sorteio (para recarregar) e solta a thread dele; só com a caixa livre
+    void dropEngine(int sorteioId);
+    void publishLoading(int sorteioId, const QString &stage, int done, int total);
+    // Mensagem que precisa do motor: dispara a carga se preciso e guarda a mensagem até ela terminar
+    bool deferUntilLoaded(int sorteioId, ClientId client, const QJsonObject &json);
+
+    // Snapshot do motor: grava com a marca d'água do banco e, na carga, reaplica só o que veio depois
+    static QByteArray configHash(const QJsonArray &rodadas, const QHash<int, TicketBaseHandle> &bases);
+    QString snapshotPath(int sorteioId) const;
+    bool saveSnapshot(int sorteioId, GameInstance &inst);
+    bool restoreSnapshot(int sorteioId, GameInstance &inst, const QHash<int, bool> &premiosRealizados,
+                         const EngineLoadInput &input) const;
 
-    QWebSocketServer *m_pWebSocketServer;
-    QList<QWebSocket *> m_clients;
-    QMap<QWebSocket *, ClientSession> m_sessions;
+    BingoIoPool *m_io;
+    BingoGameActors *m_actors;
+    QHash<int, Mailbox> m_mailboxes;
+    QHash<ClientId, QString> m_peers;            // Conexões abertas -> endereço (para os logs)
+    QHash<ClientId, ClientSession> m_sessions;
+    QHash<int, QSet<ClientId>> m_subscribers;    // Sorteio -> conexões logadas nele
+    QHash<int, BroadcastStats> m_broadcastStats;
     quint16 m_port;
     
-    QMap<QString, QVector<BingoTicket>> m_ticketCache;
     QMap<int, GameInstance> m_gameInstances;
+    QHash<int, PublishedState> m_published; // Por sorteio; sobrevive à recarga do motor
+    QHash<int, StatusCache> m_statusCache;
     BingoDatabaseManager *m_db;
     
     QString m_masterToken;
     int m_historyLimit;
+    int m_engineThreads;
+    QString m_snapshotDir;
+    QTimer *m_snapshotTimer;
 };
 
 #endif // BINGOSERVER_H
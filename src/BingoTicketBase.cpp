@@ -0,0 +1,470 @@
+#include "BingoTicketBase.h"
+#include <QFile>
+#include <QSaveFile>
+#include <QDebug>
+#include <cstring>
+
+namespace {
+
+// Layout do .bbase (little-endian, seções alinhadas em 8 bytes):
+//   Header (64 bytes) | Tabela de grades (gridCount x 32 bytes) | IDs (qint32 x N) |
+//   Dígitos (qint8 x N) | Células de cada grade (N x células) | Índice invertido opcional
+//   por grade (quint32[129] de offsets + quint32 (linha << 8 | célula) por ocorrência)
+// O checksum cobre tudo depois do header. A carga confere header, tamanhos, offsets, IDs e
+// os limites de cada ocorrência; o checksum é conferido na compilação e por --verify-base
+// (TicketBase::verifyFile).
+const char BBASE_MAGIC[8] = { 'B', 'I', 'N', 'G', 'O', 'B', 'A', 'S' };
+const quint32 BBASE_VERSION = 2; // 2: índice com (linha << 8 | célula)
+const quint32 BBASE_FLAG_BALL_INDEX = 0x1;
+const quint32 BBASE_FLAG_SEQUENTIAL = 0x2;
+const quint32 BBASE_FLAG_CONTENT_HASH = 0x4; // header.contentHash preenchido (compilados antes não têm)
+const int BBASE_HEADER_SIZE = 64;
+const int BBASE_GRID_ENTRY_SIZE = 32;
+const int BALL_SLOTS = 128;
+
+struct FileHeader {
+    char magic[8];
+    quint32 version;
+    quint32 flags;
+    quint32 ticketCount;
+    quint32 gridCount;
+    quint64 payloadBytes;
+    quint64 checksum;
+    quint64 contentHash; // TicketBase::contentHash() da base compilada
+    char reserved[16];
+};
+static_assert(sizeof(FileHeader) == BBASE_HEADER_SIZE, "header do .bbase deve ter 64 bytes");
+
+struct GridEntry {
+    quint32 cellCount;
+    quint32 reserved;
+    quint64 cellsOffset;
+    quint64 indexOffset; // 0 = sem índice
+    quint64 indexBytes;
+};
+static_assert(sizeof(GridEntry) == BBASE_GRID_ENTRY_SIZE, "entrada de grade do .bbase deve ter 32 bytes");
+
+inline quint64 align8(quint64 v) { return (v + 7) & ~quint64(7); }
+
+// FNV-1a em palavras de 8 bytes
+quint64 checksum64(const char *data, quint64 size)
+{
+    quint64 h = 1469598103934665603ULL;
+    const quint64 prime = 1099511628211ULL;
+    quint64 i = 0;
+    for (; i + 8 <= size; i += 8) {
+        quint64 word;
+        std::memcpy(&word, data + i, 8);
+        h = (h ^ word) * prime;
+    }
+    for (; i < size; ++i) h = (h ^ quint8(data[i])) * prime;
+    return h;
+}
+
+void setError(QString *error, const QString &message)
+{
+    if (error) *error = message;
+}
+
+} // namespace
+
+QVector<int> TicketBase::GridView::toVector() const
+{
+    QVector<int> numbers;
+    numbers.reserve(size);
+    for (int i = 0; i < size; ++i) numbers.append(cells[i]);
+    return numbers;
+}
+
+TicketBase TicketBase::fromTickets(const QVector<BingoTicket> &tickets)
+{
+    TicketBase base;
+    base.reserve(tickets.size());
+    for (const auto &t : tickets) base.append(t.id, t.checkDigit, t.grids);
+    base.squeeze();
+    return base;
+}
+
+void TicketBase::reserve(int tickets)
+{
+    m_ids.reserve(tickets * int(sizeof(qint32)));
+    m_checkDigits.reserve(tickets);
+    for (int g = 0; g < m_cells.size(); ++g) m_cells[g].reserve(tickets * m_cellCounts[g]);
+}
+
+void TicketBase::append(int ticketId, int checkDigit, const QVector<QVector<int>> &grids)
+{
+    if (m_count == 0 && m_cellCounts.isEmpty()) {
+        const int expected = m_checkDigits.capacity();
+        for (const auto &grid : grids) {
+            m_cellCounts.append(grid.size());
+            m_cells.append(QByteArray());
+            m_cells.last().reserve(expected * grid.size());
+        }
+    }
+
+    const int row = m_count;
+    if (m_sequential && ticketId != row + 1) {
+        // Saiu da numeração 1..N: passa a usar o índice por ID
+        m_sequential = false;
+        for (int r = 0; r < row; ++r) m_rowById.insert(ids()[r], r);
+    }
+    if (!m_sequential && !m_rowById.contains(ticketId)) m_rowById.insert(ticketId, row);
+
+    const qint32 id = ticketId;
+    m_ids.append(reinterpret_cast<const char *>(&id), sizeof(id));
+    m_checkDigits.append(char(qint8(checkDigit)));
+
+    // Grades faltando ou menores que as da primeira cartela ficam com 0 (bola inexistente)
+    for (int g = 0; g < m_cellCounts.size(); ++g) {
+        const int cells = m_cellCounts[g];
+        QByteArray &column = m_cells[g];
+        const QVector<int> *grid = (g < grids.size()) ? &grids[g] : nullptr;
+        for (int c = 0; c < cells; ++c) {
+            const int n = (grid && c < grid->size()) ? grid->at(c) : 0;
+            column.append(char((n > 0 && n < 256) ? quint8(n) : quint8(0)));
+        }
+    }
+    m_count++;
+    m_ballIndex.clear();
+    m_storedHash = 0;
+}
+
+void TicketBase::squeeze()
+{
+    m_ids.squeeze();
+    m_checkDigits.squeeze();
+    for (auto &column : m_cells) column.squeeze();
+}
+
+void TicketBase::allocate(int tickets, const QVector<int> &cellCounts)
+{
+    *this = TicketBase();
+    m_count = tickets;
+    m_cellCounts = cellCounts;
+    m_ids.resize(tickets * int(sizeof(qint32)));
+    m_checkDigits.resize(tickets);
+    for (int cells : cellCounts) m_cells.append(QByteArray(tickets * cells, '\0'));
+}
+
+void TicketBase::finishAllocated(int tickets)
+{
+    m_count = qBound(0, tickets, m_count);
+    m_ids.resize(m_count * int(sizeof(qint32)));
+    m_checkDigits.resize(m_count);
+    for (int g = 0; g < m_cells.size(); ++g) m_cells[g].resize(m_count * m_cellCounts[g]);
+    m_ballIndex.clear();
+    m_storedHash = 0;
+    rebuildRowIndex();
+}
+
+int TicketBase::cellCount(int gridIndex) const
+{
+    if (gridIndex < 0 || gridIndex >= m_cellCounts.size()) return 0;
+    return m_cellCounts[gridIndex];
+}
+
+TicketBase::GridView TicketBase::grid(int row, int gridIndex) const
+{
+    GridView view;
+    if (row < 0 || row >= m_count || gridIndex < 0 || gridIndex >= m_cells.size()) return view;
+    view.size = m_cellCounts[gridIndex];
+    view.cells = reinterpret_cast<const quint8 *>(m_cells[gridIndex].constData()) + size_t(row) * view.size;
+    return view;
+}
+
+int TicketBase::rowOf(int ticketId) const
+{
+    if (m_sequential) {
+        const int row = ticketId - 1;
+        return (row >= 0 && row < m_count) ? row : -1;
+    }
+    return m_rowById.value(ticketId, -1);
+}
+
+void TicketBase::rebuildRowIndex()
+{
+    m_rowById.clear();
+    m_sequential = true;
+    for (int r = 0; r < m_count; ++r) {
+        if (ids()[r] != r + 1) { m_sequential = false; break; }
+    }
+    if (m_sequential) return;
+    m_rowById.reserve(m_count);
+    for (int r = 0; r < m_count; ++r) {
+        if (!m_rowById.contains(ids()[r])) m_rowById.insert(ids()[r], r);
+    }
+}
+
+void TicketBase::buildBallIndex()
+{
+    m_ballIndex.clear();
+    if (m_count >= (1 << 24)) {
+        qWarning() << "TicketBase: base grande demais para o índice invertido:" << m_count << "cartelas";
+        return;
+    }
+    m_ballIndex.resize(m_cells.size());
+    for (int g = 0; g < m_cells.size(); ++g) {
+        const int cells = qMin(m_cellCounts[g], 256);
+        const int stride = m_cellCounts[g];
+        const quint8 *data = reinterpret_cast<const quint8 *>(m_cells[g].constData());
+
+        // Contagem por bola e depois preenchimento (CSR); percorrer as linhas em ordem
+        // deixa cada bola já ordenada por linha
+        QVector<quint32> fill(BALL_SLOTS + 1, 0);
+        for (int r = 0; r < m_count; ++r) {
+            const quint8 *grid = data + size_t(r) * stride;
+            for (int c = 0; c < cells; ++c) {
+                if (grid[c] > 0 && grid[c] < BALL_SLOTS) fill[grid[c] + 1]++;
+            }
+        }
+        for (int b = 1; b <= BALL_SLOTS; ++b) fill[b] += fill[b - 1];
+
+        BallIndex &index = m_ballIndex[g];
+        index.offsets = QByteArray(reinterpret_cast<const char *>(fill.constData()), (BALL_SLOTS + 1) * int(sizeof(quint32)));
+        index.postings.resize(int(fill[BALL_SLOTS]) * int(sizeof(quint32)));
+        quint32 *postings = reinterpret_cast<quint32 *>(index.postings.data());
+        for (int r = 0; r < m_count; ++r) {
+            const quint8 *grid = data + size_t(r) * stride;
+            for (int c = 0; c < cells; ++c) {
+                const int b = grid[c];
+                if (b > 0 && b < BALL_SLOTS) postings[fill[b]++] = (quint32(r) << 8) | quint32(c);
+            }
+        }
+    }
+}
+
+TicketBase::PostingList TicketBase::postingsWithBall(int gridIndex, int ball) const
+{
+    PostingList list;
+    if (gridIndex < 0 || gridIndex >= m_ballIndex.size() || ball <= 0 || ball >= BALL_SLOTS) return list;
+    const BallIndex &index = m_ballIndex[gridIndex];
+    if (index.offsets.isEmpty()) return list;
+    const quint32 *offsets = reinterpret_cast<const quint32 *>(index.offsets.constData());
+    list.postings = reinterpret_cast<const quint32 *>(index.postings.constData()) + offsets[ball];
+    list.count = int(offsets[ball + 1] - offsets[ball]);
+    return list;
+}
+
+qint64 TicketBase::memoryBytes() const
+{
+    if (isMapped()) return m_rowById.size() * qint64(2 * sizeof(int));
+    qint64 bytes = m_ids.size() + m_checkDigits.size();
+    for (const auto &column : m_cells) bytes += column.size();
+    for (const auto &index : m_ballIndex) bytes += index.offsets.size() + index.postings.size();
+    bytes += qint64(m_rowById.size()) * 2 * sizeof(int);
+    return bytes;
+}
+
+quint64 TicketBase::contentHash() const
+{
+    if (m_storedHash) return m_storedHash; // .bbase: gravado na compilação
+    quint64 h = checksum64(m_ids.constData(), quint64(m_ids.size()));
+    h ^= checksum64(m_checkDigits.constData(), quint64(m_checkDigits.size())) * 31;
+    for (int g = 0; g < m_cells.size(); ++g) {
+        h = (h ^ quint64(m_cellCounts[g])) * 1099511628211ULL;
+        h ^= checksum64(m_cells[g].constData(), quint64(m_cells[g].size())) + quint64(g);
+    }
+    return h;
+}
+
+bool TicketBase::writeFile(const QString &filePath, bool withBallIndex, QString *error) const
+{
+#if Q_BYTE_ORDER != Q_LITTLE_ENDIAN
+    setError(error, "Formato .bbase suportado apenas em little-endian");
+    return false;
+#endif
+    TicketBase indexed = *this;
+    if (withBallIndex && !indexed.hasBallIndex()) indexed.buildBallIndex();
+
+    // Monta a tabela de grades e calcula os offsets de cada seção
+    const int grids = m_cellCounts.size();
+    quint64 offset = BBASE_HEADER_SIZE + quint64(grids) * BBASE_GRID_ENTRY_SIZE;
+    const quint64 idsOffset = align8(offset);
+    const quint64 digitsOffset = align8(idsOffset + quint64(m_count) * sizeof(qint32));
+    offset = align8(digitsOffset + quint64(m_count));
+
+    QVector<GridEntry> entries(grids);
+    for (int g = 0; g < grids; ++g) {
+        GridEntry &e = entries[g];
+        std::memset(&e, 0, sizeof(e));
+        e.cellCount = quint32(m_cellCounts[g]);
+        e.cellsOffset = offset;
+        offset = align8(offset + quint64(m_count) * quint64(m_cellCounts[g]));
+    }
+    if (withBallIndex) {
+        for (int g = 0; g < grids; ++g) {
+            const BallIndex &index = indexed.m_ballIndex[g];
+            entries[g].indexOffset = offset;
+            entries[g].indexBytes = quint64(index.offsets.size() + index.postings.size());
+            offset = align8(offset + entries[g].indexBytes);
+        }
+    }
+
+    QByteArray payload(int(offset - BBASE_HEADER_SIZE), '\0');
+    auto put = [&payload](quint64 at, const void *data, quint64 bytes) {
+        if (bytes) std::memcpy(payload.data() + (at - BBASE_HEADER_SIZE), data, bytes);
+    };
+    for (int g = 0; g < grids; ++g) {
+        put(BBASE_HEADER_SIZE + quint64(g) * BBASE_GRID_ENTRY_SIZE, &entries[g], sizeof(GridEntry));
+        put(entries[g].cellsOffset, m_cells[g].constData(), quint64(m_cells[g].size()));
+        if (withBallIndex) {
+            const BallIndex &index = indexed.m_ballIndex[g];
+            put(entries[g].indexOffset, index.offsets.constData(), quint64(index.offsets.size()));
+            put(entries[g].indexOffset + quint64(index.offsets.size()), index.postings.constData(), quint64(index.postings.size()));
+        }
+    }
+    put(idsOffset, m_ids.constData(), quint64(m_ids.size()));
+    put(digitsOffset, m_checkDigits.constData(), quint64(m_checkDigits.size()));
+
+    FileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, BBASE_MAGIC, sizeof(header.magic));
+    header.version = BBASE_VERSION;
+    header.flags = (withBallIndex ? BBASE_FLAG_BALL_INDEX : 0) | (m_sequential ? BBASE_FLAG_SEQUENTIAL : 0)
+                 | BBASE_FLAG_CONTENT_HASH;
+    header.ticketCount = quint32(m_count);
+    header.gridCount = quint32(grids);
+    header.payloadBytes = quint64(payload.size());
+    header.checksum = checksum64(payload.constData(), quint64(payload.size()));
+    header.contentHash = contentHash();
+
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        setError(error, "Não foi possível criar " + filePath + ": " + file.errorString());
+        return false;
+    }
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(payload);
+    if (!file.commit()) {
+        setError(error, "Falha ao gravar " + filePath + ": " + file.errorString());
+        return false;
+    }
+    return true;
+}
+
+TicketBase TicketBase::mapFile(const QString &filePath, QString *error)
+{
+    TicketBase base;
+#if Q_BYTE_ORDER != Q_LITTLE_ENDIAN
+    setError(error, "Formato .bbase suportado apenas em little-endian");
+    return base;
+#endif
+    QSharedPointer<QFile> file(new QFile(filePath));
+    if (!file->open(QIODevice::ReadOnly)) {
+        setError(error, "Não foi possível abrir " + filePath + ": " + file->errorString());
+        return base;
+    }
+    const qint64 fileSize = file->size();
+    if (fileSize < BBASE_HEADER_SIZE) {
+        setError(error, filePath + " não é um arquivo .bbase (muito pequeno)");
+        return base;
+    }
+    const uchar *map = file->map(0, fileSize);
+    if (!map) {
+        setError(error, "Falha ao mapear " + filePath + ": " + file->errorString());
+        return base;
+    }
+    const char *data = reinterpret_cast<const char *>(map);
+
+    FileHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, BBASE_MAGIC, sizeof(header.magic)) != 0) {
+        setError(error, filePath + " não é um arquivo .bbase");
+        return base;
+    }
+    if (header.version != BBASE_VERSION) {
+        setError(error, QString("%1: versão %2 não suportada (esperada %3)").arg(filePath).arg(header.version).arg(BBASE_VERSION));
+        return base;
+    }
+    if (quint64(fileSize) != BBASE_HEADER_SIZE + header.payloadBytes) {
+        setError(error, filePath + ": tamanho não confere com o header (arquivo truncado?)");
+        return base;
+    }
+    const quint64 count = header.ticketCount;
+    const quint64 grids = header.gridCount;
+    const quint64 idsOffset = align8(BBASE_HEADER_SIZE + grids * BBASE_GRID_ENTRY_SIZE);
+    const quint64 digitsOffset = align8(idsOffset + count * sizeof(qint32));
+    if (digitsOffset + count > quint64(fileSize)) {
+        setError(error, filePath + ": seções fora do arquivo");
+        return base;
+    }
+
+    base.m_count = int(count);
+    base.m_ids = QByteArray::fromRawData(data + idsOffset, int(count * sizeof(qint32)));
+    base.m_checkDigits = QByteArray::fromRawData(data + digitsOffset, int(count));
+    for (quint64 g = 0; g < grids; ++g) {
+        GridEntry e;
+        std::memcpy(&e, data + BBASE_HEADER_SIZE + g * BBASE_GRID_ENTRY_SIZE, sizeof(e));
+        const quint64 bytes = count * e.cellCount;
+        if (e.cellCount > 255 || e.cellsOffset < digitsOffset + count || e.cellsOffset + bytes > quint64(fileSize)
+            || e.indexOffset + e.indexBytes > quint64(fileSize)) {
+            setError(error, filePath + ": seções fora do arquivo");
+            return TicketBase();
+        }
+        base.m_cellCounts.append(int(e.cellCount));
+        base.m_cells.append(QByteArray::fromRawData(data + e.cellsOffset, int(bytes)));
+
+        if ((header.flags & BBASE_FLAG_BALL_INDEX) && e.indexOffset) {
+            BallIndex index;
+            const int offsetsBytes = (BALL_SLOTS + 1) * int(sizeof(quint32));
+            // O motor fatia as ocorrências pela tabela de offsets e usa linha/célula de cada uma
+            // como índice sem checar limites: confere as duas a cada carga (só comparações,
+            // bem mais barato que o checksum, que fica com verifyFile())
+            const quint64 postingCount = e.indexBytes >= quint64(offsetsBytes) ? (e.indexBytes - offsetsBytes) / sizeof(quint32) : 0;
+            bool offsetsOk = e.indexBytes >= quint64(offsetsBytes) && e.indexOffset % sizeof(quint32) == 0;
+            const quint32 *offsets = reinterpret_cast<const quint32 *>(data + e.indexOffset);
+            for (int b = 0; offsetsOk && b < BALL_SLOTS; ++b) offsetsOk = offsets[b] <= offsets[b + 1];
+            offsetsOk = offsetsOk && offsets[0] == 0 && offsets[BALL_SLOTS] == postingCount;
+            const quint32 *postings = offsets + BALL_SLOTS + 1;
+            for (quint64 i = 0; offsetsOk && i < postingCount; ++i) {
+                offsetsOk = quint64(PostingList::row(postings[i])) < count
+                         && quint32(PostingList::cell(postings[i])) < e.cellCount;
+            }
+            if (!offsetsOk) {
+                setError(error, filePath + ": índice invertido inconsistente");
+                return TicketBase();
+            }
+            index.offsets = QByteArray::fromRawData(data + e.indexOffset, offsetsBytes);
+            index.postings = QByteArray::fromRawData(data + e.indexOffset + offsetsBytes, int(e.indexBytes) - offsetsBytes);
+            base.m_ballIndex.append(index);
+        }
+    }
+    if (base.m_ballIndex.size() != base.m_cells.size()) base.m_ballIndex.clear();
+
+    base.m_mapping = file;
+    if (header.flags & BBASE_FLAG_CONTENT_HASH) base.m_storedHash = header.contentHash;
+    // A flag BBASE_FLAG_SEQUENTIAL é só uma dica: rowOf() resolve por posição, então a
+    // numeração 1..N é conferida nos próprios IDs (uma passada; o índice só é montado se falhar)
+    base.rebuildRowIndex();
+    return base;
+}
+
+bool TicketBase::verifyFile(const QString &filePath, QString *error)
+{
+    // Valida a estrutura primeiro; o checksum só faz sentido com header e tamanho coerentes
+    QString mapError;
+    if (mapFile(filePath, &mapError).isEmpty()) {
+        setError(error, mapError.isEmpty() ? filePath + ": base vazia" : mapError);
+        return false;
+    }
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        setError(error, "Não foi possível abrir " + filePath + ": " + file.errorString());
+        return false;
+    }
+    const uchar *map = file.map(0, file.size());
+    if (!map) {
+        setError(error, "Falha ao mapear " + filePath + ": " + file.errorString());
+        return false;
+    }
+    const char *data = reinterpret_cast<const char *>(map);
+    FileHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    if (checksum64(data + BBASE_HEADER_SIZE, header.payloadBytes) != header.checksum) {
+        setError(error, filePath + ": checksum inválido");
+        return false;
+    }
+    return true;
+}
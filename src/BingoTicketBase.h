@@ -0,0 +1,126 @@
+#ifndef BINGOTICKETBASE_H
+#define BINGOTICKETBASE_H
+
+#include <QVector>
+#include <QHash>
+#include <QByteArray>
+#include <QSharedPointer>
+#include "BingoTicketParser.h"
+
+class QFile;
+
+// Base de cartelas em formato colunar: cada índice de grade é um único array contíguo
+// de bytes (cartela x células), com IDs e dígitos verificadores em arrays paralelos.
+// Substitui QVector<BingoTicket> (duas alocações por cartela e 4 bytes por número).
+// As cópias são baratas (compartilhamento implícito), então servidor e motores podem
+// guardar a mesma base sem duplicar os dados.
+//
+// A base pode vir do arquivo texto (montada em memória) ou de um .bbase pré-compilado,
+// mapeado somente leitura: os arrays apontam direto para o mapeamento, que é
+// compartilhado via page cache entre processos.
+class TicketBase
+{
+public:
+    // Visão somente leitura de uma grade (válida enquanto a base existir)
+    struct GridView {
+        const quint8 *cells = nullptr;
+        int size = 0;
+
+        int operator[](int i) const { return cells[i]; }
+        bool isEmpty() const { return size == 0; }
+        const quint8 *begin() const { return cells; }
+        const quint8 *end() const { return cells + size; }
+        QVector<int> toVector() const;
+    };
+
+    // Ocorrências de uma bola numa grade, empacotadas como (linha << 8 | célula) e em
+    // ordem crescente de linha (CSR: um único array por grade, fatiado por bola)
+    struct PostingList {
+        const quint32 *postings = nullptr;
+        int count = 0;
+
+        const quint32 *begin() const { return postings; }
+        const quint32 *end() const { return postings + count; }
+        static int row(quint32 posting) { return int(posting >> 8); }
+        static int cell(quint32 posting) { return int(posting & 0xFF); }
+    };
+
+    TicketBase() = default;
+
+    // Conversão a partir do formato antigo (uma cartela por struct)
+    static TicketBase fromTickets(const QVector<BingoTicket> &tickets);
+
+    // Construção incremental: os tamanhos das grades são definidos pela primeira cartela
+    void reserve(int tickets);
+    void append(int ticketId, int checkDigit, const QVector<QVector<int>> &grids);
+    void squeeze();
+
+    // Carga em lote (parser paralelo): aloca as colunas de uma vez e expõe ponteiros
+    // graváveis; cada thread escreve só nas suas linhas. finishAllocated() corta o que
+    // sobrou e refaz o índice por ID.
+    void allocate(int tickets, const QVector<int> &cellCounts);
+    qint32 *idsForWrite() { return reinterpret_cast<qint32 *>(m_ids.data()); }
+    qint8 *checkDigitsForWrite() { return reinterpret_cast<qint8 *>(m_checkDigits.data()); }
+    quint8 *cellsForWrite(int gridIndex) { return reinterpret_cast<quint8 *>(m_cells[gridIndex].data()); }
+    void finishAllocated(int tickets);
+
+    // Formato binário .bbase (versionado, com checksum). mapFile() confere header, tamanhos,
+    // IDs e os limites de cada ocorrência do índice, sem calcular o checksum; verifyFile()
+    // faz a conferência completa do checksum.
+    bool writeFile(const QString &filePath, bool withBallIndex = true, QString *error = nullptr) const;
+    static TicketBase mapFile(const QString &filePath, QString *error = nullptr);
+    static bool verifyFile(const QString &filePath, QString *error = nullptr);
+    bool isMapped() const { return !m_mapping.isNull(); }
+
+    int size() const { return m_count; }
+    bool isEmpty() const { return m_count == 0; }
+    int gridCount() const { return m_cellCounts.size(); }
+    int cellCount(int gridIndex) const;
+
+    int ticketId(int row) const { return ids()[row]; }
+    int checkDigit(int row) const { return reinterpret_cast<const qint8 *>(m_checkDigits.constData())[row]; }
+    GridView grid(int row, int gridIndex) const;
+
+    // Linha da cartela com este ID (-1 se não existe). Bases numeradas 1..N resolvem
+    // por posição; as demais usam um índice por ID.
+    int rowOf(int ticketId) const;
+    bool contains(int ticketId) const { return rowOf(ticketId) >= 0; }
+
+    // Índice invertido bola -> ocorrências (gravado no .bbase ou montado por buildBallIndex()).
+    // Montado uma vez por base e compartilhado por todos os motores que a usam.
+    void buildBallIndex();
+    bool hasBallIndex() const { return !m_ballIndex.isEmpty(); }
+    PostingList postingsWithBall(int gridIndex, int ball) const;
+
+    qint64 memoryBytes() const;
+
+    // Hash do conteúdo (IDs, dígitos e células): bases iguais vindas de arquivos
+    // diferentes resultam no mesmo valor. Bases mapeadas usam o valor gravado no header
+    // do .bbase; só as montadas em memória percorrem o conteúdo.
+    quint64 contentHash() const;
+
+private:
+    struct BallIndex {
+        QByteArray offsets;  // quint32[129]: bola -> início em postings
+        QByteArray postings; // quint32 (linha << 8 | célula) por ocorrência
+    };
+
+    const qint32 *ids() const { return reinterpret_cast<const qint32 *>(m_ids.constData()); }
+    void rebuildRowIndex();
+
+    int m_count = 0;
+    QByteArray m_ids;                 // qint32 por linha
+    QByteArray m_checkDigits;         // qint8 por linha
+    QVector<int> m_cellCounts;        // grade -> células por cartela
+    QVector<QByteArray> m_cells;      // grade -> [linha * células + célula]
+    QVector<BallIndex> m_ballIndex;   // grade -> índice invertido (vazio se não houver)
+    QHash<int, int> m_rowById;        // Só para bases fora da ordem 1..N
+    bool m_sequential = true;
+    quint64 m_storedHash = 0;         // Hash vindo do header do .bbase (0 = calcular)
+    QSharedPointer<QFile> m_mapping;  // Mantém o .bbase mapeado enquanto houver cópias
+};
+
+// Referência compartilhada, somente leitura, a uma base carregada (ver BingoBaseStore)
+typedef QSharedPointer<const TicketBase> TicketBaseHandle;
+
+#endif // BINGOTICKETBASE_H
@@ -1,7 +1,16 @@
 #include "BingoTicketParser.h"
+#include "BingoTicketBase.h"
 #include <QFile>
-#include <QTextStream>
+#include <QFileInfo>
+#include <QDir>
+#include <QDateTime>
 #include <QDebug>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QThreadPool>
+#include <QAtomicInt>
+#include <cstring>
+#include <functional>
 
 BingoTicketParser::BingoTicketParser()
 {
@@ -57,29 +66,311 @@ QVector<int> BingoTicketParser::parseGridString(const QString &gridStr)
 
 QVector<BingoTicket> BingoTicketParser::parseFile(const QString &filePath)
 {
+    // Mesmo parser da base colunar; aqui só remonta uma struct por cartela
+    const TicketBase base = parseBase(filePath);
     QVector<BingoTicket> tickets;
+    tickets.reserve(base.size());
+    for (int row = 0; row < base.size(); ++row) {
+        BingoTicket ticket;
+        ticket.id = base.ticketId(row);
+        ticket.checkDigit = base.checkDigit(row);
+        for (int g = 0; g < base.gridCount(); ++g) ticket.grids.append(base.grid(row, g).toVector());
+        tickets.append(ticket);
+    }
+    return tickets;
+}
+
+namespace {
+
+// Abaixo disso o arquivo é lido numa thread só
+const qint64 PARALLEL_MIN_BYTES = 1 << 20;
+const int MAX_REPORTED_ERRORS = 20;
+
+inline bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+// Remove espaços e o \r do fim (arquivos gerados no Windows)
+inline void trimLine(const char *&begin, const char *&end)
+{
+    while (begin < end && isBlank(*begin)) ++begin;
+    while (end > begin && isBlank(end[-1])) --end;
+}
+
+inline const char *findChar(const char *begin, const char *end, char c)
+{
+    const void *found = std::memchr(begin, c, size_t(end - begin));
+    return found ? static_cast<const char *>(found) : end;
+}
+
+struct ParseChunk {
+    const char *begin = nullptr;
+    const char *end = nullptr;
+    qint64 lines = 0;    // Linhas físicas (para numerar os erros)
+    int tickets = 0;     // Linhas não vazias
+    qint64 firstLine = 0;
+    int firstRow = 0;
+    int parsed = 0;
+    QVector<QPair<qint64, QString>> errors; // (linha, motivo)
+    QVector<int> badRows;
+};
+
+// Geometria da base (células por grade) a partir de uma linha
+bool readGeometry(const char *begin, const char *end, QVector<int> &cellCounts)
+{
+    const char *part = findChar(begin, end, '-');
+    while (part < end) {
+        const char *partBegin = part + 1;
+        part = findChar(partBegin, end, '-');
+        const int length = int(part - partBegin);
+        if (length == 0) continue;
+        if (length % 2 != 0) return false;
+        cellCounts.append(length / 2);
+    }
+    return !cellCounts.isEmpty();
+}
+
+// Lê uma linha "IIIIIID-NNNN...-NNNN..." direto para as colunas da base.
+// Devolve o motivo quando a linha está malformada (QString só no caminho de erro).
+QString parseTicketLine(const char *p, const char *end, const QVector<int> &cellCounts,
+                        qint32 *id, qint8 *checkDigit, quint8 *const *gridRows)
+{
+    const char *idEnd = findChar(p, end, '-');
+    const int idLength = int(idEnd - p);
+    if (idLength < 2) return "identificador ausente";
+    if (idLength > 10) return "identificador longo demais";
+    qint64 value = 0;
+    for (const char *c = p; c < idEnd; ++c) {
+        const unsigned digit = unsigned(*c - '0');
+        if (digit > 9) return QString("caractere inválido '%1' no identificador").arg(QChar(*c));
+        if (c + 1 < idEnd) value = value * 10 + digit;
+        else *checkDigit = qint8(digit);
+    }
+    if (value > 0x7fffffff) return "identificador fora do intervalo";
+    *id = qint32(value);
+
+    int g = 0;
+    for (const char *part = idEnd; part < end; ) {
+        const char *partBegin = part + 1;
+        part = findChar(partBegin, end, '-');
+        const int length = int(part - partBegin);
+        if (length == 0) continue;
+        if (g >= cellCounts.size()) return QString("mais de %1 grades").arg(cellCounts.size());
+        if (length != cellCounts[g] * 2) {
+            return QString("grade %1 com %2 caracteres (esperado %3)").arg(g + 1).arg(length).arg(cellCounts[g] * 2);
+        }
+        quint8 *out = gridRows[g];
+        for (int i = 0; i < length; i += 2) {
+            const unsigned d0 = unsigned(partBegin[i] - '0');
+            const unsigned d1 = unsigned(partBegin[i + 1] - '0');
+            if (d0 > 9 || d1 > 9) return QString("número inválido na grade %1").arg(g + 1);
+            out[i / 2] = quint8(d0 * 10 + d1);
+        }
+        ++g;
+    }
+    if (g != cellCounts.size()) return QString("%1 grades (esperado %2)").arg(g).arg(cellCounts.size());
+    return QString();
+}
+
+void countChunk(ParseChunk &chunk)
+{
+    for (const char *line = chunk.begin; line < chunk.end; ) {
+        const char *lineEnd = findChar(line, chunk.end, '\n');
+        const char *b = line, *e = lineEnd;
+        trimLine(b, e);
+        if (b < e) chunk.tickets++;
+        chunk.lines++;
+        line = lineEnd + 1;
+    }
+}
+
+void parseChunk(ParseChunk &chunk, TicketBase &base, const QVector<int> &cellCounts)
+{
+    qint32 *ids = base.idsForWrite();
+    qint8 *digits = base.checkDigitsForWrite();
+    QVector<quint8 *> columns;
+    for (int g = 0; g < cellCounts.size(); ++g) columns.append(base.cellsForWrite(g));
+    QVector<quint8 *> gridRows(cellCounts.size());
+
+    int row = chunk.firstRow;
+    qint64 lineNumber = chunk.firstLine;
+    for (const char *line = chunk.begin; line < chunk.end; ++lineNumber) {
+        const char *lineEnd = findChar(line, chunk.end, '\n');
+        const char *b = line, *e = lineEnd;
+        line = lineEnd + 1;
+        trimLine(b, e);
+        if (b == e) continue;
+
+        for (int g = 0; g < cellCounts.size(); ++g) gridRows[g] = columns[g] + size_t(row) * cellCounts[g];
+        const QString error = parseTicketLine(b, e, cellCounts, ids + row, digits + row, gridRows.constData());
+        if (!error.isEmpty()) {
+            chunk.errors.append(qMakePair(lineNumber, error));
+            chunk.badRows.append(row);
+        } else {
+            chunk.parsed++;
+        }
+        row++;
+    }
+}
+
+} // namespace
+
+TicketBase BingoTicketParser::parseBase(const QString &filePath, QStringList *errors)
+{
+    TicketBase base;
     QFile file(filePath);
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+    if (!file.open(QIODevice::ReadOnly)) {
         qWarning() << "Could not open file:" << filePath;
-        return tickets;
+        return base;
+    }
+
+    // Lê direto do mapeamento; sem mmap (ex.: pipe) cai para uma cópia em memória
+    QElapsedTimer timer;
+    timer.start();
+    QByteArray buffer;
+    const qint64 size = file.size();
+    const char *data = size > 0 ? reinterpret_cast<const char *>(file.map(0, size)) : nullptr;
+    if (!data) {
+        buffer = file.readAll();
+        data = buffer.constData();
+    }
+    const char *dataEnd = data + (buffer.isEmpty() ? size : buffer.size());
+    if (dataEnd - data >= 3 && std::memcmp(data, "\xEF\xBB\xBF", 3) == 0) data += 3;
+
+    // Geometria pela primeira linha que se lê por inteiro; as malformadas antes dela são
+    // relatadas como as demais ("linha N: motivo") na leitura abaixo
+    QVector<int> cellCounts;
+    bool hasLines = false;
+    for (const char *line = data; line < dataEnd && cellCounts.isEmpty(); ) {
+        const char *lineEnd = findChar(line, dataEnd, '\n');
+        const char *b = line, *e = lineEnd;
+        line = lineEnd + 1;
+        trimLine(b, e);
+        if (b == e) continue;
+        hasLines = true;
+        if (!readGeometry(b, e, cellCounts)) continue;
+
+        qint32 id;
+        qint8 digit;
+        QVector<QByteArray> cells;
+        QVector<quint8 *> gridRows;
+        for (int count : cellCounts) cells.append(QByteArray(count, '\0'));
+        for (auto &column : cells) gridRows.append(reinterpret_cast<quint8 *>(column.data()));
+        if (!parseTicketLine(b, e, cellCounts, &id, &digit, gridRows.constData()).isEmpty()) cellCounts.clear();
+    }
+    if (cellCounts.isEmpty()) {
+        if (!hasLines) return base;
+        qWarning() << "Base" << filePath << ": nenhuma cartela válida, arquivo ignorado";
+        if (errors) errors->append("Nenhuma cartela válida");
+        return base;
+    }
+
+    // Fatias alinhadas em fim de linha, processadas em paralelo em duas passadas:
+    // contagem (define onde cada fatia escreve) e leitura direto nas colunas
+    const qint64 bytes = dataEnd - data;
+    const int threads = bytes < PARALLEL_MIN_BYTES ? 1 : qMax(1, QThread::idealThreadCount());
+    const int chunkCount = threads == 1 ? 1 : threads * 4;
+    QVector<ParseChunk> chunks;
+    const char *chunkBegin = data;
+    for (int i = 1; i <= chunkCount && chunkBegin < dataEnd; ++i) {
+        const char *chunkEnd = i == chunkCount ? dataEnd : qMax(chunkBegin, data + bytes * i / chunkCount);
+        if (chunkEnd < dataEnd) chunkEnd = qMin(dataEnd, findChar(chunkEnd, dataEnd, '\n') + 1);
+        ParseChunk chunk;
+        chunk.begin = chunkBegin;
+        chunk.end = chunkEnd;
+        chunks.append(chunk);
+        chunkBegin = chunkEnd;
+    }
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+    auto runChunks = [&chunks, &pool, threads](const std::function<void(ParseChunk &)> &fn) {
+        QAtomicInt next(0);
+        auto work = [&chunks, &next, &fn]() {
+            for (int i = next.fetchAndAddRelaxed(1); i < chunks.size(); i = next.fetchAndAddRelaxed(1)) fn(chunks[i]);
+        };
+        const int helpers = qMin(threads, chunks.size()) - 1;
+        for (int t = 0; t < helpers; ++t) pool.start(QRunnable::create(work));
+        work();
+        pool.waitForDone();
+    };
+
+    runChunks(countChunk);
+    int total = 0;
+    qint64 lines = 1;
+    for (auto &chunk : chunks) {
+        chunk.firstRow = total;
+        chunk.firstLine = lines;
+        total += chunk.tickets;
+        lines += chunk.lines;
     }
 
-    // Tenta reservar espaço para evitar realocações lentas
-    tickets.reserve(600000); 
+    base.allocate(total, cellCounts);
+    runChunks([&base, &cellCounts](ParseChunk &chunk) { parseChunk(chunk, base, cellCounts); });
+
+    // Linhas malformadas: relata com o número da linha e remove da base (caso raro, em série)
+    QVector<int> badRows;
+    int reported = 0, errorCount = 0;
+    for (const auto &chunk : chunks) {
+        badRows += chunk.badRows;
+        for (const auto &error : chunk.errors) {
+            const QString message = QString("linha %1: %2").arg(error.first).arg(error.second);
+            if (errors) errors->append(message);
+            if (reported++ < MAX_REPORTED_ERRORS) qWarning() << "Base" << filePath << message;
+        }
+        errorCount += chunk.errors.size();
+    }
+    if (errorCount > MAX_REPORTED_ERRORS) {
+        qWarning() << "Base" << filePath << ":" << errorCount - MAX_REPORTED_ERRORS << "outras linhas malformadas";
+    }
 
-    QTextStream in(&file);
-    int count = 0;
-    while (!in.atEnd()) {
-        QString line = in.readLine();
-        if (!line.trimmed().isEmpty()) {
-            tickets.append(parseLine(line));
-            count++;
-            if (count % 100000 == 0) {
-                qInfo() << "Lendo cartelas..." << count;
+    int kept = total;
+    if (!badRows.isEmpty()) {
+        qint32 *ids = base.idsForWrite();
+        qint8 *digits = base.checkDigitsForWrite();
+        int out = 0, bad = 0;
+        for (int row = 0; row < total; ++row) {
+            if (bad < badRows.size() && badRows[bad] == row) { ++bad; continue; }
+            if (out != row) {
+                ids[out] = ids[row];
+                digits[out] = digits[row];
+                for (int g = 0; g < cellCounts.size(); ++g) {
+                    quint8 *column = base.cellsForWrite(g);
+                    std::memmove(column + size_t(out) * cellCounts[g], column + size_t(row) * cellCounts[g], size_t(cellCounts[g]));
+                }
             }
+            ++out;
         }
+        kept = out;
     }
-    
-    file.close();
-    return tickets;
+    base.finishAllocated(kept);
+
+    qInfo() << "Base" << filePath << ":" << kept << "cartelas," << base.memoryBytes() / 1024 << "KB em"
+            << timer.elapsed() << "ms (" << threads << "threads)";
+    return base;
+}
+
+TicketBase BingoTicketParser::loadBase(const QString &filePath)
+{
+    QFileInfo info(filePath);
+    QString binaryPath;
+    if (info.suffix().compare("bbase", Qt::CaseInsensitive) == 0) {
+        binaryPath = filePath;
+    } else {
+        // Usa o .bbase compilado ao lado do texto, desde que não seja mais antigo que ele
+        QFileInfo compiled(info.dir().filePath(info.completeBaseName() + ".bbase"));
+        if (compiled.exists() && compiled.lastModified() >= info.lastModified()) {
+            binaryPath = compiled.filePath();
+        }
+    }
+
+    if (!binaryPath.isEmpty()) {
+        QString error;
+        TicketBase base = TicketBase::mapFile(binaryPath, &error);
+        if (base.isMapped()) {
+            qInfo() << "Base" << binaryPath << "mapeada:" << base.size() << "cartelas";
+            return base;
+        }
+        qWarning() << "Falha ao carregar" << binaryPath << ":" << error;
+        if (binaryPath == filePath) return TicketBase();
+    }
+    return parseBase(filePath);
 }
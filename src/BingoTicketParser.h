@@ -2,9 +2,12 @@
 #define BINGOTICKETPARSER_H
 
 #include <QString>
+#include <QStringList>
 #include <QList>
 #include <QVector>
 
+class TicketBase;
+
 struct BingoTicket {
     int id;
     int checkDigit;
@@ -24,6 +27,15 @@ public:
     // Reads all lines from a file
     static QVector<BingoTicket> parseFile(const QString &filePath);
 
+    // Reads the whole file straight into the columnar TicketBase: memory-mapped, split into
+    // newline-aligned chunks parsed in parallel, no QStrings on the hot path. Malformed lines
+    // are skipped and reported as "linha N: motivo" (logged and, if given, appended to errors).
+    static TicketBase parseBase(const QString &filePath, QStringList *errors = nullptr);
+
+    // Loads a base for play: maps a .bbase directly, or the precompiled <name>.bbase next to
+    // the text file when it is up to date; otherwise falls back to parseBase()
+    static TicketBase loadBase(const QString &filePath);
+
 private:
     static QVector<int> parseGridString(const QString &gridStr);
 };
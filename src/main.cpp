@@ -3,7 +3,43 @@
 #include <QFileInfo>
 #include "BingoServer.h"
 #include "BingoTicketParser.h"
+#include "BingoBaseStore.h"
 #include "BingoGameEngine.h"
+#include "BingoAuditor.h"
+#include <QSocketNotifier>
+#include <csignal>
+#include <cerrno>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Encerramento pedido pelo sistema (SIGTERM/Ctrl+C): sai do loop para o servidor gravar os snapshots.
+// O handler só escreve um byte no socketpair (write() é async-signal-safe); o quit() roda no loop
+// principal, quando o QSocketNotifier da outra ponta acorda.
+static int g_sinalFd[2] = { -1, -1 };
+
+static void encerrarPorSinal(int)
+{
+    const int savedErrno = errno;
+    const char byte = 1;
+    const ssize_t written = ::write(g_sinalFd[0], &byte, 1); // Falha só com o socket cheio: já há encerramento pendente
+    Q_UNUSED(written);
+    errno = savedErrno;
+}
+
+static bool instalarSinaisDeEncerramento(QCoreApplication &app)
+{
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, g_sinalFd) != 0) return false;
+    QSocketNotifier *notifier = new QSocketNotifier(g_sinalFd[1], QSocketNotifier::Read, &app);
+    QObject::connect(notifier, &QSocketNotifier::activated, &app, [notifier]() {
+        notifier->setEnabled(false);
+        char byte;
+        if (::read(g_sinalFd[1], &byte, 1) > 0) qInfo() << "Sinal de encerramento recebido, finalizando...";
+        QCoreApplication::quit();
+    });
+    std::signal(SIGTERM, encerrarPorSinal);
+    std::signal(SIGINT, encerrarPorSinal);
+    return true;
+}
 
 int main(int argc, char *argv[])
 {
@@ -39,9 +75,179 @@ int main(int argc, char *argv[])
         }
     }
 
+    // Compilação offline de base: texto -> .bbase (carregado via mmap pelo servidor)
+    if (a.arguments().contains("--compile-base")) {
+        int idx = a.arguments().indexOf("--compile-base");
+        if (a.arguments().size() > idx + 2) {
+            QString inPath = a.arguments().at(idx + 1);
+            QString outPath = a.arguments().at(idx + 2);
+            TicketBase base = BingoTicketParser::parseBase(inPath);
+            if (base.isEmpty()) {
+                qCritical() << "Nenhuma cartela lida de" << inPath;
+                return 1;
+            }
+            QString error;
+            // A carga no servidor não relê a base inteira; o checksum é conferido aqui, uma vez
+            if (!base.writeFile(outPath, true, &error) || !TicketBase::verifyFile(outPath, &error)) {
+                qCritical() << error;
+                return 1;
+            }
+            qInfo() << "Base compilada:" << outPath << "-" << base.size() << "cartelas,"
+                    << base.gridCount() << "grades," << QFileInfo(outPath).size() / 1024 << "KB";
+            return 0;
+        } else {
+            qCritical() << "Uso: BingoSysServer --compile-base <base.txt> <saida.bbase>";
+            return 1;
+        }
+    }
+
+    // Conferência completa de um .bbase (checksum de todo o conteúdo)
+    if (a.arguments().contains("--verify-base")) {
+        int idx = a.arguments().indexOf("--verify-base");
+        if (a.arguments().size() > idx + 1) {
+            const QString path = a.arguments().at(idx + 1);
+            QString error;
+            if (!TicketBase::verifyFile(path, &error)) {
+                qCritical() << error;
+                return 2;
+            }
+            qInfo() << "Base íntegra:" << path;
+            return 0;
+        } else {
+            qCritical() << "Uso: BingoSysServer --verify-base <base.bbase>";
+            return 1;
+        }
+    }
+
+    // Auditoria offline: refaz os sorteios pelo banco e compara com PREMIOS.realizada
+    if (a.arguments().contains("--audit-sorteio")) {
+        int idx = a.arguments().indexOf("--audit-sorteio");
+        QList<int> ids;
+        bool ok = a.arguments().size() > idx + 1;
+        if (ok && a.arguments().at(idx + 1) != "all") ids.append(a.arguments().at(idx + 1).toInt(&ok));
+        if (!ok) {
+            qCritical() << "Uso: BingoSysServer --audit-sorteio <id|all> [--audit-threads <n>]";
+            return 1;
+        }
+        BingoDatabaseManager db;
+        if (!db.connectToDatabase("localhost", "bingosys", "bingosys", "bingosys")) {
+            qCritical() << "Falha ao conectar ao banco remoto.";
+            return 1;
+        }
+        BingoAuditor auditor(&db);
+        int threadsIdx = a.arguments().indexOf("--audit-threads");
+        if (threadsIdx >= 0 && a.arguments().size() > threadsIdx + 1) {
+            auditor.setThreads(a.arguments().at(threadsIdx + 1).toInt());
+        }
+        const int divergencias = BingoAuditor::printReport(auditor.run(ids));
+        return divergencias ? 2 : 0;
+    }
+
+    // Autoteste do motor: base fixa em memória contra o avaliador de referência (sem banco)
+    if (a.arguments().contains("--self-test")) {
+        int idx = a.arguments().indexOf("--self-test");
+        int rodadas = 8;
+        if (a.arguments().size() > idx + 1 && !a.arguments().at(idx + 1).startsWith("--")) {
+            bool ok = false;
+            rodadas = a.arguments().at(idx + 1).toInt(&ok);
+            if (!ok || rodadas <= 0) {
+                qCritical() << "Uso: BingoSysServer --self-test [rodadas]";
+                return 1;
+            }
+        }
+        return BingoAuditor::selfTest(rodadas) ? 2 : 0;
+    }
+
     // Inicializa o servidor que agora gerencia DB e Sorteios
     BingoServer server(port);
+
+    // Avaliação paralela das bolas: --engine-threads <n> (0 = todos os núcleos)
+    if (a.arguments().contains("--engine-threads")) {
+        int idx = a.arguments().indexOf("--engine-threads");
+        if (a.arguments().size() > idx + 1) {
+            server.setEngineThreads(a.arguments().at(idx + 1).toInt());
+        } else {
+            qCritical() << "Uso: BingoSysServer <porta> --engine-threads <n>";
+            return 1;
+        }
+    }
     
+    // Orçamento de memória das bases em cache: --base-memory-mb <n> (0 = sem limite)
+    if (a.arguments().contains("--base-memory-mb")) {
+        int idx = a.arguments().indexOf("--base-memory-mb");
+        if (a.arguments().size() > idx + 1) {
+            BingoBaseStore::instance().setMemoryBudget(a.arguments().at(idx + 1).toLongLong() * 1024 * 1024);
+        } else {
+            qCritical() << "Uso: BingoSysServer <porta> --base-memory-mb <n>";
+            return 1;
+        }
+    }
+
+    // Snapshots dos motores: --snapshot-dir <pasta> (vazio desativa) e --snapshot-interval <s>
+    if (a.arguments().contains("--snapshot-dir")) {
+        int idx = a.arguments().indexOf("--snapshot-dir");
+        if (a.arguments().size() > idx + 1) {
+            server.setSnapshotDir(a.arguments().at(idx + 1));
+        } else {
+            qCritical() << "Uso: BingoSysServer <porta> --snapshot-dir <pasta>";
+            return 1;
+        }
+    }
+    if (a.arguments().contains("--snapshot-interval")) {
+        int idx = a.arguments().indexOf("--snapshot-interval");
+        if (a.arguments().size() > idx + 1) {
+            server.setSnapshotInterval(a.arguments().at(idx + 1).toInt());
+        } else {
+            qCritical() << "Uso: BingoSysServer <porta> --snapshot-interval <segundos>";
+            return 1;
+        }
+    }
+    // Threads de I/O dos WebSockets: --io-threads <n> (0 = metade dos núcleos)
+    if (a.arguments().contains("--io-threads")) {
+        int idx = a.arguments().indexOf("--io-threads");
+        if (a.arguments().size() > idx + 1) {
+            server.setIoThreads(a.arguments().at(idx + 1).toInt());
+        } else {
+            qCritical() << "Uso: BingoSysServer <porta> --io-threads <n>";
+            return 1;
+        }
+    }
+
+    // Janela do group commit das gravações do jogo: --db-batch-ms <ms>
+    if (a.arguments().contains("--db-batch-ms")) {
+        int idx = a.arguments().indexOf("--db-batch-ms");
+        if (a.arguments().size() > idx + 1) {
+            server.setDbBatchWindow(a.arguments().at(idx + 1).toInt());
+        } else {
+            qCritical() << "Uso: BingoSysServer <porta> --db-batch-ms <ms>";
+            return 1;
+        }
+    }
+    // Fila máxima por cliente antes de suspender as atualizações dele: --client-send-budget-kb <kb>
+    if (a.arguments().contains("--client-send-budget-kb")) {
+        int idx = a.arguments().indexOf("--client-send-budget-kb");
+        if (a.arguments().size() > idx + 1) {
+            server.setClientSendBudget(a.arguments().at(idx + 1).toInt());
+        } else {
+            qCritical() << "Uso: BingoSysServer <porta> --client-send-budget-kb <kb>";
+            return 1;
+        }
+    }
+
+    // Threads dos sorteios (um sorteio fica sempre na mesma): --game-threads <n> (0 = todos os núcleos)
+    if (a.arguments().contains("--game-threads")) {
+        int idx = a.arguments().indexOf("--game-threads");
+        if (a.arguments().size() > idx + 1) {
+            server.setGameThreads(a.arguments().at(idx + 1).toInt());
+        } else {
+            qCritical() << "Uso: BingoSysServer <porta> --game-threads <n>";
+            return 1;
+        }
+    }
+    if (!instalarSinaisDeEncerramento(a)) {
+        qWarning() << "Não foi possível preparar o encerramento por sinal; SIGTERM encerra sem gravar os snapshots";
+    }
+
     if (!server.start()) {
         qCritical() << "Falha ao iniciar o servidor na porta" << port;
         return 1;
@@ -1,17 +1,309 @@
 import websocket
 import json
+import os
+import random
+import sys
+import time
+
+try:
+    import cbor2
+except ImportError:
+    cbor2 = None
+
+# Uso: python3 test_ws.py [ws://host:porta]
+WS_URL = sys.argv[1] if len(sys.argv) > 1 else os.environ.get("BINGO_WS_URL", "ws://192.168.1.107:3000")
+ADMIN_USER = "admin"
+ADMIN_PASS = "Bingo2026!@#"
+TIMEOUT = 15
+
+
+def connect():
+    ws = websocket.create_connection(WS_URL, timeout=TIMEOUT)
+    return ws
+
+
+def send(ws, action, **fields):
+    fields["action"] = action
+    ws.send(json.dumps(fields))
+
+
+def recv(ws):
+    # Quadro de texto = JSON; quadro binário = CBOR (sessão que negociou protocol "cbor")
+    opcode, data = ws.recv_data()
+    if opcode == websocket.ABNF.OPCODE_BINARY:
+        if cbor2 is None:
+            raise RuntimeError("Quadro binário recebido mas o módulo cbor2 não está instalado")
+        return cbor2.loads(data), True
+    return json.loads(data.decode("utf-8")), False
+
+
+def recv_until(ws, action, seen=None, timeout=TIMEOUT):
+    # Descarta (ou guarda em 'seen') as mensagens até chegar a 'action'
+    deadline = time.time() + timeout
+    while time.time() < deadline:
+        msg, binary = recv(ws)
+        if msg.get("action") == action:
+            return msg, binary
+        if seen is not None:
+            seen.append(msg)
+    raise AssertionError(f"Tempo esgotado esperando '{action}'")
+
+
+def check(cond, message):
+    if not cond:
+        raise AssertionError(message)
+
+
+# --- PREPARAÇÃO ---
+
+def criar_sorteio():
+    # Sorteio novo com uma rodada (quina + cheia) e 1000 cartelas vendidas
+    ws = connect()
+    send(ws, "login_admin", usuario=ADMIN_USER, senha=ADMIN_PASS)
+    resp, _ = recv_until(ws, "login_response")
+    check(resp.get("status") == "ok", f"Login de admin falhou: {resp}")
+
+    send(ws, "get_admin_data")
+    data, _ = recv(ws)
+    modelo_id = data["modelos"][0]["id"]
+    base_id = data["bases"][0]["id"]
+
+    send(ws, "criar_chave", modelo_id=modelo_id, base_id=base_id, chave="TEST-WS-" + str(int(time.time())))
+    key_resp, _ = recv_until(ws, "chave_criada_response")
+    check(key_resp.get("status") == "ok", f"Falha ao criar chave: {key_resp}")
+    ws.close()
+
+    ws = connect()
+    send(ws, "login", chave=key_resp["chave"])
+    resp, _ = recv_until(ws, "login_response")
+    check(resp.get("status") == "ok", f"Login do operador falhou: {resp}")
+
+    send(ws, "add_rodada", nome="Rodada de teste", base_id=base_id, configuracoes={"numChances": 1}, ordem=1,
+         premios=[{"tipo": "quina", "descricao": "Quina", "padrao": []},
+                  {"tipo": "cheia", "descricao": "Cartela cheia", "padrao": []}])
+    recv_until(ws, "rodada_added")
+    recv_until(ws, "sync_status")
+
+    send(ws, "register_random", count=1000, telefone="11999990000")
+    recv_until(ws, "batch_registration_finished", timeout=60)
+    ws.close()
+    print(f"   Sorteio {key_resp['sorteio_id']} criado com a chave {key_resp['chave']}")
+    return key_resp["chave"]
+
+
+def login_operador(chave, protocol=None):
+    # Devolve (ws, login_response, sync_status, binário?)
+    ws = connect()
+    fields = {"chave": chave}
+    if protocol:
+        fields["protocol"] = protocol
+    send(ws, "login", **fields)
+    seen = []
+    resp, binary = recv_until(ws, "login_response", seen)
+    check(resp.get("status") == "ok", f"Login do operador falhou: {resp}")
+    sync = next((m for m in seen if m.get("action") == "sync_status"), None)
+    if sync is None:
+        sync, _ = recv_until(ws, "sync_status")
+    return ws, resp, sync, binary
+
+
+# --- TESTES ---
+
+def test_ping():
+    ws = connect()
+    send(ws, "ping")
+    msg, _ = recv(ws)
+    check(msg.get("action") == "pong", f"Resposta inesperada ao ping: {msg}")
+    ws.close()
+
+
+def test_cbor_login(chave):
+    # Sessão que pede CBOR recebe a resposta do login e o sync em quadros binários
+    check(cbor2 is not None, "Instale o módulo cbor2 (pip install cbor2)")
+    ws, resp, sync, binary = login_operador(chave, "cbor")
+    check(binary, "login_response deveria chegar em quadro binário")
+    check(resp.get("protocol") == "cbor", f"Servidor não confirmou o protocolo: {resp}")
+    check("seq" in sync, f"sync_status sem seq: {sync}")
+
+    send(ws, "get_sync")
+    sync, binary = recv_until(ws, "sync_status")
+    check(binary, "sync_status de uma sessão CBOR deveria ser binário")
+    ws.close()
+
+    # Sem o campo (ou com um protocolo desconhecido) a sessão continua em JSON
+    ws, resp, _, binary = login_operador(chave, "xml")
+    check(not binary, "Protocolo desconhecido deveria cair para JSON")
+    check(resp.get("protocol", "json") == "json", f"Protocolo inesperado: {resp}")
+    ws.close()
+
+
+class DeltaClient:
+    # Mesma regra do frontend/js/socket.js: aplica game_delta sobre o último sync_status e,
+    # numa lacuna do seq, descarta o estado e pede get_sync
+    def __init__(self, ws, sync):
+        self.ws = ws
+        self.seq = int(sync["seq"])
+        self.drawn = list(sync.get("drawnNumbers", []))
+        self.gaps = 0
+        self.events = []  # (event, number) de cada delta aplicado
+
+    def handle(self, msg):
+        if msg.get("action") == "sync_status":
+            self.seq = int(msg["seq"])
+            self.drawn = list(msg.get("drawnNumbers", []))
+        elif msg.get("action") == "game_delta":
+            self.apply(msg)
+
+    def apply(self, delta):
+        seq = int(delta["seq"])
+        if self.seq is None or seq <= self.seq:
+            return
+        if seq != self.seq + 1:
+            self.gaps += 1
+            self.seq = None
+            send(self.ws, "get_sync")
+            return
+        self.seq = seq
+        self.events.append((delta.get("event"), delta.get("number")))
+        if delta.get("balls_removed"):
+            self.drawn = self.drawn[:len(self.drawn) - delta["balls_removed"]]
+        self.drawn += delta.get("balls_added", [])
+
+    def pump_until(self, cond, drop=None, timeout=TIMEOUT):
+        # Entrega as mensagens ao cliente até 'cond()'; 'drop(msg)' = True simula uma perda
+        deadline = time.time() + timeout
+        while not cond():
+            check(time.time() < deadline, "Tempo esgotado esperando as mensagens do sorteio")
+            msg, _ = recv(self.ws)
+            if drop and drop(msg):
+                drop = None
+                continue
+            self.handle(msg)
+
+
+def is_ball_delta(msg, number):
+    # O delta da bola é o de event "number_drawn" com o número dela; uma quina realizada na
+    # mesma bola gera outros deltas que não devem ser confundidos com ele
+    return msg.get("action") == "game_delta" and msg.get("event") == "number_drawn" and msg.get("number") == number
+
+
+def test_delta_seq(chave):
+    # Deltas em sequência são aplicados sem lacuna; um delta perdido é detectado pelo seq e o
+    # get_sync devolve o estado completo, com a bola do delta perdido
+    ws, _, sync, _ = login_operador(chave)
+    client = DeltaClient(ws, sync)
+    expected = list(client.drawn)
+    pendentes = [n for n in range(1, 76) if n not in expected]
+    random.shuffle(pendentes)
+
+    for number in pendentes[:10]:
+        send(ws, "draw_number", number=number)
+        client.pump_until(lambda: ("number_drawn", number) in client.events)
+        expected.append(number)
+        check(client.gaps == 0, f"Lacuna sem perda nenhuma (delta da bola {number})")
+        check(client.drawn == expected, f"Estado pelos deltas {client.drawn} diferente de {expected}")
+
+    # Perde o delta da bola A; o próximo delta chega com lacuna e o cliente pede o sync
+    perdida, seguinte = pendentes[10], pendentes[11]
+    send(ws, "draw_number", number=perdida)
+    send(ws, "draw_number", number=seguinte)
+    expected += [perdida, seguinte]
+    client.pump_until(lambda: client.seq is not None and client.gaps > 0 and seguinte in client.drawn,
+                      drop=lambda msg: is_ball_delta(msg, perdida))
+    check(client.gaps == 1, f"Esperada uma lacuna, detectadas {client.gaps}")
+    check(client.drawn == expected, f"Estado depois do get_sync {client.drawn} diferente de {expected}")
+
+    # Depois do sync os deltas voltam a valer normalmente
+    number = pendentes[12]
+    send(ws, "draw_number", number=number)
+    expected.append(number)
+    client.pump_until(lambda: ("number_drawn", number) in client.events)
+    check(client.gaps == 1, "Nova lacuna depois do get_sync")
+    check(client.drawn == expected, f"Estado pelos deltas {client.drawn} diferente de {expected}")
+    ws.close()
+
+
+def fetch_pages(ws, prize_id, kind, limit, missing=None):
+    # Percorre a lista inteira; devolve (ids, total, quantidade de páginas)
+    ids, total, pages, cursor = [], None, 0, None
+    while True:
+        fields = {"prizeId": prize_id, "kind": kind, "limit": limit}
+        if missing is not None:
+            fields["missing"] = missing
+        if cursor is not None:
+            fields["cursor"] = cursor
+        send(ws, "get_prize_tickets", **fields)
+        page, _ = recv_until(ws, "prize_tickets")
+        pages += 1
+        check(page["prizeId"] == prize_id and page["kind"] == kind, f"Página de outra lista: {page}")
+        check(len(page["tickets"]) <= limit, f"Página com {len(page['tickets'])} cartelas, limite {limit}")
+        total = page["total"] if total is None else total
+        check(page["total"] == total, "total mudou entre páginas")
+        ids.extend(t["ticketId"] for t in page["tickets"])
+        cursor = page.get("nextCursor")
+        if cursor is None:
+            break
+        check(page["tickets"], "Página vazia com nextCursor")
+        check(cursor == page["tickets"][-1]["ticketId"], "nextCursor diferente do último ID da página")
+        check(pages <= total + 1, "Paginação não termina")
+    return ids, total, pages
+
+
+def test_prize_tickets_paging(chave):
+    ws, _, sync, _ = login_operador(chave)
+    listas = []
+    for premio in sync["engine_premios_status"]:
+        listas.append((premio["id"], "winners", None))
+        for missing in (1, 2, 3):
+            listas.append((premio["id"], "near_winners", missing))
+
+    paginadas = 0
+    for prize_id, kind, missing in listas:
+        ids, total, pages = fetch_pages(ws, prize_id, kind, 7, missing)
+        check(len(ids) == total, f"{kind}/{missing} do prêmio {prize_id}: {len(ids)} IDs, total {total}")
+        check(ids == sorted(set(ids)), f"{kind}/{missing} do prêmio {prize_id}: IDs fora de ordem ou repetidos")
+        if total == 0:
+            continue
+        paginadas += pages > 1
+
+        # Última página exata: nextCursor nulo já nela, sem uma página vazia depois
+        limit = total // 2 if total % 2 == 0 and total > 1 else total
+        exact, _, exact_pages = fetch_pages(ws, prize_id, kind, limit, missing)
+        check(exact == ids, "Paginação com limite exato devolveu outra lista")
+        check(exact_pages == total // limit, f"Limite {limit} de {total}: {exact_pages} páginas")
+
+    check(paginadas > 0, "Nenhuma lista teve mais de uma página; aumente as vendas ou as bolas")
+
+    send(ws, "get_prize_tickets", prizeId=-1, kind="winners")
+    error, _ = recv_until(ws, "prize_tickets_error")
+    check(error["prizeId"] == -1, f"Erro de prêmio inválido inesperado: {error}")
+    ws.close()
+
 
 def test():
-    uri = "ws://192.168.1.107:3001"
+    print(f"Servidor: {WS_URL}")
+    falhas = 0
+
+    def run(nome, fn, *args):
+        nonlocal falhas
+        try:
+            fn(*args)
+            print(f"OK    {nome}")
+        except Exception as e:
+            falhas += 1
+            print(f"FALHA {nome}: {e}")
+
+    run("ping", test_ping)
     try:
-        ws = websocket.create_connection(uri)
-        print(f"Conectado a {uri}")
-        ws.send(json.dumps({"action": "ping"}))
-        response = ws.recv()
-        print(f"Resposta: {response}")
-        ws.close()
+        chave = criar_sorteio()
     except Exception as e:
-        print(f"Erro: {e}")
+        print(f"Erro ao preparar o sorteio de teste: {e}")
+        return 1
+    run("login com CBOR", test_cbor_login, chave)
+    run("seq do game_delta e get_sync", test_delta_seq, chave)
+    run("paginação de get_prize_tickets", test_prize_tickets_paging, chave)
+    return 1 if falhas else 0
+
 
 if __name__ == "__main__":
-    test()
+    sys.exit(test())